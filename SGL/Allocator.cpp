@@ -0,0 +1,351 @@
+#include "Allocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	/**
+	 * Rounds 'value' up to a multiple of 'alignment', which is a power of two
+	 */
+	std::size_t align_up(std::size_t value, std::size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+void* SGLAllocator::allocate(std::size_t size, std::size_t alignment)
+{
+	void* memory = allocate_memory(size, alignment);
+	if (!memory)
+	{
+		return nullptr;
+	}
+
+	_allocationCount.fetch_add(1, std::memory_order_relaxed);
+	std::size_t inUse = _bytesInUse.fetch_add(size, std::memory_order_relaxed) + size;
+
+	std::size_t peak = _peakBytes.load(std::memory_order_relaxed);
+	while (inUse > peak && !_peakBytes.compare_exchange_weak(peak, inUse, std::memory_order_relaxed))
+	{
+	}
+
+	return memory;
+}
+
+void SGLAllocator::deallocate(void* memory, std::size_t size)
+{
+	if (!memory)
+	{
+		return;
+	}
+
+	deallocate_memory(memory, size);
+	_bytesInUse.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* SGLMallocAllocator::allocate_memory(std::size_t size, std::size_t alignment)
+{
+	// aligned allocators want a size that's a multiple of the alignment
+	return _aligned_malloc(align_up(size, alignment), alignment);
+}
+
+void SGLMallocAllocator::deallocate_memory(void* memory, std::size_t)
+{
+	_aligned_free(memory);
+}
+
+SGLArenaAllocator::SGLArenaAllocator(void* memory, std::size_t size)
+	: _memory(static_cast<std::uint8_t*>(memory))
+	, _size(memory ? size : 0)
+{}
+
+SGLArenaAllocator::SGLArenaAllocator(std::size_t size, SGLAllocator& upstream)
+	: _memory(static_cast<std::uint8_t*>(upstream.allocate(size, alignof(std::max_align_t))))
+	, _size(_memory ? size : 0)
+	, _upstream(&upstream)
+{}
+
+SGLArenaAllocator::~SGLArenaAllocator()
+{
+	if (_upstream)
+	{
+		_upstream->deallocate(_memory, _size);
+	}
+}
+
+void SGLArenaAllocator::reset()
+{
+	_used = 0;
+	release_all();
+}
+
+void* SGLArenaAllocator::allocate_memory(std::size_t size, std::size_t alignment)
+{
+	// align the address rather than the offset, the region itself might be less aligned
+	std::uintptr_t base = reinterpret_cast<std::uintptr_t>(_memory);
+	std::size_t start = align_up(base + _used, alignment) - base;
+	if (start > _size || _size - start < size)
+	{
+		return nullptr;
+	}
+
+	_used = start + size;
+	return _memory + start;
+}
+
+void SGLArenaAllocator::deallocate_memory(void*, std::size_t)
+{
+	// everything goes at once in reset
+}
+
+SGLScratchAllocator::SGLScratchAllocator(std::size_t chunkSize, SGLAllocator& upstream)
+	: _upstream(upstream)
+	, _chunkSize(align_up(chunkSize, alignof(std::max_align_t)))
+{}
+
+SGLScratchAllocator::~SGLScratchAllocator()
+{
+	for (const auto& chunk : _chunks)
+	{
+		_upstream.deallocate(chunk.Memory, chunk.Size);
+	}
+}
+
+void SGLScratchAllocator::reset()
+{
+	_chunk = 0;
+	_used = 0;
+	++_resetCount;
+	release_all();
+}
+
+void SGLScratchAllocator::shrink()
+{
+	reset();
+
+	for (std::size_t i = 1; i < _chunks.size(); ++i)
+	{
+		_upstream.deallocate(_chunks[i].Memory, _chunks[i].Size);
+	}
+
+	if (!_chunks.empty())
+	{
+		_chunks.resize(1);
+	}
+}
+
+bool SGLScratchAllocator::is_temporary(const void* memory) const
+{
+	auto* address = static_cast<const std::uint8_t*>(memory);
+	for (std::size_t i = 0; i < _chunks.size() && i <= _chunk; ++i)
+	{
+		std::size_t used = i == _chunk ? _used : _chunks[i].Size;
+		if (address >= _chunks[i].Memory && address < _chunks[i].Memory + used)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void* SGLScratchAllocator::promote(const void* memory, std::size_t size, std::size_t alignment, SGLAllocator& to) const
+{
+	if (!is_temporary(memory))
+	{
+		return const_cast<void*>(memory);
+	}
+
+	void* copy = to.allocate(size, alignment);
+	if (copy)
+	{
+		std::memcpy(copy, memory, size);
+	}
+
+	return copy;
+}
+
+std::size_t SGLScratchAllocator::get_reserved_size() const
+{
+	std::size_t size = 0;
+	for (const auto& chunk : _chunks)
+	{
+		size += chunk.Size;
+	}
+
+	return size;
+}
+
+void* SGLScratchAllocator::allocate_memory(std::size_t size, std::size_t alignment)
+{
+	// move on through the chunks until one has room, allocating a bigger one past the last
+	while (true)
+	{
+		if (_chunk < _chunks.size())
+		{
+			Chunk& chunk = _chunks[_chunk];
+			std::uintptr_t base = reinterpret_cast<std::uintptr_t>(chunk.Memory);
+			std::size_t start = align_up(base + _used, alignment) - base;
+			if (start <= chunk.Size && chunk.Size - start >= size)
+			{
+				_used = start + size;
+				return chunk.Memory + start;
+			}
+
+			if (_chunk + 1 < _chunks.size())
+			{
+				++_chunk;
+				_used = 0;
+				continue;
+			}
+		}
+
+		// each chunk is at least double the last, so a big call links on few of them
+		std::size_t chunkSize = _chunks.empty() ? _chunkSize : _chunks.back().Size * 2;
+		chunkSize = std::max(chunkSize, align_up(size + alignment, alignof(std::max_align_t)));
+
+		auto* memory = static_cast<std::uint8_t*>(_upstream.allocate(chunkSize, alignof(std::max_align_t)));
+		if (!memory)
+		{
+			return nullptr;
+		}
+
+		_chunks.push_back({ memory, chunkSize });
+		_chunk = _chunks.size() - 1;
+		_used = 0;
+	}
+}
+
+void SGLScratchAllocator::deallocate_memory(void*, std::size_t)
+{
+	// everything goes at once in reset
+}
+
+SGLPoolAllocator::SGLPoolAllocator(std::size_t blockSize, std::size_t blockCount, std::size_t blockAlignment, SGLAllocator& upstream)
+	: _blockSize(align_up(blockSize < sizeof(void*) ? sizeof(void*) : blockSize, blockAlignment))
+	, _blockCount(blockCount)
+	, _blockAlignment(blockAlignment)
+	, _upstream(upstream)
+{
+	_memory = static_cast<std::uint8_t*>(_upstream.allocate(_blockSize * _blockCount, _blockAlignment));
+	if (!_memory)
+	{
+		_blockCount = 0;
+		return;
+	}
+
+	// thread the free list through the blocks back to front, so the first allocation gets the first block
+	for (std::size_t i = _blockCount; i-- > 0;)
+	{
+		void* block = _memory + i * _blockSize;
+		*static_cast<void**>(block) = _freeList;
+		_freeList = block;
+	}
+
+	_freeCount = _blockCount;
+}
+
+SGLPoolAllocator::~SGLPoolAllocator()
+{
+	_upstream.deallocate(_memory, _blockSize * _blockCount);
+}
+
+void* SGLPoolAllocator::allocate_memory(std::size_t size, std::size_t alignment)
+{
+	if (size > _blockSize || alignment > _blockAlignment || !_freeList)
+	{
+		return nullptr;
+	}
+
+	void* block = _freeList;
+	_freeList = *static_cast<void**>(block);
+	--_freeCount;
+	return block;
+}
+
+void SGLPoolAllocator::deallocate_memory(void* memory, std::size_t)
+{
+	*static_cast<void**>(memory) = _freeList;
+	_freeList = memory;
+	++_freeCount;
+}
+
+SGLGuardedAllocator::SGLGuardedAllocator()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	_pageSize = info.dwPageSize;
+#else
+	_pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+void* SGLGuardedAllocator::allocate_memory(std::size_t size, std::size_t alignment)
+{
+	if (alignment > _pageSize)
+	{
+		std::cerr << "Guarded allocations can't be aligned to more than a page" << std::endl;
+		return nullptr;
+	}
+
+	// guard page, the allocation's pages, guard page
+	std::size_t usable = align_up(size, _pageSize);
+	std::size_t total = usable + 2 * _pageSize;
+
+#ifdef _WIN32
+	std::uint8_t* base = static_cast<std::uint8_t*>(VirtualAlloc(nullptr, total, MEM_RESERVE, PAGE_NOACCESS));
+	if (!base)
+	{
+		return nullptr;
+	}
+
+	// only the pages between the guards get committed, the guards stay reserved and inaccessible
+	if (!VirtualAlloc(base + _pageSize, usable, MEM_COMMIT, PAGE_READWRITE))
+	{
+		VirtualFree(base, 0, MEM_RELEASE);
+		return nullptr;
+	}
+#else
+	void* mapping = mmap(nullptr, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	std::uint8_t* base = static_cast<std::uint8_t*>(mapping);
+	if (mprotect(base + _pageSize, usable, PROT_READ | PROT_WRITE) != 0)
+	{
+		munmap(base, total);
+		return nullptr;
+	}
+#endif
+
+	// push the allocation up against the guard page behind it
+	return base + _pageSize + (usable - align_up(size, alignment));
+}
+
+void SGLGuardedAllocator::deallocate_memory(void* memory, std::size_t size)
+{
+	// the allocation starts within its first page, so rounding down finds the page after the front guard
+	std::uintptr_t firstPage = reinterpret_cast<std::uintptr_t>(memory) & ~(_pageSize - 1);
+	std::uint8_t* base = reinterpret_cast<std::uint8_t*>(firstPage - _pageSize);
+
+#ifdef _WIN32
+	(void)size;
+	VirtualFree(base, 0, MEM_RELEASE);
+#else
+	munmap(base, align_up(size, _pageSize) + 2 * _pageSize);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Where the VM's runtime memory comes from
+ *
+ * Stacks, VMs and script instances take an allocator, so a host can keep all of its scripting
+ * memory in a region it set aside and see how much of it each subsystem uses. Every allocator
+ * counts what goes through it. The malloc allocator is safe to share between threads, the
+ * others aren't synchronized, so give each thread or subsystem its own.
+ */
+class SGLAllocator
+{
+public:
+
+	SGLAllocator() = default;
+
+	SGLAllocator(const SGLAllocator&) = delete;
+	SGLAllocator& operator=(const SGLAllocator&) = delete;
+
+	virtual ~SGLAllocator() = default;
+
+	/**
+	 * Allocates 'size' bytes aligned to 'alignment', which must be a power of two
+	 * Returns nullptr if the allocator can't provide the memory
+	 */
+	void* allocate(std::size_t size, std::size_t alignment);
+
+	/**
+	 * Frees memory returned by allocate, 'size' must be the size it was allocated with
+	 */
+	void deallocate(void* memory, std::size_t size);
+
+	/**
+	 * Tells the allocator that memory it handed out has been written to
+	 * Does nothing unless the allocator keeps track of changes, like SGLStateRegion
+	 */
+	virtual void mark_written(void*, std::size_t)
+	{
+	}
+
+	/**
+	 * Returns the number of bytes currently allocated
+	 */
+	std::size_t get_bytes_in_use() const
+	{
+		return _bytesInUse.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the most bytes that have been allocated at once
+	 */
+	std::size_t get_peak_bytes() const
+	{
+		return _peakBytes.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns the number of allocations made so far
+	 */
+	std::size_t get_allocation_count() const
+	{
+		return _allocationCount.load(std::memory_order_relaxed);
+	}
+
+protected:
+
+	/**
+	 * Backend for allocate, the counters are taken care of
+	 */
+	virtual void* allocate_memory(std::size_t size, std::size_t alignment) = 0;
+
+	/**
+	 * Backend for deallocate, only called with memory this allocator returned
+	 */
+	virtual void deallocate_memory(void* memory, std::size_t size) = 0;
+
+	/**
+	 * Counts everything allocated so far as freed, for allocators that free it all at once
+	 */
+	void release_all()
+	{
+		_bytesInUse.store(0, std::memory_order_relaxed);
+	}
+
+private:
+
+	std::atomic<std::size_t> _bytesInUse{ 0 };
+	std::atomic<std::size_t> _peakBytes{ 0 };
+	std::atomic<std::size_t> _allocationCount{ 0 };
+
+};
+
+/**
+ * Allocates from the heap with _aligned_malloc, what everything uses unless told otherwise
+ */
+class SGLMallocAllocator : public SGLAllocator
+{
+protected:
+
+	void* allocate_memory(std::size_t size, std::size_t alignment) override;
+	void deallocate_memory(void* memory, std::size_t size) override;
+};
+
+/**
+ * Hands out consecutive pieces of one region and frees them all at once with reset
+ * Deallocating single pieces does nothing, so memory is never fragmented
+ */
+class SGLArenaAllocator : public SGLAllocator
+{
+public:
+
+	/**
+	 * Creates an arena over memory the host owns, which has to outlive the arena
+	 */
+	SGLArenaAllocator(void* memory, std::size_t size);
+
+	/**
+	 * Creates an arena with a region of 'size' bytes taken from another allocator
+	 */
+	SGLArenaAllocator(std::size_t size, SGLAllocator& upstream);
+
+	~SGLArenaAllocator() override;
+
+	/**
+	 * Frees everything allocated from the arena in one go
+	 * Nothing allocated from it may be used afterwards
+	 */
+	void reset();
+
+	/**
+	 * Returns the number of bytes left in the region
+	 */
+	std::size_t get_bytes_left() const
+	{
+		return _size - _used;
+	}
+
+protected:
+
+	void* allocate_memory(std::size_t size, std::size_t alignment) override;
+	void deallocate_memory(void* memory, std::size_t size) override;
+
+	/**
+	 * Returns the start of the region
+	 */
+	std::uint8_t* get_memory() const
+	{
+		return _memory;
+	}
+
+	/**
+	 * Returns the number of bytes handed out so far, counted from the start of the region
+	 */
+	std::size_t get_used_size() const
+	{
+		return _used;
+	}
+
+private:
+
+	// Start of the region
+	std::uint8_t* _memory;
+	// Size of the region
+	std::size_t _size;
+	// Bytes handed out so far, alignment padding included
+	std::size_t _used = 0;
+	// Allocator the region came from, nullptr if the host owns it
+	SGLAllocator* _upstream = nullptr;
+
+};
+
+/**
+ * Scratch memory for things that only live until a call returns
+ *
+ * Allocating is a pointer bump and everything goes at once with reset. It starts out with no
+ * memory, takes a chunk from its upstream allocator on the first allocation and links on bigger
+ * chunks whenever one fills up, so it never runs out while the upstream allocator has memory.
+ * Chunks are kept across resets, so after the first few calls it stops allocating altogether.
+ */
+class SGLScratchAllocator : public SGLAllocator
+{
+public:
+
+	/**
+	 * Creates a scratch allocator whose first chunk will be 'chunkSize' bytes, taken from 'upstream'
+	 */
+	SGLScratchAllocator(std::size_t chunkSize, SGLAllocator& upstream);
+
+	~SGLScratchAllocator() override;
+
+	/**
+	 * Frees everything allocated since the last reset, the chunks stay for the next call
+	 */
+	void reset();
+
+	/**
+	 * Frees every chunk but the first, for owners that are going to sit idle
+	 */
+	void shrink();
+
+	/**
+	 * Returns true if the memory was allocated from this allocator since its last reset
+	 */
+	bool is_temporary(const void* memory) const;
+
+	/**
+	 * Copies a value that has to outlive the call into memory from 'to', if it's temporary
+	 * Returns the copy, the value itself if it wasn't temporary, or nullptr if 'to' is out of memory
+	 */
+	void* promote(const void* memory, std::size_t size, std::size_t alignment, SGLAllocator& to) const;
+
+	/**
+	 * Returns the number of times the allocator has been reset
+	 */
+	std::size_t get_reset_count() const
+	{
+		return _resetCount;
+	}
+
+	/**
+	 * Returns the number of bytes of chunks the allocator holds on to
+	 */
+	std::size_t get_reserved_size() const;
+
+protected:
+
+	void* allocate_memory(std::size_t size, std::size_t alignment) override;
+	void deallocate_memory(void* memory, std::size_t size) override;
+
+private:
+
+	/**
+	 * One block of scratch memory
+	 */
+	struct Chunk
+	{
+		std::uint8_t* Memory = nullptr;
+		std::size_t Size = 0;
+	};
+
+	// Where chunks come from
+	SGLAllocator& _upstream;
+	// Size of the first chunk
+	std::size_t _chunkSize;
+	// Every chunk allocated so far, in the order they're used
+	std::vector<Chunk> _chunks;
+	// Index of the chunk being allocated from
+	std::size_t _chunk = 0;
+	// Bytes handed out from the current chunk
+	std::size_t _used = 0;
+	// Number of resets so far
+	std::size_t _resetCount = 0;
+
+};
+
+/**
+ * Hands out blocks of one fixed size from a free list, so allocating and freeing are constant
+ * time and freed blocks are reused as they are
+ * Suits things that are all the same size, like the stacks of a VMPool
+ */
+class SGLPoolAllocator : public SGLAllocator
+{
+public:
+
+	/**
+	 * Creates a pool of 'blockCount' blocks of 'blockSize' bytes, taken from another allocator
+	 * Blocks are aligned to 'blockAlignment', allocations that need more fail
+	 */
+	SGLPoolAllocator(std::size_t blockSize, std::size_t blockCount, std::size_t blockAlignment, SGLAllocator& upstream);
+
+	~SGLPoolAllocator() override;
+
+	/**
+	 * Returns the number of blocks waiting to be allocated
+	 */
+	std::size_t get_free_block_count() const
+	{
+		return _freeCount;
+	}
+
+protected:
+
+	void* allocate_memory(std::size_t size, std::size_t alignment) override;
+	void deallocate_memory(void* memory, std::size_t size) override;
+
+private:
+
+	// Memory holding every block
+	std::uint8_t* _memory = nullptr;
+	// Size of each block, rounded up to the block alignment
+	std::size_t _blockSize;
+	// Number of blocks
+	std::size_t _blockCount;
+	// Alignment of every block
+	std::size_t _blockAlignment;
+	// First free block, each free block holds a pointer to the next one
+	void* _freeList = nullptr;
+	// Number of free blocks
+	std::size_t _freeCount = 0;
+	// Allocator the blocks came from
+	SGLAllocator& _upstream;
+
+};
+
+/**
+ * Maps every allocation straight from the OS, followed by a page that can't be touched
+ * An allocation ends right where the guard page begins, so a stack that grows past its end
+ * faults at once instead of writing over something else. There is a guard page in front too.
+ * Each allocation takes whole pages, so this is for stacks, not small objects.
+ */
+class SGLGuardedAllocator : public SGLAllocator
+{
+public:
+
+	SGLGuardedAllocator();
+
+	/**
+	 * Returns the size of a page, which guard pages and allocations are rounded to
+	 */
+	std::size_t get_page_size() const
+	{
+		return _pageSize;
+	}
+
+protected:
+
+	void* allocate_memory(std::size_t size, std::size_t alignment) override;
+	void deallocate_memory(void* memory, std::size_t size) override;
+
+private:
+
+	// Size of a page on this system
+	std::size_t _pageSize;
+
+};
+
+/**
+ * Returns the allocator used when none is given, a SGLMallocAllocator
+ */
+inline SGLAllocator& get_default_allocator()
+{
+	static SGLMallocAllocator allocator;
+	return allocator;
+}
\ No newline at end of file
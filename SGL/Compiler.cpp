@@ -1,10 +1,25 @@
 #include "Compiler.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <queue>
+#include <set>
 #include <vector>
 
+#include "Helpers.h"
+#include "Instructions.h"
+#include "NativeFunctions.h"
+#include "PrintSink.h"
+#include "Script.h"
+#include "SGLString.h"
 #include "StringHelpers.h"
+#include "SymbolTable.h"
+#include "VectorMath.h"
 
 namespace SGL
 {
@@ -14,101 +29,6 @@ namespace SGL
 	 *****************************************************************
 	 */
 
-	/**
-	 * Struct that holds information about types in SGL
-	 */
-	struct TypeData
-	{
-		// Type's name in SGL code
-		std::string TypeName;
-
-		/**
-		 * Returns true if the type is valid
-		 */
-		bool is_valid() const
-		{
-			return !TypeName.empty();
-		}
-
-		/**
-		 * Comparison operators
-		 */
-		friend bool operator==(const TypeData& lh, const TypeData& rh)
-		{
-			return lh.TypeName == rh.TypeName;
-		}
-
-		friend bool operator!=(const TypeData& lh, const TypeData& rh)
-		{
-			return lh.TypeName != rh.TypeName;
-		}
-	};
-
-	/**
-	 * POD types
-	 */
-	namespace Types
-	{
-		// 32-bit signed in
-		TypeData int_type = { "int32" };
-		// 32-bit floating point
-		TypeData float_type = { "float" };
-		// no-data type
-		TypeData void_type = { "void" };
-		// invalid type used in the compiler for errors
-		TypeData invalid_type{ "" };
-	}
-
-	// List of registered types
-	std::vector<TypeData> g_types = { Types::int_type, Types::float_type, Types::void_type };
-
-	/**
-	 * Returns the TypeData for a given type name
-	 * Returns Types::invalid_type for an unrecognized type
-	 */
-	TypeData get_type(const std::string& typeStr)
-	{
-		for (auto type : g_types)
-		{
-			if (type.TypeName == typeStr)
-			{
-				return type;
-			}
-		}
-
-		return Types::invalid_type;
-	}
-
-	/**
-	 * Struct that holds information about functions delcared in the SGL script
-	 */
-	struct FunctionData
-	{
-		// Original source code of the function
-		std::string FunctionSource;
-		// Name to call function
-		std::string FunctionName;
-		// Return type of the function
-		TypeData ReturnType;
-		
-		/**
-		 * Struct to hold function parameter info
-		 */
-		struct FunctionParam
-		{
-			TypeData ParamType;
-			std::string ParamName;
-		};
-
-		// Array of parameters for the function
-		std::vector<FunctionParam> FunctionParams;
-
-		bool is_valid() const
-		{
-			return FunctionName.length() > 0;
-		}
-	};
-
 	/**
 	 * Holds intermediate compiler data
 	 */
@@ -136,6 +56,9 @@ namespace SGL
 	// Returns true for numerical characters only
 	auto g_is_digit = [](unsigned char c) -> bool { return std::isdigit(c); };
 
+	// True while the compiler reports the functions it parses and compiles, see set_verbose
+	std::atomic<bool> g_isVerbose{ false };
+
 	/**
 	 *****************************************************************
 	 *					Compilation step functions
@@ -149,7 +72,7 @@ namespace SGL
 	{
 		// strip comments
 		size_t commentStart = std::string::npos;
-		while ((commentStart = source.find("//")) != std::string::npos)
+		while ((commentStart = find_unquoted(source, "//")) != std::string::npos)
 		{
 			// Find the end of the line
 			size_t lineEnd = source.find('\n', commentStart);
@@ -167,7 +90,7 @@ namespace SGL
 
 		// strip blocks
 		size_t blockStart = std::string::npos;
-		while ((blockStart = source.find("/*")) != std::string::npos)
+		while ((blockStart = find_unquoted(source, "/*")) != std::string::npos)
 		{
 			// Find the end of the block
 			size_t blockEnd = source.find("*/", blockStart);
@@ -187,10 +110,19 @@ namespace SGL
 			}
 		}
 
-		// check for missing brackets or parentheses
+		// check for missing brackets or parentheses, the ones inside strings don't count
+		bool inQuotes = false;
 		for (std::size_t i = 0; i < source.length(); ++i)
 		{
-			if (source[i] == '(')
+			if (is_quote_at(source, i))
+			{
+				inQuotes = !inQuotes;
+			}
+			else if (inQuotes)
+			{
+				continue;
+			}
+			else if (source[i] == '(')
 			{
 				auto pair = find_matching_parenthesis(source, i);
 				if (pair == std::string::npos)
@@ -350,13 +282,13 @@ namespace SGL
 				strip_leading_whitespace(idStr);
 
 				// make sure type is valid
-				TypeData type = get_type(typeStr);
+				const SGLType& type = get_type(typeStr);
 				if (!type.is_valid())
 				{
 					std::cerr << "Unrecognized type " << typeStr << " in function declaration" << std::endl;
 					return func;
 				}
-				else if (type == Types::void_type)
+				else if (type.TypeId == SGL_TYPE_VOID)
 				{
 					// void not allowed as anything except function return type
 					std::cerr << "Illegal use of void type in function parameter" << std::endl;
@@ -366,7 +298,7 @@ namespace SGL
 				// Build param struct
 				FunctionData::FunctionParam fparam;
 				fparam.ParamName = idStr;
-				fparam.ParamType = type;
+				fparam.ParamType = type.TypeId;
 
 				// Add to list
 				func.FunctionParams.push_back(fparam);
@@ -378,7 +310,7 @@ namespace SGL
 		// find return type
 		// an SGL function return type clause comes after the end of the parameters and looks like "-> TYPE"
 		// if there is no clause, the return type is void
-		TypeData returnType = Types::void_type;
+		SGLTypeId returnType = SGL_TYPE_VOID;
 		auto clauseStart = src.find("->", paramEnd);
 		if (clauseStart != std::string::npos)
 		{
@@ -403,7 +335,7 @@ namespace SGL
 			auto retTypeStr = src.substr(retTypeStart, retTypeEndChar - retTypeStart);
 
 			// check if valid
-			TypeData rtype = get_type(retTypeStr);
+			const SGLType& rtype = get_type(retTypeStr);
 			if (!rtype.is_valid())
 			{
 				std::cerr << "Unrecognized type " << retTypeStr << " in function return clause" << std::endl;
@@ -411,185 +343,3697 @@ namespace SGL
 			}
 
 			// assign it to the return type
-			returnType = rtype;
+			returnType = rtype.TypeId;
 		}
 
 		func.FunctionName = funcIdentifier;
 		func.ReturnType = returnType;
 
-		// for testing:
-		std::cout << "Found a function called " << func.FunctionName << " that returns " << func.ReturnType.TypeName
-			<< " and takes " << func.FunctionParams.size() << " arguments." << std::endl;
-		if (func.FunctionParams.size() > 0)
+		if (g_isVerbose.load(std::memory_order_relaxed))
 		{
-			std::cout << "Function params are:" << std::endl;
-			for (auto param : func.FunctionParams)
+			SGLPrintSink& sink = get_print_sink();
+			sink.write_line(SGLPrintChannel::Diagnostic, "Found a function called ", func.FunctionName, " that returns ",
+				get_type(func.ReturnType).TypeName, " and takes ", func.FunctionParams.size(), " arguments.");
+			if (func.FunctionParams.size() > 0)
 			{
-				std::cout << param.ParamType.TypeName << " " << param.ParamName << std::endl;
+				sink.write_line(SGLPrintChannel::Diagnostic, "Function params are:");
+				for (const auto& param : func.FunctionParams)
+				{
+					sink.write_line(SGLPrintChannel::Diagnostic, get_type(param.ParamType).TypeName, " ", param.ParamName);
+				}
 			}
 		}
 
 		return func;
 	}
 
-	bool compile_function_body(FunctionData fn)
+	/**
+	 *****************************************************************
+	 *					Function body compilation
+	 *****************************************************************
+	 */
+
+	/**
+	 * A parameter or local variable of the function being compiled
+	 * Until slots are allocated, variables are referred to by their index in the local list
+	 */
+	struct LocalVariable
 	{
-		// grab a copy of the source
-		std::string source = fn.FunctionSource;
+		// Type of the variable
+		SGLTypeId Type = SGL_INVALID_TYPE_ID;
+		// Bytecode offset of every slot operand that refers to this variable
+		std::vector<std::size_t> OperandOffsets;
+		// Bytecode offset where the variable starts holding a value
+		std::size_t LiveStart = 0;
+		// Bytecode offset of the last instruction that touches the variable
+		std::size_t LiveEnd = 0;
+		// Frame slot given to the variable by allocate_frame_slots, the first of its slots if it needs more than one
+		std::size_t Slot = 0;
+		// Number of consecutive slots the variable takes up
+		std::size_t SlotCount = 1;
+	};
 
-		// trim off everything up to (and including) the bracket
-		auto openingBracket = source.find('{');
-		source.erase(0, openingBracket + 1);
+	/**
+	 * A jump whose target is a label, it's given a displacement once the code is laid out
+	 */
+	struct JumpData
+	{
+		// Bytecode offset of the jump instruction
+		std::size_t Offset = 0;
+		// Label the jump goes to
+		std::size_t Label = 0;
+	};
 
-		// trim off the ending bracket and newlines/whitespace
-		source.pop_back();
-		strip_tailing_if(source, g_is_newline_or_whitespace);
-		strip_leading_if(source, g_is_newline_or_whitespace);
+	/**
+	 * A switch whose displacements are filled in once the code is laid out
+	 */
+	struct SwitchData
+	{
+		// Bytecode offset of the switch instruction
+		std::size_t Offset = 0;
+		// Label jumped to when no case matches
+		std::size_t DefaultLabel = 0;
+		// Label of each entry of the switch's table, in table order
+		std::vector<std::size_t> CaseLabels;
+	};
 
-		// If the block is empty, it is only a valid function if its return type is void
-		if (source.empty())
+	/**
+	 * Bytecode span of a loop, from the jump into it to the end of the branch back
+	 */
+	struct LoopData
+	{
+		std::size_t Start = 0;
+		std::size_t End = 0;
+	};
+
+	/**
+	 * Holds the state of a single function body as it compiles
+	 */
+	struct FunctionCompileState
+	{
+		// Bytecode emitted so far
+		std::vector<std::uint8_t> Code;
+		// Identifiers of the function's variables
+		IdentifierTable Identifiers;
+		// Variables in scope, each symbol's slot is its index into Locals
+		SymbolTable Symbols;
+		// Every variable declared in the function, parameters first
+		std::vector<LocalVariable> Locals;
+		// Pool of the script the function belongs to
+		ConstantPool* Constants = nullptr;
+		// Globals of the script the function belongs to, resolved after the function's own variables
+		const std::vector<GlobalData>* Globals = nullptr;
+		// True once a store to a global has been emitted
+		bool WritesGlobals = false;
+		// Type the function returns
+		SGLTypeId ReturnType = SGL_TYPE_VOID;
+		// Bytecode offset of each label, std::string::npos until the label is placed
+		std::vector<std::size_t> Labels;
+		// Every jump emitted, in code order, all of them in the long form until encode_jumps
+		std::vector<JumpData> Jumps;
+		// Every switch emitted, in code order
+		std::vector<SwitchData> Switches;
+		// Every loop compiled
+		std::vector<LoopData> Loops;
+	};
+
+	/**
+	 * Result of compiling an expression
+	 */
+	struct ExpressionResult
+	{
+		// True if the expression compiled
+		bool Success = false;
+		// Type of the value the expression leaves on the stack, void if it leaves nothing
+		SGLTypeId ResultType = SGL_TYPE_VOID;
+		// True if the expression is a scalar or string constant, whose code is a single push that folding may replace
+		bool IsConstant = false;
+		// Value of an int32 or int64 constant
+		std::int64_t IntValue = 0;
+		// Value of a float or double constant, floats are kept rounded to float precision
+		double FloatValue = 0.0;
+		// Characters of a string constant
+		std::string StringValue;
+	};
+
+	/**
+	 * Binary operators and the arithmetic they perform
+	 */
+	struct OperatorData
+	{
+		char Operator;
+		int Precedence;
+		// Column of the arithmetic table, unused for assignment
+		SGLArithmetic Arithmetic;
+	};
+
+	// Operators in order of lowest to highest precedence
+	const OperatorData g_operators[] =
+	{
+		{ '=', 0, ARITH_COUNT },
+		{ '+', 1, ARITH_ADD },
+		{ '-', 1, ARITH_SUB },
+		{ '*', 2, ARITH_MUL },
+		{ '/', 2, ARITH_DIV },
+		{ '%', 2, ARITH_MOD },
+	};
+
+	/**
+	 * Returns true for the scalar numeric types, int32, float, int64 and double
+	 */
+	bool is_number_type(SGLTypeId type)
+	{
+		return type == SGL_TYPE_INT32 || type == SGL_TYPE_FLOAT || type == SGL_TYPE_INT64 || type == SGL_TYPE_DOUBLE;
+	}
+
+	/**
+	 * Returns the type both operands of a binary operator are converted to
+	 * Mixing numeric types promotes to the wider one, and to a floating type if either side is one
+	 * Unlike C, int64 mixed with float promotes to double, so the result is never narrower than an operand
+	 * An int32 or float mixed with a vector is splatted across the vector's lanes
+	 * Returns SGL_INVALID_TYPE_ID if the types can't be mixed
+	 */
+	SGLTypeId get_promoted_type(SGLTypeId left, SGLTypeId right)
+	{
+		if (left == right)
 		{
-			if (fn.ReturnType == Types::void_type)
-			{
-				return true;
-			}
-			else
+			return left;
+		}
+
+		if (get_vector_lanes(left) != 0 || get_vector_lanes(right) != 0)
+		{
+			SGLTypeId vector = get_vector_lanes(left) != 0 ? left : right;
+			SGLTypeId scalar = get_vector_lanes(left) != 0 ? right : left;
+			if (scalar != SGL_TYPE_INT32 && scalar != SGL_TYPE_FLOAT)
 			{
-				std::cerr << "Missing return statement in function " << fn.FunctionName << std::endl;
-				return false;
+				return SGL_INVALID_TYPE_ID;
 			}
+
+			return vector;
+		}
+
+		if (!is_number_type(left) || !is_number_type(right))
+		{
+			return SGL_INVALID_TYPE_ID;
 		}
 
-		// begin parsing statements
-		bool isDone = false;
-		while (!isDone)
+		bool isFloating = left == SGL_TYPE_FLOAT || left == SGL_TYPE_DOUBLE || right == SGL_TYPE_FLOAT || right == SGL_TYPE_DOUBLE;
+		bool isWide = get_type(left).TypeSize == 8 || get_type(right).TypeSize == 8;
+
+		if (isFloating)
 		{
-			// strip any leading whitespace and newlines
-			strip_leading_if(source, g_is_newline_or_whitespace);
+			return isWide ? SGL_TYPE_DOUBLE : SGL_TYPE_FLOAT;
+		}
 
-			auto endOfStatement = std::string::npos;
+		return isWide ? SGL_TYPE_INT64 : SGL_TYPE_INT32;
+	}
 
-			// check if this is a special statement
-			// "isalnum" check makes sure we don't falsely consider var or func names
-			// that begin with the same letters as the logic flow
-			if (str_starts_with(source, "if") && !std::isalnum(source[2]))
+	/**
+	 * Returns the operator data for a character, or nullptr if it isn't a binary operator
+	 */
+	const OperatorData* get_operator(char c)
+	{
+		for (const auto& op : g_operators)
+		{
+			if (op.Operator == c)
 			{
-				// If condition found
-				// find condition clause
-				auto conditionClauseStart = source.find('(');
-				if (conditionClauseStart == std::string::npos)
-				{
-					// missing conditional open
-					std::cerr << "Missing conditional clause after 'if' keyword" << std::endl;
-					return false;
-				}
+				return &op;
+			}
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * Returns true for any character that can be part of an operator, including comparisons
+	 */
+	bool is_operator_char(char c)
+	{
+		return get_operator(c) != nullptr || c == '<' || c == '>' || c == '!';
+	}
 
-				auto conditionClauseEnd = find_matching_parenthesis(source, conditionClauseStart);
-				// increment clause start to exclude starting parenthesis
-				++conditionClauseStart;
-				// grab substring that represents the conditional
-				auto conditionClauseStr = source.substr(conditionClauseStart, conditionClauseEnd - conditionClauseStart);
+	/**
+	 * Finds the binary operator that should be evaluated last in the expression
+	 * That's the lowest-precedence operator outside of parentheses and quotes, and the rightmost
+	 * one if there's a tie, so that operators of equal precedence evaluate left to right
+	 * Returns std::string::npos if there is no such operator
+	 */
+	std::size_t find_binary_operator(const std::string& expr)
+	{
+		std::size_t found = std::string::npos;
+		int foundPrecedence = 999;
+		int depth = 0;
+		bool inQuotes = false;
+
+		for (std::size_t i = expr.length(); i-- > 0;)
+		{
+			char c = expr[i];
+			if (is_quote_at(expr, i))
+			{
+				inQuotes = !inQuotes;
 			}
-			else if (str_starts_with(source, "for") && !std::isalnum(source[3]))
+			else if (inQuotes)
 			{
-				// For loop found
+				continue;
 			}
-			else if (str_starts_with(source, "while") && !std::isalnum(source[5]))
+			else if (c == ')')
 			{
-				// while loop found
+				++depth;
 			}
-			else if (str_starts_with(source, "return") && !std::isalnum(source[6]))
+			else if (c == '(')
 			{
-				// return statement found
+				--depth;
 			}
-			else
+			else if (depth == 0)
 			{
-				// should be a normal statement, which ends with ;
-				endOfStatement = source.find(';');
-				if (endOfStatement == std::string::npos)
+				const OperatorData* op = get_operator(c);
+				if (!op || op->Precedence >= foundPrecedence)
 				{
-					// missing semicolon
-					std::cerr << "Missing semicolon" << std::endl;
-					return false;
+					continue;
 				}
 
-				auto statementStr = source.substr(0, ++endOfStatement);
-			}
+				// '=' that is part of ==, !=, <= or >= is a comparison, not an assignment
+				if (c == '=' && ((i + 1 < expr.length() && expr[i + 1] == '=') || (i > 0 && is_operator_char(expr[i - 1]))))
+				{
+					continue;
+				}
 
-			source.erase(0, endOfStatement);
+				// an operator with nothing but other operators to its left is unary, such as -5
+				std::size_t prev = i;
+				while (prev > 0 && is_whitespace(expr[prev - 1]))
+				{
+					--prev;
+				}
+				if (prev == 0 || is_operator_char(expr[prev - 1]))
+				{
+					continue;
+				}
 
-			isDone = source.empty();
+				found = i;
+				foundPrecedence = op->Precedence;
+			}
 		}
 
-		return true;
+		return found;
 	}
 
-	bool compile_source(std::string source)
+	/**
+	 * Emits a single instruction with no operands
+	 */
+	void emit_instruction(FunctionCompileState& state, SGLInstruction instruction)
 	{
-		bool result = true;
+		state.Code.push_back(instruction);
+	}
 
-		CompilerState state;
+	/**
+	 * Emits an instruction followed by a 1 byte operand
+	 */
+	void emit_instruction(FunctionCompileState& state, SGLInstruction instruction, std::uint8_t operand)
+	{
+		state.Code.push_back(instruction);
+		state.Code.push_back(operand);
+	}
 
-		// Run preprocessor
-		result = preprocess_source(source);
-		if (!result)
+	/**
+	 * Emits an instruction that loads a constant from the pool
+	 */
+	void emit_pool_load(FunctionCompileState& state, SGLInstruction instruction, std::uint32_t index)
+	{
+		emit_instruction(state, instruction);
+		auto pos = state.Code.size();
+		state.Code.resize(pos + sizeof(std::uint16_t));
+		store_to_buffer<std::uint16_t>(&state.Code[pos], sizeof(std::uint16_t), static_cast<std::uint16_t>(index));
+	}
+
+	/**
+	 * Returns a new label, which marks a place in the code for jumps to go to once it's placed
+	 */
+	std::size_t make_label(FunctionCompileState& state)
+	{
+		state.Labels.push_back(std::string::npos);
+		return state.Labels.size() - 1;
+	}
+
+	/**
+	 * Places a label at the end of the code emitted so far
+	 */
+	void place_label(FunctionCompileState& state, std::size_t label)
+	{
+		state.Labels[label] = state.Code.size();
+	}
+
+	/**
+	 * Emits a jump to a label, in the long form with room for its displacement, see encode_jumps
+	 */
+	void emit_jump(FunctionCompileState& state, SGLInstruction instruction, std::size_t label)
+	{
+		state.Jumps.push_back({ state.Code.size(), label });
+		emit_instruction(state, instruction);
+		state.Code.resize(state.Code.size() + sizeof(std::int32_t));
+	}
+
+	/**
+	 * Emits an instruction to push an int constant
+	 */
+	void emit_int_const(FunctionCompileState& state, int value)
+	{
+		// use the shortest form that holds the value
+		if (value == 0 || value == 1)
 		{
-			return false;
+			emit_instruction(state, value == 0 ? INT_CONST_0 : INT_CONST_1);
 		}
-
-		// Find all function declarations
-		std::size_t lastFunc = 0;
-		while (lastFunc != std::string::npos)
+		else if (value >= std::numeric_limits<std::int8_t>::min() && value <= std::numeric_limits<std::int8_t>::max())
 		{
-			auto funcStart = source.find("func:", lastFunc);
-			if (funcStart != std::string::npos)
+			emit_instruction(state, INT_CONST_8);
+			state.Code.push_back(static_cast<std::uint8_t>(static_cast<std::int8_t>(value)));
+		}
+		else if (value >= std::numeric_limits<std::int16_t>::min() && value <= std::numeric_limits<std::int16_t>::max())
+		{
+			emit_instruction(state, INT_CONST_16);
+			auto pos = state.Code.size();
+			state.Code.resize(pos + sizeof(std::int16_t));
+			store_to_buffer<std::int16_t>(&state.Code[pos], sizeof(std::int16_t), static_cast<std::int16_t>(value));
+		}
+		else
+		{
+			// anything wider comes from the pool, inline only if the pool has run out of room
+			std::uint32_t index = state.Constants->add_int(value);
+			if (index != SGL_INVALID_CONSTANT)
 			{
-				// find opening bracket
-				auto openBracket = source.find('{', funcStart);
-				if (openBracket == std::string::npos)
-				{
-					// function with no body, error
-					auto lineNum = get_line_num(source, funcStart);
-					auto line = get_full_line(source,funcStart);
-					std::cerr << "Function declared on line " << lineNum << ", but no function body was found.\nLine:"
-						<< line << std::endl;
-					return false;
-				}
+				emit_pool_load(state, INT_CONST_POOL, index);
+			}
+			else
+			{
+				emit_instruction(state, INT_CONST);
+				auto pos = state.Code.size();
+				state.Code.resize(pos + sizeof(int));
+				store_to_buffer<int>(&state.Code[pos], sizeof(int), value);
+			}
+		}
+	}
 
-				// find closing bracket
-				auto endBracket = find_matching_bracket(source, openBracket);
-				if (endBracket == std::string::npos)
-				{
-					// function body missing closer
-					// Can't return specific information since it's hard to say where the missing bracket occured
-					std::cerr << "Missing bracket detected while parsing function declarations" << std::endl;
-					return false;
-				}
+	/**
+	 * Replaces 'count' bytes at an offset of the code that has already been emitted with other code
+	 * The replaced bytes can't be variable accesses, every recorded offset past them is shifted to match
+	 */
+	void replace_code(FunctionCompileState& state, std::size_t offset, std::size_t count, const std::vector<std::uint8_t>& code)
+	{
+		if (count == 0 && code.empty())
+		{
+			return;
+		}
 
-				auto funcSource = source.substr(funcStart, endBracket + 1);
-				auto fn = parse_function_def(funcSource);
-				if (!fn.is_valid())
-				{
-					return false;
-				}
+		state.Code.erase(state.Code.begin() + offset, state.Code.begin() + offset + count);
+		state.Code.insert(state.Code.begin() + offset, code.begin(), code.end());
 
-				state.Functions.push_back(fn);
+		auto shift = [&](std::size_t& pos)
+		{
+			if (pos >= offset + count)
+			{
+				pos = pos - count + code.size();
+			}
+		};
 
-				lastFunc = endBracket;
+		for (auto& var : state.Locals)
+		{
+			for (auto& operand : var.OperandOffsets)
+			{
+				shift(operand);
 			}
-			else
+
+			shift(var.LiveStart);
+			shift(var.LiveEnd);
+		}
+
+		for (auto& jump : state.Jumps)
+		{
+			shift(jump.Offset);
+		}
+
+		for (auto& switchData : state.Switches)
+		{
+			shift(switchData.Offset);
+		}
+
+		// code put in right at a label comes after it, it's part of whatever the label marks the start of
+		auto shift_label = [&](std::size_t& pos)
+		{
+			if (pos != std::string::npos && pos > offset)
 			{
-				lastFunc = std::string::npos;
+				shift(pos);
 			}
+		};
+
+		for (auto& label : state.Labels)
+		{
+			shift_label(label);
+		}
+
+		for (auto& loop : state.Loops)
+		{
+			shift_label(loop.Start);
+			shift_label(loop.End);
+		}
+	}
+
+	/**
+	 * Inserts code at an offset of the code that has already been emitted
+	 */
+	void insert_code(FunctionCompileState& state, std::size_t offset, const std::vector<std::uint8_t>& code)
+	{
+		replace_code(state, offset, 0, code);
+	}
+
+	/**
+	 * Builds the code that converts an operand to the type get_promoted_type picked for it
+	 * Returns false if there's no such conversion
+	 */
+	bool get_promotion_code(SGLTypeId from, SGLTypeId to, std::vector<std::uint8_t>& code)
+	{
+		if (from == to)
+		{
+			return true;
+		}
+
+		std::uint8_t lanes = get_vector_lanes(to);
+		if (lanes != 0)
+		{
+			// scalars are splatted, ints go through float first
+			if (from == SGL_TYPE_INT32)
+			{
+				code.push_back(INT_TO_FLOAT);
+			}
+			else if (from != SGL_TYPE_FLOAT)
+			{
+				return false;
+			}
+
+			code.push_back(VEC_SPLAT);
+			code.push_back(lanes);
+			return true;
+		}
+
+		if (to == SGL_TYPE_STRING)
+		{
+			// numbers joined to a string become the text print gives them
+			if (!is_number_type(from))
+			{
+				return false;
+			}
+
+			code.push_back(NUMBER_TO_STRING);
+			code.push_back(static_cast<std::uint8_t>(from));
+			return true;
+		}
+
+		SGLInstruction cast = get_cast_instruction(from, to);
+		if (cast == INVALID_INSTRUCTION)
+		{
+			return false;
+		}
+
+		code.push_back(cast);
+		return true;
+	}
+
+	/**
+	 * Emits the zero value of a type
+	 * Every numeric type is zero when all of its bits are, so the integer zeros serve them all
+	 * Native object variables start out as null pointers, and strings as empty inline strings
+	 */
+	bool emit_zero(FunctionCompileState& state, SGLTypeId type)
+	{
+		switch (get_type(type).get_value_size())
+		{
+			case sizeof(std::uint32_t):
+				emit_instruction(state, INT_CONST_0);
+				return true;
+			case sizeof(std::uint64_t):
+				emit_instruction(state, INT64_CONST_0);
+				return true;
+			case sizeof(SGLVector):
+				// a float 0 splatted across the lanes
+				emit_instruction(state, INT_CONST_0);
+				emit_instruction(state, VEC_SPLAT, 4);
+				return true;
+			default:
+				std::cerr << "Variables of type " << get_type(type).TypeName << " are not supported yet" << std::endl;
+				return false;
+		}
+	}
+
+	/**
+	 * Emits an instruction followed by an inline 8 byte constant
+	 */
+	template <class T>
+	void emit_wide_const(FunctionCompileState& state, SGLInstruction instruction, T value)
+	{
+		static_assert(sizeof(T) == 8, "Wide constants are 8 bytes");
+
+		emit_instruction(state, instruction);
+		auto pos = state.Code.size();
+		state.Code.resize(pos + sizeof(T));
+		store_to_buffer<T>(&state.Code[pos], sizeof(T), value);
+	}
+
+	/**
+	 * Emits an instruction to push a float constant
+	 */
+	void emit_float_const(FunctionCompileState& state, float value)
+	{
+		std::uint32_t index = state.Constants->add_float(value);
+		if (index != SGL_INVALID_CONSTANT)
+		{
+			emit_pool_load(state, FLOAT_CONST_POOL, index);
+		}
+		else
+		{
+			// pool is out of room, fall back to an inline constant
+			emit_instruction(state, FLOAT_CONST);
+			auto pos = state.Code.size();
+			state.Code.resize(pos + sizeof(float));
+			store_to_buffer<float>(&state.Code[pos], sizeof(float), value);
+		}
+	}
+
+	/**
+	 * Emits an instruction to push a string constant
+	 * Returns false if the pool has run out of room, strings have no inline form to fall back to
+	 */
+	bool emit_string_const(FunctionCompileState& state, const std::string& value)
+	{
+		std::uint32_t index = state.Constants->add_string(value);
+		if (index == SGL_INVALID_CONSTANT)
+		{
+			std::cerr << "Too many string constants, the pool holds " << SGL_MAX_CONSTANTS << std::endl;
+			return false;
+		}
+
+		emit_instruction(state, STRING_CONST_POOL);
+		auto pos = state.Code.size();
+		state.Code.resize(pos + sizeof(std::uint16_t));
+		store_to_buffer<std::uint16_t>(&state.Code[pos], sizeof(std::uint16_t), static_cast<std::uint16_t>(index));
+		return true;
+	}
+
+	/**
+	 * Returns true if the expression is a single string literal, quoted from its first character to its last
+	 */
+	bool is_string_literal(const std::string& expr)
+	{
+		if (expr.length() < 2 || !is_quote_at(expr, 0))
+		{
+			return false;
+		}
+
+		std::size_t close = 1;
+		while (close < expr.length() && !is_quote_at(expr, close))
+		{
+			++close;
+		}
+
+		return close == expr.length() - 1;
+	}
+
+	/**
+	 * Returns the characters of a string literal, with its quotes removed and its escapes replaced
+	 * Returns false if the literal has an escape that isn't \n, \t, \\ or \"
+	 */
+	bool parse_string_literal(const std::string& literal, std::string& value)
+	{
+		value.clear();
+		for (std::size_t i = 1; i + 1 < literal.length(); ++i)
+		{
+			if (literal[i] != '\\')
+			{
+				value.push_back(literal[i]);
+				continue;
+			}
+
+			switch (literal[++i])
+			{
+				case 'n': value.push_back('\n'); break;
+				case 't': value.push_back('\t'); break;
+				case '\\': value.push_back('\\'); break;
+				case '"': value.push_back('"'); break;
+				default:
+					std::cerr << "Unknown escape sequence \\" << literal[i] << " in string " << literal << std::endl;
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * Returns true for the floating point scalar types
+	 */
+	bool is_floating_type(SGLTypeId type)
+	{
+		return type == SGL_TYPE_FLOAT || type == SGL_TYPE_DOUBLE;
+	}
+
+	/**
+	 * Returns the result of a constant expression of the given type
+	 * Ints are wrapped and floats are rounded the way the VM would store them
+	 */
+	ExpressionResult make_constant(SGLTypeId type, std::int64_t intValue, double floatValue)
+	{
+		ExpressionResult result;
+		result.Success = true;
+		result.ResultType = type;
+		result.IsConstant = true;
+
+		switch (type)
+		{
+			case SGL_TYPE_INT32:
+				result.IntValue = static_cast<std::int32_t>(static_cast<std::uint32_t>(intValue));
+				break;
+			case SGL_TYPE_INT64:
+				result.IntValue = intValue;
+				break;
+			case SGL_TYPE_FLOAT:
+				result.FloatValue = static_cast<float>(floatValue);
+				break;
+			default:
+				result.FloatValue = floatValue;
+				break;
+		}
+
+		return result;
+	}
+
+	/**
+	 * Emits the push of a constant in the shortest form its type allows
+	 */
+	void emit_constant(FunctionCompileState& state, const ExpressionResult& constant)
+	{
+		switch (constant.ResultType)
+		{
+			case SGL_TYPE_INT32:
+				emit_int_const(state, static_cast<int>(constant.IntValue));
+				break;
+			case SGL_TYPE_INT64:
+				if (constant.IntValue == 0)
+				{
+					emit_instruction(state, INT64_CONST_0);
+				}
+				else
+				{
+					emit_wide_const<std::int64_t>(state, INT64_CONST, constant.IntValue);
+				}
+				break;
+			case SGL_TYPE_FLOAT:
+				emit_float_const(state, static_cast<float>(constant.FloatValue));
+				break;
+			default:
+				emit_wide_const<double>(state, DOUBLE_CONST, constant.FloatValue);
+				break;
+		}
+	}
+
+	/**
+	 * Converts a constant to another scalar type with the same rules as the cast instructions
+	 */
+	ExpressionResult convert_constant(const ExpressionResult& constant, SGLTypeId to)
+	{
+		if (is_floating_type(constant.ResultType))
+		{
+			double value = constant.FloatValue;
+			if (is_floating_type(to))
+			{
+				return make_constant(to, 0, value);
+			}
+
+			return make_constant(to, to == SGL_TYPE_INT32 ? static_cast<std::int32_t>(value) : static_cast<std::int64_t>(value), 0.0);
+		}
+
+		// int64 to float rounds once, straight from the integer
+		double value = to == SGL_TYPE_FLOAT ? static_cast<float>(constant.IntValue) : static_cast<double>(constant.IntValue);
+		return make_constant(to, constant.IntValue, value);
+	}
+
+	/**
+	 * Replaces the code of a constant operand between 'start' and 'end' with the code for the
+	 * constant converted to another type, so the conversion costs nothing at runtime
+	 */
+	void refold_constant(FunctionCompileState& state, std::size_t start, std::size_t end, ExpressionResult& constant, SGLTypeId to)
+	{
+		constant = convert_constant(constant, to);
+
+		std::size_t folded = state.Code.size();
+		emit_constant(state, constant);
+		std::vector<std::uint8_t> code(state.Code.begin() + folded, state.Code.end());
+		state.Code.resize(folded);
+
+		replace_code(state, start, end - start, code);
+	}
+
+	/**
+	 * Returns the text of a number constant, the same text NUMBER_TO_STRING and print give it at runtime
+	 */
+	std::string get_constant_text(const ExpressionResult& constant)
+	{
+		std::string text;
+		switch (constant.ResultType)
+		{
+			case SGL_TYPE_INT32:
+				append_text(text, static_cast<std::int32_t>(constant.IntValue));
+				break;
+			case SGL_TYPE_FLOAT:
+				append_text(text, static_cast<float>(constant.FloatValue));
+				break;
+			case SGL_TYPE_INT64:
+				append_text(text, constant.IntValue);
+				break;
+			default:
+				append_text(text, constant.FloatValue);
+				break;
+		}
+
+		return text;
+	}
+
+	/**
+	 * Replaces the code of a number constant between 'start' and 'end' with a string constant of its text
+	 * Returns false if the constant pool has run out of room
+	 */
+	bool restring_constant(FunctionCompileState& state, std::size_t start, std::size_t end, ExpressionResult& constant)
+	{
+		constant.StringValue = get_constant_text(constant);
+		constant.ResultType = SGL_TYPE_STRING;
+
+		std::size_t folded = state.Code.size();
+		if (!emit_string_const(state, constant.StringValue))
+		{
+			return false;
+		}
+
+		std::vector<std::uint8_t> code(state.Code.begin() + folded, state.Code.end());
+		state.Code.resize(folded);
+
+		replace_code(state, start, end - start, code);
+		return true;
+	}
+
+	/**
+	 * Works out the arithmetic on two constants of the same type
+	 * Returns false for anything that should be left to fail at runtime, like dividing by zero
+	 */
+	bool fold_arithmetic(SGLArithmetic op, const ExpressionResult& left, const ExpressionResult& right, ExpressionResult& result)
+	{
+		SGLTypeId type = left.ResultType;
+		if (is_floating_type(type))
+		{
+			double lh = left.FloatValue;
+			double rh = right.FloatValue;
+			if (type == SGL_TYPE_FLOAT)
+			{
+				// float arithmetic has to round like the VM's does
+				float flh = static_cast<float>(lh);
+				float frh = static_cast<float>(rh);
+				switch (op)
+				{
+					case ARITH_ADD: result = make_constant(type, 0, flh + frh); return true;
+					case ARITH_SUB: result = make_constant(type, 0, flh - frh); return true;
+					case ARITH_MUL: result = make_constant(type, 0, flh * frh); return true;
+					case ARITH_DIV: result = make_constant(type, 0, flh / frh); return true;
+					default: return false;
+				}
+			}
+
+			switch (op)
+			{
+				case ARITH_ADD: result = make_constant(type, 0, lh + rh); return true;
+				case ARITH_SUB: result = make_constant(type, 0, lh - rh); return true;
+				case ARITH_MUL: result = make_constant(type, 0, lh * rh); return true;
+				case ARITH_DIV: result = make_constant(type, 0, lh / rh); return true;
+				default: return false;
+			}
+		}
+
+		// wrap like the VM's two's complement arithmetic does
+		std::uint64_t lh = static_cast<std::uint64_t>(left.IntValue);
+		std::uint64_t rh = static_cast<std::uint64_t>(right.IntValue);
+		std::int64_t lowest = type == SGL_TYPE_INT32 ? std::numeric_limits<std::int32_t>::min() : std::numeric_limits<std::int64_t>::min();
+		switch (op)
+		{
+			case ARITH_ADD: result = make_constant(type, static_cast<std::int64_t>(lh + rh), 0.0); return true;
+			case ARITH_SUB: result = make_constant(type, static_cast<std::int64_t>(lh - rh), 0.0); return true;
+			case ARITH_MUL: result = make_constant(type, static_cast<std::int64_t>(lh * rh), 0.0); return true;
+			case ARITH_DIV:
+			case ARITH_MOD:
+				if (right.IntValue == 0 || (left.IntValue == lowest && right.IntValue == -1))
+				{
+					return false;
+				}
+				result = make_constant(type, op == ARITH_DIV ? left.IntValue / right.IntValue : left.IntValue % right.IntValue, 0.0);
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	/**
+	 * Emits an instruction that reads or writes a variable
+	 * The slot operand is a placeholder until allocate_frame_slots patches in the real slot
+	 */
+	void emit_variable_access(FunctionCompileState& state, SGLInstruction instruction, std::size_t local)
+	{
+		emit_instruction(state, instruction);
+
+		auto& var = state.Locals[local];
+		var.OperandOffsets.push_back(state.Code.size());
+		var.LiveEnd = state.Code.size();
+
+		state.Code.push_back(0);
+	}
+
+	/**
+	 * Declares a variable in the current scope, its value must be stored by the very next instruction
+	 * Returns the variable's index in the local list, or std::string::npos if it's already declared
+	 */
+	std::size_t declare_local(FunctionCompileState& state, const std::string& name, SGLTypeId type)
+	{
+		std::size_t local = state.Locals.size();
+		if (!state.Symbols.declare(state.Identifiers.intern(name), type, local))
+		{
+			std::cerr << "Cannot declare two variables with the same identifier: " << name << std::endl;
+			return std::string::npos;
+		}
+
+		LocalVariable var;
+		var.Type = type;
+		var.SlotCount = std::max<std::size_t>(1, get_type(type).get_value_size() / SGL_SLOT_SIZE);
+		var.LiveStart = state.Code.size();
+		var.LiveEnd = state.Code.size();
+		state.Locals.push_back(var);
+
+		return local;
+	}
+
+	/**
+	 * Returns the index in the local list of the visible variable with the given name
+	 * Returns std::string::npos if there is none
+	 */
+	std::size_t find_local(FunctionCompileState& state, const std::string& name)
+	{
+		const Symbol* sym = state.Symbols.resolve(state.Identifiers.find(name));
+		if (!sym)
+		{
+			return std::string::npos;
+		}
+
+		return sym->Slot;
+	}
+
+	/**
+	 * Returns the global with the given name, or nullptr if the function's script has none
+	 */
+	const GlobalData* find_global(FunctionCompileState& state, const std::string& name)
+	{
+		if (!state.Globals)
+		{
+			return nullptr;
+		}
+
+		for (const auto& global : *state.Globals)
+		{
+			if (global.GlobalName == name)
+			{
+				return &global;
+			}
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * Emits an instruction that touches a global, followed by the global's offset into the globals block
+	 */
+	void emit_global_access(FunctionCompileState& state, SGLInstruction instruction, const GlobalData& global)
+	{
+		emit_instruction(state, instruction);
+		auto pos = state.Code.size();
+		state.Code.resize(pos + sizeof(std::uint16_t));
+		store_to_buffer<std::uint16_t>(&state.Code[pos], sizeof(std::uint16_t), static_cast<std::uint16_t>(global.Offset));
+	}
+
+	/**
+	 * Emits a cast of the value on top of the stack if the types differ
+	 * Returns false if there is no cast between the types
+	 */
+	bool emit_cast(FunctionCompileState& state, SGLTypeId from, SGLTypeId to)
+	{
+		if (from == to)
+		{
+			return true;
+		}
+
+		SGLInstruction cast = get_cast_instruction(from, to);
+		if (cast == INVALID_INSTRUCTION)
+		{
+			std::cerr << "Cannot convert " << get_type(from).TypeName << " to " << get_type(to).TypeName << std::endl;
+			return false;
+		}
+
+		emit_instruction(state, cast);
+		return true;
+	}
+
+	/**
+	 * Emits the store of the value on top of the stack into a variable
+	 */
+	bool emit_store(FunctionCompileState& state, std::size_t local, SGLTypeId valueType)
+	{
+		SGLTypeId varType = state.Locals[local].Type;
+		if (!emit_cast(state, valueType, varType))
+		{
+			return false;
+		}
+
+		SGLInstruction store = get_store_instruction(varType);
+		if (store == INVALID_INSTRUCTION)
+		{
+			std::cerr << "Variables of type " << get_type(varType).TypeName << " are not supported yet" << std::endl;
+			return false;
+		}
+
+		emit_variable_access(state, store, local);
+		return true;
+	}
+
+	/**
+	 * Splits a declaration such as "int32 x" into its type and identifier
+	 * Returns false if it isn't a valid declaration
+	 */
+	bool parse_declaration(const std::string& decl, SGLTypeId& type, std::string& name)
+	{
+		auto typeEnd = std::find_if_not(decl.begin(), decl.end(), g_is_alnum);
+		std::string typeStr = decl.substr(0, typeEnd - decl.begin());
+		name = decl.substr(typeEnd - decl.begin());
+		strip_leading_whitespace(name);
+
+		const SGLType& declType = get_type(typeStr);
+		if (!declType.is_valid())
+		{
+			std::cerr << "Unrecognized type " << typeStr << " in variable declaration" << std::endl;
+			return false;
+		}
+		else if (declType.TypeId == SGL_TYPE_VOID)
+		{
+			std::cerr << "Illegal use of void type in variable declaration" << std::endl;
+			return false;
+		}
+
+		if (name.empty() || std::isdigit(name[0]) || !is_alphanumeric(name))
+		{
+			std::cerr << "Invalid variable identifier '" << name << "'" << std::endl;
+			return false;
+		}
+
+		type = declType.TypeId;
+		return true;
+	}
+
+	ExpressionResult compile_expression(FunctionCompileState& state, std::string expr);
+
+	/**
+	 * Returns the field of a native object type with the given name
+	 * Returns nullptr if the type isn't a native object or has no such field
+	 */
+	const SGLField* find_object_field(SGLTypeId type, const std::string& member)
+	{
+		const SGLType& objectType = get_type(type);
+		if (!objectType.IsNativeObject)
+		{
+			std::cerr << objectType.TypeName << " has no field " << member << std::endl;
+			return nullptr;
+		}
+
+		const SGLField* field = objectType.find_field(member);
+		if (!field)
+		{
+			std::cerr << objectType.TypeName << " has no field named " << member << std::endl;
+		}
+
+		return field;
+	}
+
+	/**
+	 * Emits an instruction that reads or writes a native object's field
+	 * The offset is a constant, so the VM reaches the field with a single load or store
+	 */
+	void emit_field_access(FunctionCompileState& state, SGLInstruction instruction, const SGLField& field)
+	{
+		emit_instruction(state, instruction);
+		auto pos = state.Code.size();
+		state.Code.resize(pos + sizeof(std::uint16_t));
+		store_to_buffer<std::uint16_t>(&state.Code[pos], sizeof(std::uint16_t), static_cast<std::uint16_t>(field.Offset));
+	}
+
+	/**
+	 * Compiles "object.member", a lane of a vector or a field of a native object
+	 */
+	ExpressionResult compile_member_access(FunctionCompileState& state, const std::string& object, const std::string& member)
+	{
+		ExpressionResult result;
+
+		auto objectResult = compile_expression(state, object);
+		if (!objectResult.Success)
+		{
+			return result;
+		}
+
+		std::uint8_t laneCount = get_vector_lanes(objectResult.ResultType);
+		if (laneCount != 0)
+		{
+			static const std::string lanes = "xyzw";
+			auto lane = member.length() == 1 ? lanes.find(member[0]) : std::string::npos;
+			if (lane >= laneCount)
+			{
+				std::cerr << get_type(objectResult.ResultType).TypeName << " has no lane " << member << std::endl;
+				return result;
+			}
+
+			emit_instruction(state, VEC_EXTRACT, static_cast<std::uint8_t>(lane));
+
+			result.Success = true;
+			result.ResultType = SGL_TYPE_FLOAT;
+			return result;
+		}
+
+		const SGLField* field = find_object_field(objectResult.ResultType, member);
+		if (!field)
+		{
+			return result;
+		}
+
+		emit_field_access(state, get_field_load_instruction(field->Type), *field);
+
+		result.Success = true;
+		result.ResultType = field->Type;
+		return result;
+	}
+
+	/**
+	 * Compiles "object.member = value" once the value has been compiled
+	 * 'valueStart' is where the value's code begins, it ends where the object's code is about to begin
+	 */
+	ExpressionResult compile_field_store(FunctionCompileState& state, const std::string& object, const std::string& member,
+		ExpressionResult value, std::size_t valueStart)
+	{
+		ExpressionResult result;
+
+		// the pointer goes on top of the value, so the value keeps the left to right order of everything else
+		std::size_t valueEnd = state.Code.size();
+		auto objectResult = compile_expression(state, object);
+		if (!objectResult.Success)
+		{
+			return result;
+		}
+
+		const SGLField* field = find_object_field(objectResult.ResultType, member);
+		if (!field)
+		{
+			return result;
+		}
+
+		// the value is under the pointer, so its conversion goes in right after it
+		if (value.ResultType != field->Type)
+		{
+			SGLInstruction cast = get_cast_instruction(value.ResultType, field->Type);
+			if (cast == INVALID_INSTRUCTION)
+			{
+				std::cerr << "Cannot convert " << get_type(value.ResultType).TypeName << " to " << get_type(field->Type).TypeName
+					<< " for field " << member << std::endl;
+				return result;
+			}
+
+			if (value.IsConstant)
+			{
+				refold_constant(state, valueStart, valueEnd, value, field->Type);
+			}
+			else
+			{
+				insert_code(state, valueEnd, { cast });
+			}
+		}
+
+		emit_field_access(state, get_field_store_instruction(field->Type), *field);
+
+		result.Success = true;
+		result.ResultType = SGL_TYPE_VOID;
+		return result;
+	}
+
+	/**
+	 * Compiles "left = right" where left is a new declaration, an existing variable, or a native object's field
+	 */
+	ExpressionResult compile_assignment(FunctionCompileState& state, std::string left, const std::string& right)
+	{
+		ExpressionResult result;
+
+		strip_leading_whitespace(left);
+		strip_tailing_whitespace(left);
+
+		// right side goes first so a declaration can't see itself, and so the new variable's
+		// lifetime starts at the store instead of overlapping everything the right side reads
+		std::size_t rightStart = state.Code.size();
+		auto rightResult = compile_expression(state, right);
+		if (!rightResult.Success)
+		{
+			return result;
+		}
+		else if (rightResult.ResultType == SGL_TYPE_VOID)
+		{
+			std::cerr << "Right side of assignment to " << left << " has no value" << std::endl;
+			return result;
+		}
+
+		// a declaration never has a dot in it, but the object expression of a field might have spaces
+		auto dot = left.rfind('.');
+		if (dot != std::string::npos)
+		{
+			return compile_field_store(state, left.substr(0, dot), left.substr(dot + 1), rightResult, rightStart);
+		}
+
+		std::size_t local = std::string::npos;
+		const GlobalData* global = nullptr;
+		SGLTypeId type;
+		std::string name;
+		bool isDeclaration = std::any_of(left.begin(), left.end(), g_is_whitespace);
+		if (isDeclaration)
+		{
+			// declaration with an initial value
+			if (!parse_declaration(left, type, name))
+			{
+				return result;
+			}
+		}
+		else
+		{
+			// locals shadow globals
+			local = find_local(state, left);
+			if (local != std::string::npos)
+			{
+				type = state.Locals[local].Type;
+			}
+			else if ((global = find_global(state, left)) != nullptr)
+			{
+				type = global->GlobalType;
+			}
+			else
+			{
+				std::cerr << "Assignment to undeclared variable " << left << std::endl;
+				return result;
+			}
+		}
+
+		// a constant is converted to the variable's type here rather than at runtime
+		if (rightResult.IsConstant && rightResult.ResultType != type && get_cast_instruction(rightResult.ResultType, type) != INVALID_INSTRUCTION)
+		{
+			refold_constant(state, rightStart, state.Code.size(), rightResult, type);
+		}
+
+		if (global)
+		{
+			if (!emit_cast(state, rightResult.ResultType, type))
+			{
+				return result;
+			}
+
+			emit_global_access(state, get_global_store_instruction(type), *global);
+			state.WritesGlobals = true;
+
+			result.Success = true;
+			result.ResultType = SGL_TYPE_VOID;
+			return result;
+		}
+
+		if (isDeclaration)
+		{
+			local = declare_local(state, name, type);
+		}
+
+		if (local == std::string::npos || !emit_store(state, local, rightResult.ResultType))
+		{
+			return result;
+		}
+
+		result.Success = true;
+		result.ResultType = SGL_TYPE_VOID;
+		return result;
+	}
+
+	/**
+	 * Splits the argument list of a call on the commas that aren't nested inside parentheses or strings
+	 */
+	std::vector<std::string> split_arguments(const std::string& argList)
+	{
+		std::vector<std::string> args;
+		if (std::all_of(argList.begin(), argList.end(), g_is_newline_or_whitespace))
+		{
+			return args;
+		}
+
+		int depth = 0;
+		bool inQuotes = false;
+		std::size_t argStart = 0;
+		for (std::size_t i = 0; i < argList.length(); ++i)
+		{
+			if (is_quote_at(argList, i))
+			{
+				inQuotes = !inQuotes;
+			}
+			else if (inQuotes)
+			{
+				continue;
+			}
+			else if (argList[i] == '(')
+			{
+				++depth;
+			}
+			else if (argList[i] == ')')
+			{
+				--depth;
+			}
+			else if (argList[i] == ',' && depth == 0)
+			{
+				args.push_back(argList.substr(argStart, i - argStart));
+				argStart = i + 1;
+			}
+		}
+		args.push_back(argList.substr(argStart));
+
+		return args;
+	}
+
+	/**
+	 * Compiles the arguments of a vector built-in, which must all be the same vector type
+	 * Returns the vector type, or SGL_INVALID_TYPE_ID on failure
+	 */
+	SGLTypeId compile_vector_arguments(FunctionCompileState& state, const char* function, const std::vector<std::string>& args)
+	{
+		SGLTypeId type = SGL_INVALID_TYPE_ID;
+		for (const auto& arg : args)
+		{
+			auto argResult = compile_expression(state, arg);
+			if (!argResult.Success)
+			{
+				return SGL_INVALID_TYPE_ID;
+			}
+
+			if (get_vector_lanes(argResult.ResultType) == 0 || (type != SGL_INVALID_TYPE_ID && argResult.ResultType != type))
+			{
+				std::cerr << "Arguments of " << function << " must all be the same vector type, got "
+					<< get_type(argResult.ResultType).TypeName << std::endl;
+				return SGL_INVALID_TYPE_ID;
+			}
+
+			type = argResult.ResultType;
+		}
+
+		return type;
+	}
+
+	ExpressionResult compile_dot(FunctionCompileState& state, const std::vector<std::string>& args)
+	{
+		ExpressionResult result;
+
+		SGLTypeId type = compile_vector_arguments(state, "dot", args);
+		if (type != SGL_INVALID_TYPE_ID)
+		{
+			emit_instruction(state, VEC_DOT, get_vector_lanes(type));
+
+			result.Success = true;
+			result.ResultType = SGL_TYPE_FLOAT;
+		}
+
+		return result;
+	}
+
+	ExpressionResult compile_cross(FunctionCompileState& state, const std::vector<std::string>& args)
+	{
+		ExpressionResult result;
+
+		SGLTypeId type = compile_vector_arguments(state, "cross", args);
+		if (type != SGL_INVALID_TYPE_ID)
+		{
+			if (type != SGL_TYPE_VEC3)
+			{
+				std::cerr << "cross is only defined for vec3" << std::endl;
+				return result;
+			}
+
+			emit_instruction(state, VEC_CROSS);
+
+			result.Success = true;
+			result.ResultType = type;
+		}
+
+		return result;
+	}
+
+	ExpressionResult compile_length(FunctionCompileState& state, const std::vector<std::string>& args)
+	{
+		ExpressionResult result;
+
+		SGLTypeId type = compile_vector_arguments(state, "length", args);
+		if (type != SGL_INVALID_TYPE_ID)
+		{
+			emit_instruction(state, VEC_LENGTH, get_vector_lanes(type));
+
+			result.Success = true;
+			result.ResultType = SGL_TYPE_FLOAT;
+		}
+
+		return result;
+	}
+
+	ExpressionResult compile_normalize(FunctionCompileState& state, const std::vector<std::string>& args)
+	{
+		ExpressionResult result;
+
+		SGLTypeId type = compile_vector_arguments(state, "normalize", args);
+		if (type != SGL_INVALID_TYPE_ID)
+		{
+			emit_instruction(state, VEC_NORMALIZE, get_vector_lanes(type));
+
+			result.Success = true;
+			result.ResultType = type;
+		}
+
+		return result;
+	}
+
+	/**
+	 * Compiles print, which takes any number of values of built-in types and prints them as one line
+	 * Each value is printed as soon as it's computed, so the line never needs more than one value on the stack
+	 */
+	ExpressionResult compile_print(FunctionCompileState& state, const std::vector<std::string>& args)
+	{
+		ExpressionResult result;
+
+		for (const auto& arg : args)
+		{
+			auto argResult = compile_expression(state, arg);
+			if (!argResult.Success)
+			{
+				return result;
+			}
+
+			if (argResult.ResultType >= SGL_TYPE_VOID)
+			{
+				std::cerr << "Values of type " << get_type(argResult.ResultType).TypeName << " can't be printed" << std::endl;
+				return result;
+			}
+
+			emit_instruction(state, PRINT, static_cast<std::uint8_t>(argResult.ResultType));
+		}
+
+		emit_instruction(state, PRINT_END);
+
+		result.Success = true;
+		result.ResultType = SGL_TYPE_VOID;
+		return result;
+	}
+
+	/**
+	 * Functions the compiler lowers straight to instructions instead of calling
+	 */
+	struct BuiltinFunction
+	{
+		// ArgCount of a built-in that takes any number of arguments
+		static constexpr std::size_t VARIADIC = std::numeric_limits<std::size_t>::max();
+
+		const char* Name;
+		std::size_t ArgCount;
+		ExpressionResult (*Compile)(FunctionCompileState& state, const std::vector<std::string>& args);
+	};
+
+	const BuiltinFunction g_builtins[] =
+	{
+		{ "dot", 2, compile_dot },
+		{ "cross", 2, compile_cross },
+		{ "length", 1, compile_length },
+		{ "normalize", 1, compile_normalize },
+		{ "print", BuiltinFunction::VARIADIC, compile_print },
+	};
+
+	/**
+	 * Converts arguments that have already been compiled to the types a call expects
+	 * 'bounds' holds where each argument's code begins, plus where the last one ends
+	 * Works back to front so the earlier bounds stay put, constants are converted at compile time
+	 */
+	bool convert_arguments(FunctionCompileState& state, std::vector<ExpressionResult>& args, const std::vector<std::size_t>& bounds,
+		const std::vector<SGLTypeId>& types)
+	{
+		for (std::size_t i = args.size(); i-- > 0;)
+		{
+			if (args[i].ResultType == types[i])
+			{
+				continue;
+			}
+
+			SGLInstruction cast = get_cast_instruction(args[i].ResultType, types[i]);
+			if (cast == INVALID_INSTRUCTION)
+			{
+				std::cerr << "Cannot convert argument " << i + 1 << " from " << get_type(args[i].ResultType).TypeName
+					<< " to " << get_type(types[i]).TypeName << std::endl;
+				return false;
+			}
+
+			if (args[i].IsConstant)
+			{
+				refold_constant(state, bounds[i], bounds[i + 1], args[i], types[i]);
+			}
+			else
+			{
+				insert_code(state, bounds[i + 1], { cast });
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * Compiles a call to a registered native function
+	 */
+	ExpressionResult compile_native_call(FunctionCompileState& state, std::uint32_t index, const std::vector<std::string>& args)
+	{
+		ExpressionResult result;
+
+		const SGLNativeFunction& native = get_native_registry().get_function(index);
+		if (args.size() != native.ParamCount)
+		{
+			std::cerr << native.Name << " takes " << native.ParamCount << " arguments, got " << args.size() << std::endl;
+			return result;
+		}
+
+		std::vector<std::size_t> bounds = { state.Code.size() };
+		std::vector<ExpressionResult> argResults;
+		for (const auto& arg : args)
+		{
+			auto argResult = compile_expression(state, arg);
+			if (!argResult.Success)
+			{
+				return result;
+			}
+
+			argResults.push_back(argResult);
+			bounds.push_back(state.Code.size());
+		}
+
+		if (!convert_arguments(state, argResults, bounds, native.get_param_types()))
+		{
+			std::cerr << "In call to " << native.Name << std::endl;
+			return result;
+		}
+
+		emit_instruction(state, CALL_NATIVE);
+		auto pos = state.Code.size();
+		state.Code.resize(pos + sizeof(std::uint16_t));
+		store_to_buffer<std::uint16_t>(&state.Code[pos], sizeof(std::uint16_t), static_cast<std::uint16_t>(index));
+
+		result.Success = true;
+		result.ResultType = native.get_return_type();
+		return result;
+	}
+
+	/**
+	 * Math functions that lower to a single instruction
+	 */
+	struct MathIntrinsic
+	{
+		const char* Name;
+		std::size_t ArgCount;
+		// Instruction for float arguments, int32 arguments are converted to float for it
+		SGLInstruction FloatInstruction;
+		// Instruction used when every argument is an int32, or INVALID_INSTRUCTION if there's none
+		SGLInstruction IntInstruction;
+	};
+
+	const MathIntrinsic g_math_intrinsics[] =
+	{
+		{ "sqrt", 1, FLOAT_SQRT, INVALID_INSTRUCTION },
+		{ "abs", 1, FLOAT_ABS, INT_ABS },
+		{ "floor", 1, FLOAT_FLOOR, INVALID_INSTRUCTION },
+		{ "sin", 1, FLOAT_SIN, INVALID_INSTRUCTION },
+		{ "cos", 1, FLOAT_COS, INVALID_INSTRUCTION },
+		{ "min", 2, FLOAT_MINIMUM, INT_MINIMUM },
+		{ "max", 2, FLOAT_MAXIMUM, INT_MAXIMUM },
+		{ "clamp", 3, FLOAT_CLAMP, INT_CLAMP },
+	};
+
+	/**
+	 * Works out a math intrinsic on constant arguments, which are already converted to its argument type
+	 * Returns false for anything that should be left to happen at runtime
+	 */
+	bool fold_intrinsic(SGLInstruction instruction, const std::vector<ExpressionResult>& args, ExpressionResult& result)
+	{
+		if (instruction == INT_ABS || instruction == INT_MINIMUM || instruction == INT_MAXIMUM || instruction == INT_CLAMP)
+		{
+			std::int32_t value = static_cast<std::int32_t>(args[0].IntValue);
+			switch (instruction)
+			{
+				case INT_ABS:
+					if (value == std::numeric_limits<std::int32_t>::min())
+					{
+						return false;
+					}
+					result = make_constant(SGL_TYPE_INT32, std::abs(value), 0.0);
+					return true;
+				case INT_MINIMUM:
+					result = make_constant(SGL_TYPE_INT32, std::min(args[0].IntValue, args[1].IntValue), 0.0);
+					return true;
+				case INT_MAXIMUM:
+					result = make_constant(SGL_TYPE_INT32, std::max(args[0].IntValue, args[1].IntValue), 0.0);
+					return true;
+				default:
+					result = make_constant(SGL_TYPE_INT32, std::min(std::max(args[0].IntValue, args[1].IntValue), args[2].IntValue), 0.0);
+					return true;
+			}
+		}
+
+		// evaluated in float, the same way the VM does it
+		float value = static_cast<float>(args[0].FloatValue);
+		float other = args.size() > 1 ? static_cast<float>(args[1].FloatValue) : 0.0f;
+		switch (instruction)
+		{
+			case FLOAT_SQRT: value = std::sqrt(value); break;
+			case FLOAT_ABS: value = std::fabs(value); break;
+			case FLOAT_FLOOR: value = std::floor(value); break;
+			case FLOAT_SIN: value = std::sin(value); break;
+			case FLOAT_COS: value = std::cos(value); break;
+			case FLOAT_MINIMUM: value = std::min(value, other); break;
+			case FLOAT_MAXIMUM: value = std::max(value, other); break;
+			case FLOAT_CLAMP: value = std::min(std::max(value, other), static_cast<float>(args[2].FloatValue)); break;
+			default: return false;
+		}
+
+		result = make_constant(SGL_TYPE_FLOAT, 0, value);
+		return true;
+	}
+
+	/**
+	 * Compiles a call to a math intrinsic, folding it when every argument is a constant
+	 */
+	ExpressionResult compile_math_intrinsic(FunctionCompileState& state, const MathIntrinsic& intrinsic, const std::vector<std::string>& args)
+	{
+		ExpressionResult result;
+
+		// where each argument's code begins, plus where the last one ends
+		std::vector<std::size_t> bounds = { state.Code.size() };
+		std::vector<ExpressionResult> argResults;
+		bool isInt = intrinsic.IntInstruction != INVALID_INSTRUCTION;
+		bool isConstant = true;
+		for (const auto& arg : args)
+		{
+			auto argResult = compile_expression(state, arg);
+			if (!argResult.Success)
+			{
+				return result;
+			}
+
+			if (argResult.ResultType != SGL_TYPE_INT32 && argResult.ResultType != SGL_TYPE_FLOAT)
+			{
+				std::cerr << intrinsic.Name << " takes int32 or float arguments, got " << get_type(argResult.ResultType).TypeName << std::endl;
+				return result;
+			}
+
+			isInt = isInt && argResult.ResultType == SGL_TYPE_INT32;
+			isConstant = isConstant && argResult.IsConstant;
+
+			argResults.push_back(argResult);
+			bounds.push_back(state.Code.size());
+		}
+
+		SGLTypeId type = isInt ? SGL_TYPE_INT32 : SGL_TYPE_FLOAT;
+		SGLInstruction instruction = isInt ? intrinsic.IntInstruction : intrinsic.FloatInstruction;
+
+		if (isConstant)
+		{
+			std::vector<ExpressionResult> values;
+			for (const auto& arg : argResults)
+			{
+				values.push_back(convert_constant(arg, type));
+			}
+
+			ExpressionResult folded;
+			if (fold_intrinsic(instruction, values, folded))
+			{
+				state.Code.resize(bounds.front());
+				emit_constant(state, folded);
+				return folded;
+			}
+		}
+
+		// int arguments to a float intrinsic are converted
+		if (!convert_arguments(state, argResults, bounds, std::vector<SGLTypeId>(argResults.size(), type)))
+		{
+			return result;
+		}
+
+		emit_instruction(state, instruction);
+
+		result.Success = true;
+		result.ResultType = type;
+		return result;
+	}
+
+	/**
+	 * Compiles a vector constructor, either one value per lane or a single value for every lane
+	 */
+	ExpressionResult compile_vector_constructor(FunctionCompileState& state, SGLTypeId type, const std::vector<std::string>& args)
+	{
+		ExpressionResult result;
+
+		std::uint8_t lanes = get_vector_lanes(type);
+		if (args.size() != lanes && args.size() != 1)
+		{
+			std::cerr << get_type(type).TypeName << " takes 1 or " << static_cast<int>(lanes) << " values, got " << args.size() << std::endl;
+			return result;
+		}
+
+		for (const auto& arg : args)
+		{
+			auto argResult = compile_expression(state, arg);
+			if (!argResult.Success || !emit_cast(state, argResult.ResultType, SGL_TYPE_FLOAT))
+			{
+				return result;
+			}
+		}
+
+		emit_instruction(state, args.size() == 1 ? VEC_SPLAT : VEC_MAKE, lanes);
+
+		result.Success = true;
+		result.ResultType = type;
+		return result;
+	}
+
+	/**
+	 * Compiles "name(args)", which for now is a built-in function, a math intrinsic, a vector constructor
+	 * or a registered native function
+	 */
+	ExpressionResult compile_call(FunctionCompileState& state, const std::string& name, const std::string& argList)
+	{
+		ExpressionResult result;
+
+		auto args = split_arguments(argList);
+
+		SGLTypeId type = get_type(name).TypeId;
+		if (get_vector_lanes(type) != 0)
+		{
+			return compile_vector_constructor(state, type, args);
+		}
+
+		for (const auto& builtin : g_builtins)
+		{
+			if (name != builtin.Name)
+			{
+				continue;
+			}
+
+			if (builtin.ArgCount != BuiltinFunction::VARIADIC && args.size() != builtin.ArgCount)
+			{
+				std::cerr << name << " takes " << builtin.ArgCount << " arguments, got " << args.size() << std::endl;
+				return result;
+			}
+
+			return builtin.Compile(state, args);
+		}
+
+		for (const auto& intrinsic : g_math_intrinsics)
+		{
+			if (name != intrinsic.Name)
+			{
+				continue;
+			}
+
+			if (args.size() != intrinsic.ArgCount)
+			{
+				std::cerr << name << " takes " << intrinsic.ArgCount << " arguments, got " << args.size() << std::endl;
+				return result;
+			}
+
+			return compile_math_intrinsic(state, intrinsic, args);
+		}
+
+		// natives are bound to their index here, so the call costs nothing to look up at runtime
+		std::uint32_t native = get_native_registry().find_function_index(name);
+		if (native != SGL_INVALID_NATIVE)
+		{
+			return compile_native_call(state, native, args);
+		}
+
+		std::cerr << "Unknown function " << name << std::endl;
+		return result;
+	}
+
+	/**
+	 * Converts the operands of a binary operator, the left one from 'leftStart' to 'leftEnd' and the
+	 * right one after it up to the end of the code, to the type get_promoted_type picked for them
+	 * Returns false if either can't be converted
+	 */
+	bool promote_operands(FunctionCompileState& state, std::size_t leftStart, std::size_t leftEnd, ExpressionResult& left,
+		ExpressionResult& right, SGLTypeId type)
+	{
+		// only the operand that isn't already the promoted type gets converted
+		// the left operand is already under the right one, so its conversion goes in right after it
+		std::vector<std::uint8_t> leftCode;
+		std::vector<std::uint8_t> rightCode;
+		if (!get_promotion_code(left.ResultType, type, leftCode) || !get_promotion_code(right.ResultType, type, rightCode))
+		{
+			return false;
+		}
+
+		// scalar constants are converted at compile time
+		bool isScalar = get_vector_lanes(type) == 0 && type != SGL_TYPE_STRING;
+		if (isScalar && right.IsConstant && !rightCode.empty())
+		{
+			refold_constant(state, leftEnd, state.Code.size(), right, type);
+		}
+		else
+		{
+			state.Code.insert(state.Code.end(), rightCode.begin(), rightCode.end());
+		}
+
+		if (isScalar && left.IsConstant && !leftCode.empty())
+		{
+			refold_constant(state, leftStart, leftEnd, left, type);
+		}
+		else
+		{
+			insert_code(state, leftEnd, leftCode);
+		}
+
+		return true;
+	}
+
+	/**
+	 * Compiles an expression, emitting instructions that leave its value on the stack
+	 */
+	ExpressionResult compile_expression(FunctionCompileState& state, std::string expr)
+	{
+		ExpressionResult result;
+
+		strip_leading_whitespace(expr);
+		strip_tailing_whitespace(expr);
+
+		if (expr.empty())
+		{
+			std::cerr << "Missing operand in expression" << std::endl;
+			return result;
+		}
+
+		// strip parentheses that wrap the entire expression
+		while (expr.front() == '(' && find_matching_parenthesis(expr, 0) == expr.length() - 1)
+		{
+			expr = expr.substr(1, expr.length() - 2);
+			strip_leading_whitespace(expr);
+			strip_tailing_whitespace(expr);
+		}
+
+		auto opPos = find_binary_operator(expr);
+		if (opPos != std::string::npos)
+		{
+			const OperatorData* op = get_operator(expr[opPos]);
+			if (op->Operator == '=')
+			{
+				return compile_assignment(state, expr.substr(0, opPos), expr.substr(opPos + 1));
+			}
+
+			// operand boundaries are remembered for conversions and folding
+			std::size_t leftStart = state.Code.size();
+			auto leftResult = compile_expression(state, expr.substr(0, opPos));
+			if (!leftResult.Success)
+			{
+				return result;
+			}
+
+			std::size_t leftEnd = state.Code.size();
+			auto rightResult = compile_expression(state, expr.substr(opPos + 1));
+			if (!rightResult.Success)
+			{
+				return result;
+			}
+
+			if (leftResult.ResultType == SGL_TYPE_VOID || rightResult.ResultType == SGL_TYPE_VOID)
+			{
+				std::cerr << "Illegal void operand for operator " << op->Operator << std::endl;
+				return result;
+			}
+
+			SGLTypeId type = get_promoted_type(leftResult.ResultType, rightResult.ResultType);
+
+			// a number added to a string is joined as its text
+			bool isLeftString = leftResult.ResultType == SGL_TYPE_STRING;
+			bool isRightString = rightResult.ResultType == SGL_TYPE_STRING;
+			if (type == SGL_INVALID_TYPE_ID && op->Arithmetic == ARITH_ADD && (isLeftString || isRightString)
+				&& (isLeftString || is_number_type(leftResult.ResultType)) && (isRightString || is_number_type(rightResult.ResultType)))
+			{
+				type = SGL_TYPE_STRING;
+			}
+
+			if (type == SGL_INVALID_TYPE_ID)
+			{
+				std::cerr << "Operator " << op->Operator << " can't mix " << get_type(leftResult.ResultType).TypeName
+					<< " and " << get_type(rightResult.ResultType).TypeName << std::endl;
+				return result;
+			}
+
+			SGLInstruction instruction = get_arithmetic_instruction(type, op->Arithmetic);
+			if (instruction == INVALID_INSTRUCTION)
+			{
+				std::cerr << "Operator " << op->Operator << " is not supported for type " << get_type(type).TypeName << std::endl;
+				return result;
+			}
+
+			// joining two constants is done here, so "a" + "b" costs the same as "ab" and is interned as one
+			if (type == SGL_TYPE_STRING && leftResult.IsConstant && rightResult.IsConstant)
+			{
+				if (!isLeftString)
+				{
+					leftResult.StringValue = get_constant_text(leftResult);
+				}
+
+				if (!isRightString)
+				{
+					rightResult.StringValue = get_constant_text(rightResult);
+				}
+
+				state.Code.resize(leftStart);
+				if (!emit_string_const(state, leftResult.StringValue + rightResult.StringValue))
+				{
+					return result;
+				}
+
+				result.Success = true;
+				result.ResultType = type;
+				result.IsConstant = true;
+				result.StringValue = leftResult.StringValue + rightResult.StringValue;
+				return result;
+			}
+
+			// scalar constants are converted at compile time, and two constants are folded into one
+			bool isScalar = get_vector_lanes(type) == 0 && type != SGL_TYPE_STRING;
+			if (isScalar && leftResult.IsConstant && rightResult.IsConstant)
+			{
+				ExpressionResult folded;
+				if (fold_arithmetic(op->Arithmetic, convert_constant(leftResult, type), convert_constant(rightResult, type), folded))
+				{
+					state.Code.resize(leftStart);
+					emit_constant(state, folded);
+					return folded;
+				}
+			}
+
+			// a number constant joined to a string is turned into its text here instead of at runtime
+			// the right one goes first, so the left one's boundaries are still where they were
+			if (type == SGL_TYPE_STRING && rightResult.IsConstant && !isRightString
+				&& !restring_constant(state, leftEnd, state.Code.size(), rightResult))
+			{
+				return result;
+			}
+
+			if (type == SGL_TYPE_STRING && leftResult.IsConstant && !isLeftString
+				&& !restring_constant(state, leftStart, leftEnd, leftResult))
+			{
+				return result;
+			}
+
+			if (!promote_operands(state, leftStart, leftEnd, leftResult, rightResult, type))
+			{
+				std::cerr << "Operator " << op->Operator << " can't convert its operands to " << get_type(type).TypeName << std::endl;
+				return result;
+			}
+
+			emit_instruction(state, instruction);
+
+			result.Success = true;
+			result.ResultType = type;
+			return result;
+		}
+
+		// no operator, so this is a string, a call, a member, a declaration, a variable, or a constant
+		// strings go first since anything can be inside the quotes
+		if (is_string_literal(expr))
+		{
+			if (!parse_string_literal(expr, result.StringValue) || !emit_string_const(state, result.StringValue))
+			{
+				return result;
+			}
+
+			result.Success = true;
+			result.ResultType = SGL_TYPE_STRING;
+			result.IsConstant = true;
+			return result;
+		}
+
+		auto callStart = expr.find('(');
+		if (callStart != std::string::npos && callStart > 0 && expr.back() == ')'
+			&& find_matching_parenthesis(expr, callStart) == expr.length() - 1)
+		{
+			std::string name = expr.substr(0, callStart);
+			strip_tailing_whitespace(name);
+			if (is_alphanumeric(name))
+			{
+				return compile_call(state, name, expr.substr(callStart + 1, expr.length() - callStart - 2));
+			}
+		}
+
+		// a member after the last dot, as long as it's a name and not the fraction of a float literal
+		auto dot = expr.rfind('.');
+		if (dot != std::string::npos && dot > 0 && dot + 1 < expr.length() && !std::isdigit(expr[dot + 1])
+			&& is_alphanumeric(expr.substr(dot + 1)) && !is_str_float(expr))
+		{
+			return compile_member_access(state, expr.substr(0, dot), expr.substr(dot + 1));
+		}
+
+		if (std::any_of(expr.begin(), expr.end(), g_is_whitespace))
+		{
+			// declaration without a value, variables start out zeroed
+			SGLTypeId type;
+			std::string name;
+			if (!parse_declaration(expr, type, name))
+			{
+				return result;
+			}
+
+			if (!emit_zero(state, type))
+			{
+				return result;
+			}
+
+			auto local = declare_local(state, name, type);
+			if (local == std::string::npos || !emit_store(state, local, type))
+			{
+				return result;
+			}
+
+			result.Success = true;
+			result.ResultType = SGL_TYPE_VOID;
+			return result;
+		}
+
+		auto local = find_local(state, expr);
+		if (local != std::string::npos)
+		{
+			SGLTypeId type = state.Locals[local].Type;
+			SGLInstruction load = get_load_instruction(type);
+			if (load == INVALID_INSTRUCTION)
+			{
+				std::cerr << "Variables of type " << get_type(type).TypeName << " are not supported yet" << std::endl;
+				return result;
+			}
+
+			emit_variable_access(state, load, local);
+
+			result.Success = true;
+			result.ResultType = type;
+			return result;
+		}
+
+		if (const GlobalData* global = find_global(state, expr))
+		{
+			emit_global_access(state, get_global_load_instruction(global->GlobalType), *global);
+
+			result.Success = true;
+			result.ResultType = global->GlobalType;
+			return result;
+		}
+
+		if (is_str_int(expr))
+		{
+			// literals that don't fit in 32 bits are int64, like they would be in C
+			long long value = std::stoll(expr, nullptr, 0);
+			bool isWide = value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max();
+
+			result = make_constant(isWide ? SGL_TYPE_INT64 : SGL_TYPE_INT32, value, 0.0);
+			emit_constant(state, result);
+			return result;
+		}
+
+		if (is_str_float(expr))
+		{
+			// without the F suffix the literal is a double, stod stops at the suffix on its own
+			bool isFloat = expr.back() == 'f' || expr.back() == 'F';
+
+			result = make_constant(isFloat ? SGL_TYPE_FLOAT : SGL_TYPE_DOUBLE, 0, std::stod(expr));
+			emit_constant(state, result);
+			return result;
+		}
+
+		std::cerr << "Unrecognized expression " << expr << std::endl;
+		return result;
+	}
+
+	/**
+	 * Compiles a statement that ends with a semicolon
+	 */
+	bool compile_statement(FunctionCompileState& state, std::string statement)
+	{
+		if (!statement.empty() && statement.back() == ';')
+		{
+			statement.pop_back();
+		}
+
+		auto result = compile_expression(state, statement);
+		if (!result.Success)
+		{
+			return false;
+		}
+
+		// nothing pops a stray value, so a statement has to store whatever it computes
+		if (result.ResultType != SGL_TYPE_VOID)
+		{
+			std::cerr << "Result of statement '" << statement << "' is unused" << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Finds the comparison operator outside of parentheses and quotes, and the comparison it makes
+	 * Returns std::string::npos if there is none, otherwise 'length' is set to the operator's length
+	 */
+	std::size_t find_comparison(const std::string& expr, SGLComparison& comparison, std::size_t& length)
+	{
+		int depth = 0;
+		bool inQuotes = false;
+
+		for (std::size_t i = 0; i < expr.length(); ++i)
+		{
+			char c = expr[i];
+			if (is_quote_at(expr, i))
+			{
+				inQuotes = !inQuotes;
+			}
+			else if (inQuotes)
+			{
+				continue;
+			}
+			else if (c == '(')
+			{
+				++depth;
+			}
+			else if (c == ')')
+			{
+				--depth;
+			}
+			else if (depth == 0)
+			{
+				bool isOrEqual = i + 1 < expr.length() && expr[i + 1] == '=';
+				length = isOrEqual ? 2 : 1;
+				switch (c)
+				{
+					case '=':
+						if (isOrEqual)
+						{
+							comparison = CMP_EQ;
+							return i;
+						}
+						break;
+					case '!':
+						if (isOrEqual)
+						{
+							comparison = CMP_NE;
+							return i;
+						}
+						break;
+					case '<':
+						comparison = isOrEqual ? CMP_LE : CMP_LT;
+						return i;
+					case '>':
+						comparison = isOrEqual ? CMP_GE : CMP_GT;
+						return i;
+					default:
+						break;
+				}
+			}
+		}
+
+		return std::string::npos;
+	}
+
+	/**
+	 * Finds the last && or || outside of parentheses and quotes
+	 * Returns std::string::npos if there is none
+	 */
+	std::size_t find_logical_operator(const std::string& expr, char op)
+	{
+		std::size_t found = std::string::npos;
+		int depth = 0;
+		bool inQuotes = false;
+
+		for (std::size_t i = 0; i + 1 < expr.length(); ++i)
+		{
+			if (is_quote_at(expr, i))
+			{
+				inQuotes = !inQuotes;
+			}
+			else if (inQuotes)
+			{
+				continue;
+			}
+			else if (expr[i] == '(')
+			{
+				++depth;
+			}
+			else if (expr[i] == ')')
+			{
+				--depth;
+			}
+			else if (depth == 0 && expr[i] == op && expr[i + 1] == op)
+			{
+				found = i++;
+			}
+		}
+
+		return found;
+	}
+
+	/**
+	 * Works out a comparison of two constants of the same type
+	 */
+	template <class T>
+	bool fold_comparison(SGLComparison comparison, const T& left, const T& right)
+	{
+		switch (comparison)
+		{
+			case CMP_EQ: return left == right;
+			case CMP_NE: return left != right;
+			case CMP_LT: return left < right;
+			case CMP_LE: return left <= right;
+			case CMP_GT: return left > right;
+			default: return left >= right;
+		}
+	}
+
+	/**
+	 * Strips whitespace and any parentheses that wrap the entire condition
+	 */
+	void strip_wrapping_parentheses(std::string& condition)
+	{
+		strip_leading_whitespace(condition);
+		strip_tailing_whitespace(condition);
+
+		while (!condition.empty() && condition.front() == '(' && find_matching_parenthesis(condition, 0) == condition.length() - 1)
+		{
+			condition = condition.substr(1, condition.length() - 2);
+			strip_leading_whitespace(condition);
+			strip_tailing_whitespace(condition);
+		}
+	}
+
+	/**
+	 * Compiles a condition into code that jumps to 'label' if the condition comes out as 'jumpIf', and falls through if not
+	 * A condition is a comparison, conditions joined with && or || (which only evaluate their right side when they
+	 * have to), a condition after !, or an int32 that's true when it isn't 0
+	 * Int32 comparisons are a single fused compare-and-branch, other types are reduced to an int32 compared against 0
+	 */
+	bool compile_condition(FunctionCompileState& state, std::string condition, bool jumpIf, std::size_t label)
+	{
+		strip_wrapping_parentheses(condition);
+		if (condition.empty())
+		{
+			std::cerr << "Missing condition" << std::endl;
+			return false;
+		}
+
+		// || binds looser than &&, so it's split on first
+		for (char op : { '|', '&' })
+		{
+			auto opPos = find_logical_operator(condition, op);
+			if (opPos == std::string::npos)
+			{
+				continue;
+			}
+
+			std::string left = condition.substr(0, opPos);
+			std::string right = condition.substr(opPos + 2);
+
+			// || can jump as soon as either side is true and && as soon as either side is false
+			if (jumpIf == (op == '|'))
+			{
+				return compile_condition(state, left, jumpIf, label) && compile_condition(state, right, jumpIf, label);
+			}
+
+			// otherwise the left side decides by skipping the right one
+			std::size_t skip = make_label(state);
+			if (!compile_condition(state, left, !jumpIf, skip) || !compile_condition(state, right, jumpIf, label))
+			{
+				return false;
+			}
+
+			place_label(state, skip);
+			return true;
+		}
+
+		if (condition.front() == '!')
+		{
+			return compile_condition(state, condition.substr(1), !jumpIf, label);
+		}
+
+		SGLComparison comparison = CMP_NE;
+		std::size_t opLength = 0;
+		auto opPos = find_comparison(condition, comparison, opLength);
+
+		std::size_t leftStart = state.Code.size();
+		auto left = compile_expression(state, condition.substr(0, opPos));
+		if (!left.Success)
+		{
+			return false;
+		}
+
+		std::size_t leftEnd = state.Code.size();
+		ExpressionResult right;
+		if (opPos == std::string::npos)
+		{
+			// a value on its own is true when it isn't 0
+			if (left.ResultType != SGL_TYPE_INT32)
+			{
+				std::cerr << "Condition '" << condition << "' must be a comparison or an int32" << std::endl;
+				return false;
+			}
+
+			right = make_constant(SGL_TYPE_INT32, 0, 0.0);
+			emit_constant(state, right);
+		}
+		else
+		{
+			right = compile_expression(state, condition.substr(opPos + opLength));
+			if (!right.Success)
+			{
+				return false;
+			}
+		}
+
+		SGLTypeId type = get_promoted_type(left.ResultType, right.ResultType);
+		SGLInstruction compare = get_compare_instruction(type, comparison);
+		if (compare == INVALID_INSTRUCTION)
+		{
+			std::cerr << "Condition '" << condition << "' can't compare " << get_type(left.ResultType).TypeName << " and "
+				<< get_type(right.ResultType).TypeName << std::endl;
+			return false;
+		}
+
+		// a condition on two constants is settled here, it's either a plain jump or nothing
+		if (left.IsConstant && right.IsConstant)
+		{
+			bool isTrue;
+			if (type == SGL_TYPE_STRING)
+			{
+				isTrue = fold_comparison(comparison, left.StringValue, right.StringValue);
+			}
+			else if (is_floating_type(type))
+			{
+				isTrue = fold_comparison(comparison, convert_constant(left, type).FloatValue, convert_constant(right, type).FloatValue);
+			}
+			else
+			{
+				isTrue = fold_comparison(comparison, convert_constant(left, type).IntValue, convert_constant(right, type).IntValue);
+			}
+
+			state.Code.resize(leftStart);
+			if (isTrue == jumpIf)
+			{
+				emit_jump(state, JMP, label);
+			}
+			return true;
+		}
+
+		if (!promote_operands(state, leftStart, leftEnd, left, right, type))
+		{
+			std::cerr << "Condition '" << condition << "' can't convert its operands to " << get_type(type).TypeName << std::endl;
+			return false;
+		}
+
+		// anything but int32 becomes -1, 0 or 1 first, which is compared against 0 the same way
+		if (type != SGL_TYPE_INT32)
+		{
+			emit_instruction(state, compare);
+			emit_instruction(state, INT_CONST_0);
+		}
+
+		emit_jump(state, JUMP_TABLE[jumpIf ? comparison : INVERSE_TABLE[comparison]], label);
+		return true;
+	}
+
+	/**
+	 * Returns true if the source has the keyword at 'pos', rather than a longer name that begins with it
+	 */
+	bool starts_with_keyword(const std::string& source, const std::string& keyword, std::size_t pos = 0)
+	{
+		return source.compare(pos, keyword.length(), keyword) == 0
+			&& (source.length() == pos + keyword.length() || !std::isalnum(source[pos + keyword.length()]));
+	}
+
+	/**
+	 * Returns the position of the first character at or after 'pos' that isn't whitespace or a newline
+	 */
+	std::size_t skip_whitespace(const std::string& source, std::size_t pos)
+	{
+		while (pos < source.length() && g_is_newline_or_whitespace(source[pos]))
+		{
+			++pos;
+		}
+
+		return pos;
+	}
+
+	/**
+	 * Returns the position after the else keyword at 'pos' and the whitespace after it
+	 * The keyword has to be followed by whitespace, a '{' or an if, so "elsewhere" isn't taken for it
+	 * Returns std::string::npos if there's no else at 'pos'
+	 */
+	std::size_t skip_else(const std::string& source, std::size_t pos)
+	{
+		if (source.compare(pos, 4, "else") != 0)
+		{
+			return std::string::npos;
+		}
+
+		std::size_t after = pos + 4;
+		if (after < source.length() && !g_is_newline_or_whitespace(source[after]) && source[after] != '{'
+			&& source.compare(after, 2, "if") != 0)
+		{
+			return std::string::npos;
+		}
+
+		return skip_whitespace(source, after);
+	}
+
+	/**
+	 * Where the parts of control flow such as "while (clause) body" are in the source it was found in
+	 * An if/else-if chain has one for each if, then one for its final else, which has no clause
+	 */
+	struct ClauseBounds
+	{
+		// First character of the keyword, or of the body for a final else
+		std::size_t Start = 0;
+		// Inside of the parentheses, from its first character to the closing parenthesis
+		std::size_t ClauseStart = std::string::npos;
+		std::size_t ClauseEnd = std::string::npos;
+		// Body, a statement or a block, from its first character to one past its last
+		std::size_t BodyStart = 0;
+		std::size_t BodyEnd = 0;
+
+		bool has_clause() const
+		{
+			return ClauseStart != std::string::npos;
+		}
+	};
+
+	/**
+	 * Finds the clause and the start of the body of the control flow with the given keyword at 'start'
+	 * Returns false if the clause is missing
+	 */
+	bool find_clause(const std::string& source, std::size_t start, const std::string& keyword, ClauseBounds& bounds)
+	{
+		auto clauseStart = skip_whitespace(source, start + keyword.length());
+		auto clauseEnd = clauseStart < source.length() && source[clauseStart] == '('
+			? find_matching_parenthesis(source, clauseStart) : std::string::npos;
+		if (clauseEnd == std::string::npos)
+		{
+			std::cerr << "Missing clause in parentheses after '" << keyword << "'" << std::endl;
+			return false;
+		}
+
+		bounds.Start = start;
+		bounds.ClauseStart = clauseStart + 1;
+		bounds.ClauseEnd = clauseEnd;
+		bounds.BodyStart = skip_whitespace(source, clauseEnd + 1);
+		return true;
+	}
+
+	/**
+	 * Splits control flow such as "while (clause) body" after its keyword into the clause and the body
+	 * Returns false if the clause is missing
+	 */
+	bool split_clause(const std::string& statement, const std::string& keyword, std::string& clause, std::string& body)
+	{
+		ClauseBounds bounds;
+		if (!find_clause(statement, 0, keyword, bounds))
+		{
+			return false;
+		}
+
+		clause = statement.substr(bounds.ClauseStart, bounds.ClauseEnd - bounds.ClauseStart);
+		body = statement.substr(bounds.BodyStart);
+		return true;
+	}
+
+	/**
+	 * Returns the position one past the end of the statement at 'start', which can be a block in
+	 * brackets or control flow along with its body
+	 * An if takes its else along with it, and a chain of else-ifs is walked rather than recursed into,
+	 * with the bounds of each link added to 'chain' if it's given
+	 * Returns std::string::npos if the statement doesn't end
+	 */
+	std::size_t find_statement_end(const std::string& source, std::size_t start, std::vector<ClauseBounds>* chain = nullptr)
+	{
+		while (true)
+		{
+			if (start < source.length() && source[start] == '{')
+			{
+				auto close = find_matching_bracket(source, start);
+				return close == std::string::npos ? close : close + 1;
+			}
+
+			const char* keyword = nullptr;
+			for (const char* controlFlow : { "if", "while", "for" })
+			{
+				if (starts_with_keyword(source, controlFlow, start))
+				{
+					keyword = controlFlow;
+					break;
+				}
+			}
+
+			if (!keyword)
+			{
+				auto semicolon = find_unquoted(source, ";", start);
+				return semicolon == std::string::npos ? semicolon : semicolon + 1;
+			}
+
+			ClauseBounds bounds;
+			if (!find_clause(source, start, keyword, bounds))
+			{
+				return std::string::npos;
+			}
+
+			// the body is a statement of its own, an else right after it belongs to any if inside it
+			bounds.BodyEnd = find_statement_end(source, bounds.BodyStart);
+			if (bounds.BodyEnd == std::string::npos || keyword[0] != 'i')
+			{
+				return bounds.BodyEnd;
+			}
+
+			if (chain)
+			{
+				chain->push_back(bounds);
+			}
+
+			auto elseBodyStart = skip_else(source, skip_whitespace(source, bounds.BodyEnd));
+			if (elseBodyStart == std::string::npos)
+			{
+				return bounds.BodyEnd;
+			}
+
+			// an else-if carries on the chain, any other else body ends it
+			if (chain && !starts_with_keyword(source, "if", elseBodyStart))
+			{
+				ClauseBounds elseBounds;
+				elseBounds.Start = elseBodyStart;
+				elseBounds.BodyStart = elseBodyStart;
+				elseBounds.BodyEnd = find_statement_end(source, elseBodyStart);
+				chain->push_back(elseBounds);
+				return elseBounds.BodyEnd;
+			}
+
+			start = elseBodyStart;
+		}
+	}
+
+	bool compile_statements(FunctionCompileState& state, const std::string& source);
+
+	/**
+	 * Compiles the body of an if, else, while or for, which is a scope of its own
+	 */
+	bool compile_body(FunctionCompileState& state, const std::string& body)
+	{
+		if (body.empty())
+		{
+			std::cerr << "Missing body of control flow" << std::endl;
+			return false;
+		}
+
+		state.Symbols.push_scope();
+		bool isCompiled = compile_statements(state, body);
+		state.Symbols.pop_scope();
+		return isCompiled;
+	}
+
+	/**
+	 * An if/else-if chain whose conditions each compare the same int32 variable to a different constant
+	 */
+	struct SwitchChain
+	{
+		// Variable every condition compares
+		std::string Subject;
+		// Constant each condition compares against and the body that runs when it's equal, in source order
+		std::vector<std::pair<std::int32_t, std::string>> Cases;
+		// Body of the else that ends the chain, empty if there's no else
+		std::string Default;
+	};
+
+	/**
+	 * Matches a condition such as "state == 3" or "3 == state" against an int32 variable
+	 * Returns false for any other condition
+	 */
+	bool parse_case_condition(FunctionCompileState& state, std::string condition, std::string& subject, std::int32_t& value)
+	{
+		strip_wrapping_parentheses(condition);
+		if (find_logical_operator(condition, '|') != std::string::npos || find_logical_operator(condition, '&') != std::string::npos)
+		{
+			return false;
+		}
+
+		SGLComparison comparison = CMP_NE;
+		std::size_t opLength = 0;
+		auto opPos = find_comparison(condition, comparison, opLength);
+		if (opPos == std::string::npos || comparison != CMP_EQ)
+		{
+			return false;
+		}
+
+		std::string left = condition.substr(0, opPos);
+		std::string right = condition.substr(opPos + opLength);
+		strip_leading_whitespace(left);
+		strip_tailing_whitespace(left);
+		strip_leading_whitespace(right);
+		strip_tailing_whitespace(right);
+
+		if (is_str_int(left))
+		{
+			std::swap(left, right);
+		}
+
+		if (!is_str_int(right))
+		{
+			return false;
+		}
+
+		long long constant = std::stoll(right, nullptr, 0);
+		if (constant < std::numeric_limits<std::int32_t>::min() || constant > std::numeric_limits<std::int32_t>::max())
+		{
+			return false;
+		}
+
+		// only a variable, which reads the same every time, can be tested once for the whole chain
+		auto local = find_local(state, left);
+		const GlobalData* global = local == std::string::npos ? find_global(state, left) : nullptr;
+		if (local != std::string::npos ? state.Locals[local].Type != SGL_TYPE_INT32 : !global || global->GlobalType != SGL_TYPE_INT32)
+		{
+			return false;
+		}
+
+		subject = left;
+		value = static_cast<std::int32_t>(constant);
+		return true;
+	}
+
+	/**
+	 * Collects the cases of the if/else-if chain whose bounds in 'source' are in 'links', see find_statement_end
+	 * The chain ends at the first condition that compares something else or repeats a constant,
+	 * which along with the rest of the chain becomes the default
+	 * Returns false if there aren't at least SGL_SWITCH_MIN_CASES cases
+	 */
+	bool find_switch_chain(FunctionCompileState& state, const std::string& source, const std::vector<ClauseBounds>& links, SwitchChain& chain)
+	{
+		std::set<std::int32_t> values;
+		std::size_t link = 0;
+		for (; link < links.size() && links[link].has_clause() && chain.Cases.size() < SGL_SWITCH_MAX_CASES; ++link)
+		{
+			const ClauseBounds& bounds = links[link];
+			std::string subject;
+			std::int32_t value = 0;
+			if (!parse_case_condition(state, source.substr(bounds.ClauseStart, bounds.ClauseEnd - bounds.ClauseStart), subject, value)
+				|| (!chain.Cases.empty() && subject != chain.Subject) || !values.insert(value).second)
+			{
+				break;
+			}
+
+			chain.Subject = subject;
+			chain.Cases.push_back({ value, source.substr(bounds.BodyStart, bounds.BodyEnd - bounds.BodyStart) });
+		}
+
+		if (link < links.size())
+		{
+			chain.Default = source.substr(links[link].Start, links.back().BodyEnd - links[link].Start);
+		}
+		return chain.Cases.size() >= SGL_SWITCH_MIN_CASES;
+	}
+
+	/**
+	 * Compiles an if/else-if chain as a switch on its variable, so picking the body is one jump
+	 * instead of a compare for every condition before it
+	 * A TABLE_SWITCH is used when at least half of the values between the lowest and highest
+	 * constants are cases and the table's 16-bit count can span them, the holes jump to the default.
+	 * Otherwise a LOOKUP_SWITCH binary searches the constants.
+	 */
+	bool compile_switch(FunctionCompileState& state, const SwitchChain& chain)
+	{
+		compile_expression(state, chain.Subject);
+
+		std::vector<std::size_t> order(chain.Cases.size());
+		for (std::size_t i = 0; i < order.size(); ++i)
+		{
+			order[i] = i;
+		}
+
+		std::sort(order.begin(), order.end(), [&chain](std::size_t a, std::size_t b)
+		{
+			return chain.Cases[a].first < chain.Cases[b].first;
+		});
+
+		std::int64_t low = chain.Cases[order.front()].first;
+		std::int64_t range = chain.Cases[order.back()].first - low + 1;
+		// the table's entry count is 16 bits, so a wider range is looked up however dense it is
+		bool isTable = range <= static_cast<std::int64_t>(2 * chain.Cases.size()) && range <= std::numeric_limits<std::uint16_t>::max();
+
+		std::vector<std::size_t> bodyLabels(chain.Cases.size());
+		for (auto& label : bodyLabels)
+		{
+			label = make_label(state);
+		}
+
+		SwitchData switchData;
+		switchData.Offset = state.Code.size();
+		switchData.DefaultLabel = make_label(state);
+
+		auto emit_operand = [&state](auto value)
+		{
+			auto pos = state.Code.size();
+			state.Code.resize(pos + sizeof(value));
+			store_to_buffer<decltype(value)>(&state.Code[pos], sizeof(value), value);
+		};
+
+		// displacements are left as 0 for encode_switches
+		if (isTable)
+		{
+			emit_instruction(state, TABLE_SWITCH);
+			emit_operand(static_cast<std::uint16_t>(range));
+			emit_operand(std::int32_t(0));
+			emit_operand(static_cast<std::int32_t>(low));
+
+			auto next = order.begin();
+			for (std::int64_t value = low; value < low + range; ++value)
+			{
+				bool isCase = chain.Cases[*next].first == value;
+				switchData.CaseLabels.push_back(isCase ? bodyLabels[*next++] : switchData.DefaultLabel);
+				emit_operand(std::int32_t(0));
+			}
+		}
+		else
+		{
+			emit_instruction(state, LOOKUP_SWITCH);
+			emit_operand(static_cast<std::uint16_t>(order.size()));
+			emit_operand(std::int32_t(0));
+
+			for (auto index : order)
+			{
+				switchData.CaseLabels.push_back(bodyLabels[index]);
+				emit_operand(chain.Cases[index].first);
+				emit_operand(std::int32_t(0));
+			}
+		}
+		state.Switches.push_back(switchData);
+
+		// bodies stay in source order, each one jumps past the rest like the if chain would
+		std::size_t endLabel = make_label(state);
+		for (std::size_t i = 0; i < chain.Cases.size(); ++i)
+		{
+			place_label(state, bodyLabels[i]);
+			if (!compile_body(state, chain.Cases[i].second))
+			{
+				return false;
+			}
+			emit_jump(state, JMP, endLabel);
+		}
+
+		place_label(state, switchData.DefaultLabel);
+		if (!chain.Default.empty() && !compile_body(state, chain.Default))
+		{
+			return false;
+		}
+
+		place_label(state, endLabel);
+		return true;
+	}
+
+	/**
+	 * Compiles an if along with its else-ifs and else, whose bounds in 'source' are in 'chain', see find_statement_end
+	 * Each condition jumps to the next link when it's false, and each body but the last jumps past the rest
+	 * A long enough chain of else-ifs that compare one int32 variable to constants is a switch instead
+	 */
+	bool compile_if(FunctionCompileState& state, const std::string& source, const std::vector<ClauseBounds>& chain)
+	{
+		SwitchChain switchChain;
+		if (find_switch_chain(state, source, chain, switchChain))
+		{
+			return compile_switch(state, switchChain);
+		}
+
+		std::size_t endLabel = make_label(state);
+		for (const ClauseBounds& link : chain)
+		{
+			std::string body = source.substr(link.BodyStart, link.BodyEnd - link.BodyStart);
+			if (!link.has_clause())
+			{
+				if (!compile_body(state, body))
+				{
+					return false;
+				}
+				break;
+			}
+
+			std::string clause = source.substr(link.ClauseStart, link.ClauseEnd - link.ClauseStart);
+			std::size_t nextLabel = make_label(state);
+			if (!compile_condition(state, clause, false, nextLabel) || !compile_body(state, body))
+			{
+				return false;
+			}
+
+			if (&link != &chain.back())
+			{
+				emit_jump(state, JMP, endLabel);
+			}
+			place_label(state, nextLabel);
+		}
+
+		place_label(state, endLabel);
+		return true;
+	}
+
+	/**
+	 * Compiles the loop shared by while and for, with the condition at the bottom, so each time around
+	 * costs one compare-and-branch. An empty condition loops forever.
+	 */
+	bool compile_loop(FunctionCompileState& state, const std::string& condition, const std::string& body, const std::string& step)
+	{
+		LoopData loop;
+		loop.Start = state.Code.size();
+
+		std::size_t bodyLabel = make_label(state);
+		std::size_t conditionLabel = make_label(state);
+		emit_jump(state, JMP, conditionLabel);
+
+		place_label(state, bodyLabel);
+		if (!compile_body(state, body) || (!step.empty() && !compile_statement(state, step)))
+		{
+			return false;
+		}
+
+		place_label(state, conditionLabel);
+		if (std::all_of(condition.begin(), condition.end(), g_is_newline_or_whitespace))
+		{
+			emit_jump(state, JMP, bodyLabel);
+		}
+		else if (!compile_condition(state, condition, true, bodyLabel))
+		{
+			return false;
+		}
+
+		loop.End = state.Code.size();
+		state.Loops.push_back(loop);
+		return true;
+	}
+
+	/**
+	 * Compiles "while (condition) body"
+	 */
+	bool compile_while(FunctionCompileState& state, const std::string& statement)
+	{
+		std::string clause;
+		std::string body;
+		return split_clause(statement, "while", clause, body) && compile_loop(state, clause, body, "");
+	}
+
+	/**
+	 * Compiles "for (init; condition; step) body", the init's variables are only visible to the loop
+	 */
+	bool compile_for(FunctionCompileState& state, const std::string& statement)
+	{
+		std::string clause;
+		std::string body;
+		if (!split_clause(statement, "for", clause, body))
+		{
+			return false;
+		}
+
+		auto initEnd = find_unquoted(clause, ";");
+		auto conditionEnd = initEnd == std::string::npos ? initEnd : find_unquoted(clause, ";", initEnd + 1);
+		if (conditionEnd == std::string::npos)
+		{
+			std::cerr << "A for loop needs an init, a condition and a step separated by ;" << std::endl;
+			return false;
+		}
+
+		std::string init = clause.substr(0, initEnd);
+		std::string condition = clause.substr(initEnd + 1, conditionEnd - initEnd - 1);
+		std::string step = clause.substr(conditionEnd + 1);
+		strip_leading_if(step, g_is_newline_or_whitespace);
+
+		state.Symbols.push_scope();
+		bool isCompiled = (std::all_of(init.begin(), init.end(), g_is_newline_or_whitespace) || compile_statement(state, init))
+			&& compile_loop(state, condition, body, step);
+		state.Symbols.pop_scope();
+		return isCompiled;
+	}
+
+	/**
+	 * Compiles "return;" or "return value;", the value is converted to the function's return type
+	 */
+	bool compile_return(FunctionCompileState& state, std::string statement)
+	{
+		statement.erase(0, 6);
+		if (!statement.empty() && statement.back() == ';')
+		{
+			statement.pop_back();
+		}
+		strip_leading_if(statement, g_is_newline_or_whitespace);
+		strip_tailing_if(statement, g_is_newline_or_whitespace);
+
+		if (statement.empty() != (state.ReturnType == SGL_TYPE_VOID))
+		{
+			std::cerr << (statement.empty() ? "Missing return value, the function returns " : "Unexpected return value, the function returns ")
+				<< get_type(state.ReturnType).TypeName << std::endl;
+			return false;
+		}
+
+		if (!statement.empty())
+		{
+			std::size_t start = state.Code.size();
+			auto result = compile_expression(state, statement);
+			if (!result.Success)
+			{
+				return false;
+			}
+
+			if (result.ResultType != state.ReturnType)
+			{
+				SGLInstruction cast = get_cast_instruction(result.ResultType, state.ReturnType);
+				if (cast == INVALID_INSTRUCTION)
+				{
+					std::cerr << "Cannot convert " << get_type(result.ResultType).TypeName << " to " << get_type(state.ReturnType).TypeName
+						<< " for the return value" << std::endl;
+					return false;
+				}
+
+				if (result.IsConstant)
+				{
+					refold_constant(state, start, state.Code.size(), result, state.ReturnType);
+				}
+				else
+				{
+					emit_instruction(state, cast);
+				}
+			}
+		}
+
+		emit_instruction(state, RETURN);
+		return true;
+	}
+
+	/**
+	 * Compiles a run of statements, blocks and control flow
+	 */
+	bool compile_statements(FunctionCompileState& state, const std::string& source)
+	{
+		std::vector<ClauseBounds> chain;
+		std::size_t pos = skip_whitespace(source, 0);
+		while (pos < source.length())
+		{
+			chain.clear();
+			auto end = find_statement_end(source, pos, &chain);
+			if (end == std::string::npos)
+			{
+				std::cerr << (source[pos] == '{' ? "Missing closing bracket" : "Missing semicolon") << std::endl;
+				return false;
+			}
+
+			bool isCompiled;
+			if (source[pos] == '{')
+			{
+				state.Symbols.push_scope();
+				isCompiled = compile_statements(state, source.substr(pos + 1, end - pos - 2));
+				state.Symbols.pop_scope();
+			}
+			else if (!chain.empty())
+			{
+				isCompiled = compile_if(state, source, chain);
+			}
+			else
+			{
+				std::string statement = source.substr(pos, end - pos);
+				if (starts_with_keyword(statement, "while"))
+				{
+					isCompiled = compile_while(state, statement);
+				}
+				else if (starts_with_keyword(statement, "for"))
+				{
+					isCompiled = compile_for(state, statement);
+				}
+				else if (starts_with_keyword(statement, "return"))
+				{
+					isCompiled = compile_return(state, statement);
+				}
+				else
+				{
+					isCompiled = compile_statement(state, statement);
+				}
+			}
+
+			if (!isCompiled)
+			{
+				return false;
+			}
+
+			pos = skip_whitespace(source, end);
+		}
+
+		return true;
+	}
+
+	/**
+	 * Patches the allocated slots into the bytecode
+	 * Slots that don't fit in a byte get a WIDE prefix in front of their instruction and a
+	 * 16-bit operand, which means re-laying out the code. Most functions never need it.
+	 */
+	void encode_slot_operands(FunctionCompileState& state)
+	{
+		// gather accesses whose slot needs the wide form, in code order
+		std::vector<std::pair<std::size_t, std::size_t>> wideOperands;
+		for (const auto& var : state.Locals)
+		{
+			for (auto offset : var.OperandOffsets)
+			{
+				if (var.Slot > std::numeric_limits<std::uint8_t>::max())
+				{
+					wideOperands.push_back({ offset, var.Slot });
+				}
+				else
+				{
+					state.Code[offset] = static_cast<std::uint8_t>(var.Slot);
+				}
+			}
+		}
+
+		if (wideOperands.empty())
+		{
+			return;
+		}
+
+		std::sort(wideOperands.begin(), wideOperands.end());
+
+		std::vector<std::uint8_t> code;
+		code.reserve(state.Code.size() + wideOperands.size() * 2);
+
+		std::size_t copied = 0;
+		for (const auto& operand : wideOperands)
+		{
+			// copy everything up to the instruction, then WIDE, the instruction, and the wide slot
+			std::size_t instruction = operand.first - 1;
+			code.insert(code.end(), state.Code.begin() + copied, state.Code.begin() + instruction);
+			code.push_back(WIDE);
+			code.push_back(state.Code[instruction]);
+
+			auto pos = code.size();
+			code.resize(pos + sizeof(std::uint16_t));
+			store_to_buffer<std::uint16_t>(&code[pos], sizeof(std::uint16_t), static_cast<std::uint16_t>(operand.second));
+
+			copied = operand.first + 1;
+		}
+		code.insert(code.end(), state.Code.begin() + copied, state.Code.end());
+
+		state.Code.swap(code);
+
+		// every widened instruction before a jump or label moves it along by the 2 bytes it grew
+		auto shift = [&wideOperands](std::size_t& pos)
+		{
+			auto widened = std::lower_bound(wideOperands.begin(), wideOperands.end(), pos,
+				[](const std::pair<std::size_t, std::size_t>& operand, std::size_t pos) { return operand.first - 1 < pos; });
+			pos += 2 * static_cast<std::size_t>(widened - wideOperands.begin());
+		};
+
+		for (auto& jump : state.Jumps)
+		{
+			shift(jump.Offset);
+		}
+
+		for (auto& switchData : state.Switches)
+		{
+			shift(switchData.Offset);
+		}
+
+		for (auto& label : state.Labels)
+		{
+			shift(label);
+		}
+	}
+
+	/**
+	 * Liveness-based slot allocation
+	 *
+	 * A variable is live from the instruction that first stores it to the last instruction that
+	 * touches it, parameters are live from the start of the function. Walking variables in order
+	 * of when they become live, each one takes the lowest slot freed by a variable whose range has
+	 * already ended, so variables with non-overlapping lifetimes share a frame slot. Parameters
+	 * are walked first and always get the lowest slots, in order, which is where the caller puts them.
+	 *
+	 * Wider variables take 2 or 4 slots starting on a multiple of 2 or 4, so 8-byte values stay 8-byte
+	 * aligned and vectors stay 16-byte aligned in the frame.
+	 *
+	 * Jumps only go backwards at the bottom of a loop, so a range is a span of bytecode offsets,
+	 * except that a variable from before a loop that's used inside it has to stay live to the end
+	 * of the loop, since the next time around reads it again.
+	 */
+	bool allocate_frame_slots(FunctionCompileState& state, FunctionData& fn)
+	{
+		// loops are in the order they finished, so inner loops are extended before the loops around them
+		for (const auto& loop : state.Loops)
+		{
+			for (auto& var : state.Locals)
+			{
+				if (var.LiveStart <= loop.Start && var.LiveEnd >= loop.Start && var.LiveEnd < loop.End)
+				{
+					var.LiveEnd = loop.End;
+				}
+			}
+		}
+
+		std::vector<std::size_t> order(state.Locals.size());
+		for (std::size_t i = 0; i < order.size(); ++i)
+		{
+			order[i] = i;
+		}
+
+		std::stable_sort(order.begin(), order.end(), [&state](std::size_t a, std::size_t b)
+		{
+			return state.Locals[a].LiveStart < state.Locals[b].LiveStart;
+		});
+
+		// variables that are still live, paired with where they die, soonest first
+		using ActiveVariable = std::pair<std::size_t, std::size_t>;
+		std::priority_queue<ActiveVariable, std::vector<ActiveVariable>, std::greater<ActiveVariable>> active;
+		// slots whose variables have died, lowest first
+		std::set<std::size_t> freeSlots;
+
+		std::size_t frameSize = 0;
+		for (auto index : order)
+		{
+			auto& var = state.Locals[index];
+
+			// release the slots of variables that died before this one starts
+			while (!active.empty() && active.top().first < var.LiveStart)
+			{
+				const auto& dead = state.Locals[active.top().second];
+				for (std::size_t i = 0; i < dead.SlotCount; ++i)
+				{
+					freeSlots.insert(dead.Slot + i);
+				}
+				active.pop();
+			}
+
+			// lowest free run of slots that starts on a multiple of its own size
+			std::size_t count = var.SlotCount;
+			auto run = std::find_if(freeSlots.begin(), freeSlots.end(), [&freeSlots, count](std::size_t slot)
+			{
+				if (slot % count != 0)
+				{
+					return false;
+				}
+
+				for (std::size_t i = 1; i < count; ++i)
+				{
+					if (freeSlots.count(slot + i) == 0)
+					{
+						return false;
+					}
+				}
+				return true;
+			});
+
+			if (run != freeSlots.end())
+			{
+				var.Slot = *run;
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					freeSlots.erase(var.Slot + i);
+				}
+			}
+			else
+			{
+				// slots skipped to reach the alignment become free padding
+				while (frameSize % count != 0)
+				{
+					freeSlots.insert(frameSize++);
+				}
+
+				var.Slot = frameSize;
+				frameSize += count;
+			}
+
+			active.push({ var.LiveEnd, index });
+		}
+
+		if (frameSize > SGL_MAX_FRAME_SLOTS)
+		{
+			std::cerr << "Function " << fn.FunctionName << " needs " << frameSize << " variable slots, the limit is "
+				<< SGL_MAX_FRAME_SLOTS << std::endl;
+			return false;
+		}
+
+		encode_slot_operands(state);
+
+		fn.FrameSize = frameSize;
+		return true;
+	}
+
+	/**
+	 * Gives every jump its displacement and its shortest form
+	 *
+	 * A jump that lands on an unconditional jump is pointed at wherever that one goes, and an
+	 * unconditional jump to the instruction right after it is dropped. Then each jump starts out in
+	 * the 8-bit form and only grows to the 32-bit form if its displacement doesn't fit, which can
+	 * push other jumps out of range, so it goes around until nothing grows. Displacements count
+	 * from the end of the jump instruction.
+	 */
+	void encode_jumps(FunctionCompileState& state)
+	{
+		if (state.Jumps.empty())
+		{
+			return;
+		}
+
+		constexpr std::size_t longSize = 1 + sizeof(std::int32_t);
+		constexpr std::size_t shortSize = 1 + sizeof(std::int8_t);
+
+		auto find_jump = [&state](std::size_t offset)
+		{
+			return std::lower_bound(state.Jumps.begin(), state.Jumps.end(), offset,
+				[](const JumpData& jump, std::size_t offset) { return jump.Offset < offset; });
+		};
+
+		// thread jumps through unconditional jumps, a chain can't be longer than the number of jumps
+		for (auto& jump : state.Jumps)
+		{
+			for (std::size_t hops = 0; hops < state.Jumps.size(); ++hops)
+			{
+				auto next = find_jump(state.Labels[jump.Label]);
+				if (next == state.Jumps.end() || next->Offset != state.Labels[jump.Label] || state.Code[next->Offset] != JMP
+					|| next->Label == jump.Label)
+				{
+					break;
+				}
+
+				jump.Label = next->Label;
+			}
+		}
+
+		// bytes each jump takes, 0 for the ones that are dropped
+		std::vector<std::size_t> sizes(state.Jumps.size(), shortSize);
+		for (std::size_t i = 0; i < state.Jumps.size(); ++i)
+		{
+			const auto& jump = state.Jumps[i];
+			if (state.Code[jump.Offset] == JMP && state.Labels[jump.Label] == jump.Offset + longSize)
+			{
+				sizes[i] = 0;
+			}
+		}
+
+		// bytes removed from the code before each jump, so offsets can be mapped to where they end up
+		std::vector<std::size_t> removed(state.Jumps.size() + 1);
+		auto map_offset = [&](std::size_t offset)
+		{
+			return offset - removed[find_jump(offset) - state.Jumps.begin()];
+		};
+
+		bool isGrown = true;
+		while (isGrown)
+		{
+			for (std::size_t i = 0; i < state.Jumps.size(); ++i)
+			{
+				removed[i + 1] = removed[i] + longSize - sizes[i];
+			}
+
+			isGrown = false;
+			for (std::size_t i = 0; i < state.Jumps.size(); ++i)
+			{
+				if (sizes[i] != shortSize)
+				{
+					continue;
+				}
+
+				const auto& jump = state.Jumps[i];
+				auto displacement = static_cast<std::ptrdiff_t>(map_offset(state.Labels[jump.Label]))
+					- static_cast<std::ptrdiff_t>(map_offset(jump.Offset) + shortSize);
+				if (displacement < std::numeric_limits<std::int8_t>::min() || displacement > std::numeric_limits<std::int8_t>::max())
+				{
+					sizes[i] = longSize;
+					isGrown = true;
+				}
+			}
+		}
+
+		std::vector<std::uint8_t> code;
+		code.reserve(state.Code.size());
+
+		std::size_t copied = 0;
+		for (std::size_t i = 0; i < state.Jumps.size(); ++i)
+		{
+			const auto& jump = state.Jumps[i];
+			code.insert(code.end(), state.Code.begin() + copied, state.Code.begin() + jump.Offset);
+			copied = jump.Offset + longSize;
+
+			if (sizes[i] == 0)
+			{
+				continue;
+			}
+
+			auto instruction = static_cast<SGLInstruction>(state.Code[jump.Offset]);
+			auto displacement = static_cast<std::ptrdiff_t>(map_offset(state.Labels[jump.Label]))
+				- static_cast<std::ptrdiff_t>(code.size() + sizes[i]);
+			if (sizes[i] == shortSize)
+			{
+				code.push_back(get_short_jump_instruction(instruction));
+				code.push_back(static_cast<std::uint8_t>(static_cast<std::int8_t>(displacement)));
+			}
+			else
+			{
+				code.push_back(instruction);
+				auto pos = code.size();
+				code.resize(pos + sizeof(std::int32_t));
+				store_to_buffer<std::int32_t>(&code[pos], sizeof(std::int32_t), static_cast<std::int32_t>(displacement));
+			}
+		}
+		code.insert(code.end(), state.Code.begin() + copied, state.Code.end());
+
+		for (auto& label : state.Labels)
+		{
+			label = map_offset(label);
+		}
+
+		for (auto& switchData : state.Switches)
+		{
+			switchData.Offset = map_offset(switchData.Offset);
+		}
+
+		for (std::size_t i = 0; i < state.Jumps.size(); ++i)
+		{
+			state.Jumps[i].Offset -= removed[i];
+		}
+
+		state.Code.swap(code);
+	}
+
+	/**
+	 * Fills in the displacements of every switch, once the code is laid out for good
+	 * Switches are never resized, so they're just carried along while jumps are encoded
+	 */
+	void encode_switches(FunctionCompileState& state)
+	{
+		for (const auto& switchData : state.Switches)
+		{
+			std::uint8_t* operand = &state.Code[switchData.Offset + 1];
+			SGLOperand layout = get_operand_layout(static_cast<SGLInstruction>(state.Code[switchData.Offset]));
+			std::uint8_t* table = operand + get_operand_size(layout);
+			std::size_t end = switchData.Offset + 1 + get_operand_size(layout)
+				+ get_switch_table_size(layout, static_cast<std::uint16_t>(switchData.CaseLabels.size()));
+
+			auto store_displacement = [&](std::uint8_t* field, std::size_t label)
+			{
+				auto displacement = static_cast<std::ptrdiff_t>(state.Labels[label]) - static_cast<std::ptrdiff_t>(end);
+				store_to_buffer<std::int32_t>(field, sizeof(std::int32_t), static_cast<std::int32_t>(displacement));
+			};
+
+			store_displacement(operand + sizeof(std::uint16_t), switchData.DefaultLabel);
+
+			// lookup entries are the key then the displacement
+			std::size_t entrySize = layout == SGLOperand::SWITCH_LOOKUP ? 2 * sizeof(std::int32_t) : sizeof(std::int32_t);
+			for (std::size_t i = 0; i < switchData.CaseLabels.size(); ++i)
+			{
+				store_displacement(table + i * entrySize + entrySize - sizeof(std::int32_t), switchData.CaseLabels[i]);
+			}
+		}
+	}
+
+	/**
+	 * Works out the most bytes the code ever has on the stack, by walking it and adding up what each
+	 * instruction pushes and pops
+	 * Every statement and every jump leaves the stack empty, so a single pass in code order finds the
+	 * deepest point, with the value a return leaves behind dropped after its RETURN
+	 */
+	std::size_t compute_max_stack_size(const std::vector<std::uint8_t>& code)
+	{
+		std::ptrdiff_t depth = 0;
+		std::ptrdiff_t maxDepth = 0;
+
+		std::size_t pos = 0;
+		while (pos < code.size())
+		{
+			auto instruction = static_cast<SGLInstruction>(code[pos]);
+			SGLOperand layout = get_operand_layout(instruction);
+			const std::uint8_t* operand = &code[pos + 1];
+
+			if (instruction == CALL_NATIVE)
+			{
+				// a native pops its arguments and pushes what it returns
+				const SGLNativeFunction& native = get_native_registry().get_function(read_from_buffer<std::uint16_t>(operand));
+				depth += get_type(native.get_return_type()).get_value_size();
+				for (SGLTypeId param : native.get_param_types())
+				{
+					depth -= get_type(param).get_value_size();
+				}
+			}
+			else if (instruction == WIDE)
+			{
+				depth += get_stack_effect(static_cast<SGLInstruction>(operand[0]));
+			}
+			else if (instruction == RETURN)
+			{
+				depth = 0;
+			}
+			else
+			{
+				depth += get_stack_effect(instruction, layout == SGLOperand::BYTE ? operand[0] : 0);
+			}
+
+			maxDepth = std::max(maxDepth, depth);
+			pos += 1 + get_operand_size(layout);
+			if (layout == SGLOperand::SWITCH_TABLE || layout == SGLOperand::SWITCH_LOOKUP)
+			{
+				pos += get_switch_table_size(layout, read_from_buffer<std::uint16_t>(operand));
+			}
+		}
+
+		return static_cast<std::size_t>(maxDepth);
+	}
+
+	bool compile_function_body(FunctionData& fn, ConstantPool& constants, const std::vector<GlobalData>& globals)
+	{
+		// grab a copy of the source
+		std::string source = fn.FunctionSource;
+
+		// trim off everything up to (and including) the bracket
+		auto openingBracket = source.find('{');
+		source.erase(0, openingBracket + 1);
+
+		// trim off the ending bracket and newlines/whitespace
+		source.pop_back();
+		strip_tailing_if(source, g_is_newline_or_whitespace);
+		strip_leading_if(source, g_is_newline_or_whitespace);
+
+		// If the block is empty, it is only a valid function if its return type is void
+		if (source.empty() && fn.ReturnType != SGL_TYPE_VOID)
+		{
+			std::cerr << "Missing return statement in function " << fn.FunctionName << std::endl;
+			return false;
+		}
+
+		FunctionCompileState state;
+		state.Constants = &constants;
+		state.Globals = &globals;
+
+		// parameters are the first variables in the function
+		for (const auto& param : fn.FunctionParams)
+		{
+			if (declare_local(state, param.ParamName, param.ParamType) == std::string::npos)
+			{
+				return false;
+			}
+		}
+
+		state.ReturnType = fn.ReturnType;
+		if (!compile_statements(state, source))
+		{
+			std::cerr << "In function " << fn.FunctionName << std::endl;
+			return false;
+		}
+
+		if (!allocate_frame_slots(state, fn))
+		{
+			return false;
+		}
+
+		encode_jumps(state);
+		encode_switches(state);
+
+		fn.MaxStackSize = compute_max_stack_size(state.Code);
+		fn.WritesGlobals = state.WritesGlobals;
+		fn.Bytecode = std::move(state.Code);
+
+		// lazy bodies compile on whichever thread calls them first, so this goes through the sink rather than std::cout
+		if (g_isVerbose.load(std::memory_order_relaxed))
+		{
+			get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Function ", fn.FunctionName, " compiled to ", fn.Bytecode.size(),
+				" bytes with ", state.Locals.size(), " variables in ", fn.FrameSize, " frame slots.");
+		}
+
+		return true;
+	}
+
+	/**
+	 * Lays out the globals declared outside of functions and builds the image instances start from
+	 * Initial values are worked out here, so they have to be constants
+	 */
+	bool compile_globals(const std::string& source, Script& script)
+	{
+		std::vector<GlobalData> globals;
+		std::vector<std::uint8_t> image;
+
+		std::size_t declStart = 0;
+		while (declStart < source.length())
+		{
+			auto declEnd = find_unquoted(source, ";", declStart);
+			std::string decl = source.substr(declStart, declEnd == std::string::npos ? std::string::npos : declEnd - declStart);
+			strip_leading_if(decl, g_is_newline_or_whitespace);
+			strip_tailing_if(decl, g_is_newline_or_whitespace);
+
+			if (declEnd == std::string::npos)
+			{
+				if (!decl.empty())
+				{
+					std::cerr << "Missing semicolon after global declaration " << decl << std::endl;
+					return false;
+				}
+				break;
+			}
+
+			declStart = declEnd + 1;
+			if (decl.empty())
+			{
+				continue;
+			}
+
+			std::string initializer;
+			auto assign = find_unquoted(decl, "=");
+			if (assign != std::string::npos)
+			{
+				initializer = decl.substr(assign + 1);
+				decl.erase(assign);
+				strip_tailing_whitespace(decl);
+			}
+
+			GlobalData global;
+			if (!parse_declaration(decl, global.GlobalType, global.GlobalName))
+			{
+				return false;
+			}
+
+			for (const auto& existing : globals)
+			{
+				if (existing.GlobalName == global.GlobalName)
+				{
+					std::cerr << "Global " << global.GlobalName << " is declared more than once" << std::endl;
+					return false;
+				}
+			}
+
+			const SGLType& type = get_type(global.GlobalType);
+			if (get_global_load_instruction(global.GlobalType) == INVALID_INSTRUCTION)
+			{
+				std::cerr << "Globals of type " << type.TypeName << " are not supported yet" << std::endl;
+				return false;
+			}
+
+			std::size_t size = type.get_value_size();
+			std::size_t alignment = type.get_value_alignment();
+			global.Offset = (image.size() + alignment - 1) / alignment * alignment;
+			if (global.Offset + size > SGL_MAX_GLOBALS_SIZE)
+			{
+				std::cerr << "Globals need more than " << SGL_MAX_GLOBALS_SIZE << " bytes" << std::endl;
+				return false;
+			}
+
+			// padding and globals without an initial value start out zeroed
+			image.resize(global.Offset + size, 0);
+
+			if (!initializer.empty())
+			{
+				// the initial value is compiled on its own so folding can reduce it to a constant
+				ConstantPool scratchPool;
+				FunctionCompileState scratch;
+				scratch.Constants = &scratchPool;
+
+				auto value = compile_expression(scratch, initializer);
+				if (!value.Success)
+				{
+					std::cerr << "In initial value of global " << global.GlobalName << std::endl;
+					return false;
+				}
+				else if (!value.IsConstant)
+				{
+					std::cerr << "Initial value of global " << global.GlobalName << " must be a constant" << std::endl;
+					return false;
+				}
+				else if (value.ResultType != global.GlobalType && get_cast_instruction(value.ResultType, global.GlobalType) == INVALID_INSTRUCTION)
+				{
+					std::cerr << "Cannot convert " << get_type(value.ResultType).TypeName << " to " << type.TypeName
+						<< " for global " << global.GlobalName << std::endl;
+					return false;
+				}
+
+				std::uint8_t* dest = &image[global.Offset];
+				if (global.GlobalType == SGL_TYPE_STRING)
+				{
+					// the image is saved with the script, so it can't hold pointers into this process's string table
+					if (value.StringValue.length() > SGL_STRING_INLINE_CAPACITY)
+					{
+						std::cerr << "Initial value of string global " << global.GlobalName << " can be at most "
+							<< SGL_STRING_INLINE_CAPACITY << " characters, assign longer strings in a function" << std::endl;
+						return false;
+					}
+
+					SGLString str = SGLString::make_inline(value.StringValue);
+					std::memcpy(dest, &str, sizeof(str));
+					globals.push_back(std::move(global));
+					continue;
+				}
+
+				value = convert_constant(value, global.GlobalType);
+				switch (global.GlobalType)
+				{
+					case SGL_TYPE_INT32:
+						store_to_buffer<std::int32_t>(dest, size, static_cast<std::int32_t>(value.IntValue));
+						break;
+					case SGL_TYPE_INT64:
+						store_to_buffer<std::int64_t>(dest, size, value.IntValue);
+						break;
+					case SGL_TYPE_FLOAT:
+						store_to_buffer<float>(dest, size, static_cast<float>(value.FloatValue));
+						break;
+					default:
+						store_to_buffer<double>(dest, size, value.FloatValue);
+						break;
+				}
+			}
+
+			globals.push_back(std::move(global));
+		}
+
+		if (globals.empty())
+		{
+			return true;
+		}
+
+		return script.set_globals(std::move(globals), std::move(image));
+	}
+
+	void set_verbose(bool verbose)
+	{
+		g_isVerbose.store(verbose, std::memory_order_relaxed);
+	}
+
+	bool compile_source(std::string source)
+	{
+		Script script;
+		return compile_source(source, script, CompileMode::Eager);
+	}
+
+	bool compile_source(std::string source, Script& script, CompileMode mode)
+	{
+		bool result = true;
+
+		CompilerState state;
+
+		// Run preprocessor
+		result = preprocess_source(source);
+		if (!result)
+		{
+			return false;
+		}
+
+		// Find all function declarations, anything outside of them declares globals
+		std::string globalsSource;
+		std::size_t lastFunc = 0;
+		while (lastFunc != std::string::npos)
+		{
+			auto funcStart = find_unquoted(source, "func:", lastFunc);
+			if (funcStart != std::string::npos)
+			{
+				// find opening bracket
+				auto openBracket = source.find('{', funcStart);
+				if (openBracket == std::string::npos)
+				{
+					// function with no body, error
+					auto lineNum = get_line_num(source, funcStart);
+					auto line = get_full_line(source,funcStart);
+					std::cerr << "Function declared on line " << lineNum << ", but no function body was found.\nLine:"
+						<< line << std::endl;
+					return false;
+				}
+
+				// find closing bracket
+				auto endBracket = find_matching_bracket(source, openBracket);
+				if (endBracket == std::string::npos)
+				{
+					// function body missing closer
+					// Can't return specific information since it's hard to say where the missing bracket occured
+					std::cerr << "Missing bracket detected while parsing function declarations" << std::endl;
+					return false;
+				}
+
+				// only take this function's source, a deferred body must not carry the functions after it
+				auto funcSource = source.substr(funcStart, endBracket + 1 - funcStart);
+				auto fn = parse_function_def(funcSource);
+				if (!fn.is_valid())
+				{
+					return false;
+				}
+
+				state.Functions.push_back(fn);
+
+				globalsSource.append(source, lastFunc, funcStart - lastFunc);
+				lastFunc = endBracket + 1;
+			}
+			else
+			{
+				globalsSource.append(source, lastFunc, std::string::npos);
+				lastFunc = std::string::npos;
+			}
+		}
+
+		// globals are laid out before any body compiles, so every function sees all of them
+		result = compile_globals(globalsSource, script);
+		if (!result)
+		{
+			return false;
 		}
 
 		// Now that function names, return types, and params are documented, we can compile each one
 		// Doing the first part before compiling the bodies allows each function to call each other
 		// without requiring them to be ordered some specific way
-		for (auto fn : state.Functions)
+		// In lazy mode the bodies are handed to the script as-is and compiled on their first call
+		if (mode == CompileMode::Eager)
+		{
+			for (auto& fn : state.Functions)
+			{
+				result = compile_function_body(fn, script.get_constants(), script.get_globals());
+				if (!result)
+				{
+					return false;
+				}
+			}
+		}
+
+		for (auto& fn : state.Functions)
 		{
-			result = compile_function_body(fn);
-			if (!result)
+			if (!script.add_function(std::move(fn), mode == CompileMode::Eager))
 			{
 				return false;
 			}
@@ -1,12 +1,16 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include "SGLTypes.h"
 
 /**
  * Compiler V2
- * 
+ *
  * The old compiler file was littered with... lessons learned, to put it nicely.
- * I wanted to start fresh and keep only the parts that have worked so far, as 
+ * I wanted to start fresh and keep only the parts that have worked so far, as
  * well as begin building out a more sensible architecture.
  *
  * I don't want the compiler to be tied to an instance of some class, because I
@@ -15,7 +19,100 @@
  * exposed to handle it.
  */
 
+class ConstantPool;
+class Script;
+
 namespace SGL
 {
+    /**
+     * Struct that holds information about functions delcared in the SGL script
+     */
+    struct FunctionData
+    {
+        // Original source code of the function
+        std::string FunctionSource;
+        // Name to call function
+        std::string FunctionName;
+        // Return type of the function
+        SGLTypeId ReturnType = SGL_TYPE_VOID;
+
+        /**
+         * Struct to hold function parameter info
+         */
+        struct FunctionParam
+        {
+            SGLTypeId ParamType = SGL_INVALID_TYPE_ID;
+            std::string ParamName;
+        };
+
+        // Array of parameters for the function
+        std::vector<FunctionParam> FunctionParams;
+
+        // Bytecode emitted for the function body, empty until the body is compiled
+        std::vector<std::uint8_t> Bytecode;
+
+        // Number of variable slots the function's frame needs, set when the body is compiled
+        // Parameters occupy slots 0..n-1, the rest are shared by locals with non-overlapping lifetimes
+        std::size_t FrameSize = 0;
+
+        // Most bytes the body ever has on the stack above its frame, set when the body is compiled
+        // The VM makes sure there's room for the frame and this much when the function is entered
+        std::size_t MaxStackSize = 0;
+
+        // True if the body stores to any global, so running it changes its instance's state
+        bool WritesGlobals = false;
+
+        bool is_valid() const
+        {
+            return FunctionName.length() > 0;
+        }
+    };
+
+    /**
+     * Struct that holds information about a global variable declared in the SGL script
+     * Every instance of the script has its own copy, at the same offset in its globals block
+     */
+    struct GlobalData
+    {
+        // Name of the global
+        std::string GlobalName;
+        // Type of the global
+        SGLTypeId GlobalType = SGL_INVALID_TYPE_ID;
+        // Byte offset of the global in the globals block, aligned for its type
+        std::size_t Offset = 0;
+    };
+
+    /**
+     * Controls how much work compile_source does up front
+     */
+    enum class CompileMode
+    {
+        // Every function body is compiled before compile_source returns
+        Eager,
+        // Only signatures are parsed, bodies are compiled the first time the function is called
+        Lazy
+    };
+
+    /**
+     * Turns the compiler's report of each function it parses and compiles on or off, it's off to begin with
+     * Reports go to the print sink's diagnostic channel, since lazy bodies compile on whichever thread calls them first
+     */
+    void set_verbose(bool verbose);
+
+    /**
+     * Compiles the source and throws away the result, useful for checking syntax
+     */
     bool compile_source(std::string source);
+
+    /**
+     * Compiles the source and stores the functions it declares into the given script
+     * In lazy mode, function bodies are left as stubs until Script::get_function is called for them
+     */
+    bool compile_source(std::string source, Script& script, CompileMode mode = CompileMode::Eager);
+
+    /**
+     * Compiles the body of a function whose signature has already been parsed
+     * Constants the body uses are added to the given pool, and globals are resolved against the given layout
+     */
+    bool compile_function_body(FunctionData& fn, ConstantPool& constants, const std::vector<GlobalData>& globals);
 }
\ No newline at end of file
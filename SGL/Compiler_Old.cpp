@@ -9,6 +9,7 @@
 
 #include "Instructions.h"
 #include "SGLTypes.h"
+#include "SymbolTable.h"
 
 constexpr const std::size_t MAX_SIZE = std::numeric_limits<std::size_t>::max();
 
@@ -21,56 +22,42 @@ struct SGLOperator
 // Array of operators in order of lowest to highest precedence
 std::vector<SGLOperator> SGL_ops = { { "=", 0 }, { "-", 1 }, { "+", 1 }, { "%", 2 }, { "/", 2 }, {"*", 2} };
 
-struct VariableState
-{
-	std::string VariableIdentifier = "";
-	SGLType VariableType;
-
-	/**
-	 * Returns true if this VariableState slot is being used
-	 */
-	bool IsUsed() { return !VariableIdentifier.empty(); }
-
-	/**
-	 * Sets this VariableState slot to unused
-	 */
-	void SetUnused() { VariableIdentifier.clear(); }
-};
-
 /**
  * Holds info on the compiler's current state
  */
 struct CompilerState
 {
-	std::vector<VariableState> Variables;
+	// Every variable identifier seen so far, interned
+	SGL::IdentifierTable Identifiers;
+	// Variables visible at the current point of compilation
+	SGL::SymbolTable Symbols;
+	// Type of the variable held in each slot
+	std::vector<SGLTypeId> SlotTypes;
 
 	/**
 	 * Prepares the compiler for a new run
 	 */
 	void Prepare()
 	{
-		Variables.clear();
-		for (auto i = 0; i < 10; ++i)
-		{
-			// fill with 10 preset variable slots
-			Variables.push_back(VariableState());
-		}
+		Identifiers.clear();
+		Symbols.clear();
+		SlotTypes.clear();
 	}
 
-	std::size_t GetAvailableVariableSlot()
+	/**
+	 * Declares a variable in the current scope and returns the slot it was given
+	 * Returns size_t's max value if the identifier is already declared in this scope
+	 */
+	std::size_t DeclareVariable(const std::string& id, const SGLType& type)
 	{
-		// Find an unused slot
-		for (std::size_t i = 0; i < Variables.size(); ++i)
+		std::size_t slot = SlotTypes.size();
+		if (!Symbols.declare(Identifiers.intern(id), type.TypeId, slot))
 		{
-			if (!Variables[i].IsUsed())
-			{
-				return i;
-			}
+			return MAX_SIZE;
 		}
 
-		// If all are in use, add a new one and return its index
-		Variables.push_back(VariableState());
-		return Variables.size() - 1;
+		SlotTypes.push_back(type.TypeId);
+		return slot;
 	}
 
 	/**
@@ -79,16 +66,21 @@ struct CompilerState
 	 */
 	std::size_t GetSlotForIdentifier(const std::string& id)
 	{
-		std::size_t slot = 0;
-		for (slot = 0; slot < Variables.size(); ++slot)
+		const SGL::Symbol* sym = Symbols.resolve(Identifiers.find(id));
+		if (!sym)
 		{
-			if (Variables[slot].VariableIdentifier == id)
-			{
-				return slot;
-			}
+			return MAX_SIZE;
 		}
 
-		return MAX_SIZE;
+		return sym->Slot;
+	}
+
+	/**
+	 * Returns the type of the variable in the given slot
+	 */
+	const SGLType& GetVariableType(std::size_t slot)
+	{
+		return get_type(SlotTypes[slot]);
 	}
 };
 
@@ -273,7 +265,7 @@ VariableDeclaration parse_variable(std::string& line)
 		return decl;
 	}
 
-	decl.Type = get_types()[typeStr];
+	decl.Type = get_type(typeStr);
 
 	// erase the type from the line now that it's parsed
 	line.erase(0, typeEnd);
@@ -488,11 +480,7 @@ std::size_t parse_assignment_left(std::string expr)
 			return MAX_SIZE;
 		}
 
-		std::size_t slot = SGL_CompilerState.GetAvailableVariableSlot();
-		SGL_CompilerState.Variables[slot].VariableType = decl.Type;
-		SGL_CompilerState.Variables[slot].VariableIdentifier = decl.Identifier;
-
-		return slot;
+		return SGL_CompilerState.DeclareVariable(decl.Identifier, decl.Type);
 	}
 	else
 	{
@@ -637,10 +625,10 @@ ExpressionResult parse_expression(std::string expr)
 				return result;
 			}
 
-			SGLType leftType = SGL_CompilerState.Variables[leftSlot].VariableType;
+			SGLType leftType = SGL_CompilerState.GetVariableType(leftSlot);
 			SGLType rightType = rightResult.ResultType;
 
-			if (leftType.TypeName != rightType.TypeName)
+			if (leftType != rightType)
 			{
 				// need to cast right side
 				SGLInstruction cast = get_cast_instruction(rightType, leftType);
@@ -690,7 +678,7 @@ ExpressionResult parse_expression(std::string expr)
 			else
 			{
 				// check if the types on either side are equal
-				if (leftResult.ResultType.TypeName != rightResult.ResultType.TypeName)
+				if (leftResult.ResultType != rightResult.ResultType)
 				{
 					// If types are not the same, the right operand needs to be cast to the left operand if possible
 					SGLType leftType = leftResult.ResultType;
@@ -769,18 +757,15 @@ ExpressionResult parse_expression(std::string expr)
 				return result;
 			}
 			
-			// make sure this isn't a redeclaration of an existing variable
-			if (SGL_CompilerState.GetSlotForIdentifier(varDecl.Identifier) != MAX_SIZE)
+			// declaring fails if this is a redeclaration of an existing variable
+			std::size_t varPos = SGL_CompilerState.DeclareVariable(varDecl.Identifier, varDecl.Type);
+			if (varPos == MAX_SIZE)
 			{
 				std::cerr << "Cannot declare two variables with the same identifier!" << std::endl;
 				result.Success = false;
 				return result;
 			}
 
-			// if all is well, push this to the variable list
-			std::size_t varPos = SGL_CompilerState.GetAvailableVariableSlot();
-			SGL_CompilerState.Variables[varPos] = { varDecl.Identifier, varDecl.Type };
-
 			result.Success = true;
 			result.VarSlot = varPos;
 			result.ResultType = varDecl.Type;
@@ -799,7 +784,7 @@ ExpressionResult parse_expression(std::string expr)
 				// emit instruction to load variable
 				// for now, int is supported only
 				std::cout << "INT_LOAD " << slot << std::endl;
-				result.ResultType = SGL_CompilerState.Variables[slot].VariableType;
+				result.ResultType = SGL_CompilerState.GetVariableType(slot);
 				result.VarSlot = slot;
 				return result;
 			}
@@ -811,7 +796,7 @@ ExpressionResult parse_expression(std::string expr)
 					int value = std::stoi(expr, nullptr, 0);
 					std::cout << "INT_CONST " << value << std::endl;
 
-					result.ResultType = get_types()["int32"];
+					result.ResultType = get_type(SGL_TYPE_INT32);
 					return result;
 				}
 				else
@@ -863,6 +848,9 @@ SGLResult compile_sgl(std::string source)
 		return SGLResult::SGL_ERR_SOURCE_INVALID;
 	}
 
+	// globals from a previous compile would otherwise count as redeclarations
+	SGL_CompilerState.Prepare();
+
 	/**
 	 * Preprocessing - strip line and block comments and remove all newlines
 	 */
@@ -1015,9 +1003,11 @@ SGLResult compile_sgl(std::string source)
 			source.erase(0, endOfStatement + 1);
 
 			std::cout << "Variable declaration, type=\"" << var.Type.TypeName << "\" id=\"" << var.Identifier << "\" val=\"" << var.Value << "\"" << std::endl;
-			auto pos = SGL_CompilerState.GetAvailableVariableSlot();
-			SGL_CompilerState.Variables[pos].VariableIdentifier = var.Identifier;
-			SGL_CompilerState.Variables[pos].VariableType = var.Type;
+			if (SGL_CompilerState.DeclareVariable(var.Identifier, var.Type) == MAX_SIZE)
+			{
+				std::cerr << "Cannot declare two variables with the same identifier!" << std::endl;
+				return SGLResult::SGL_ERR_REDECLARED_IDENTIFIER;
+			}
 		}
 
 		if (source.empty())
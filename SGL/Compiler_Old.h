@@ -28,7 +28,9 @@ enum class SGLResult
     // Error when an operator is found but there is no operand to the left of it
     SGL_ERR_MISSING_LEFT_OPERAND,
     // Error when an operator is found but there is no operand to the right of it
-    SGL_ERR_MISSING_RIGHT_OPERAND
+    SGL_ERR_MISSING_RIGHT_OPERAND,
+    // Error when a variable is declared again with an identifier already declared in the same scope
+    SGL_ERR_REDECLARED_IDENTIFIER
 };
 
 /**
@@ -0,0 +1,82 @@
+#include "ConstantPool.h"
+
+#include <cstring>
+
+ConstantPool::ConstantPool()
+	: _wordCount(0)
+	, _stringCount(0)
+{}
+
+std::uint32_t ConstantPool::add_int(int value)
+{
+	std::uint32_t word;
+	std::memcpy(&word, &value, sizeof(word));
+	return add_word(word);
+}
+
+std::uint32_t ConstantPool::add_float(float value)
+{
+	// floats are deduplicated by bit pattern, so 0.0 and -0.0 stay separate
+	std::uint32_t word;
+	std::memcpy(&word, &value, sizeof(word));
+	return add_word(word);
+}
+
+std::uint32_t ConstantPool::add_word(std::uint32_t word)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto existing = _wordIndices.find(word);
+	if (existing != _wordIndices.end())
+	{
+		return existing->second;
+	}
+
+	std::size_t index = _wordCount;
+	if (index >= SGL_MAX_CONSTANTS)
+	{
+		return SGL_INVALID_CONSTANT;
+	}
+
+	auto& chunk = _chunks[index / SGL_CONSTANT_CHUNK_WORDS];
+	if (!chunk)
+	{
+		chunk = std::make_unique<Chunk>();
+	}
+	chunk->Words[index % SGL_CONSTANT_CHUNK_WORDS] = word;
+
+	_wordIndices[word] = static_cast<std::uint32_t>(index);
+	_wordCount = index + 1;
+
+	return static_cast<std::uint32_t>(index);
+}
+
+std::uint32_t ConstantPool::add_string(const std::string& value)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto existing = _stringIndices.find(value);
+	if (existing != _stringIndices.end())
+	{
+		return existing->second;
+	}
+
+	std::size_t index = _stringCount;
+	if (index >= SGL_MAX_CONSTANTS)
+	{
+		return SGL_INVALID_CONSTANT;
+	}
+
+	auto& chunk = _stringChunks[index / SGL_CONSTANT_CHUNK_STRINGS];
+	if (!chunk)
+	{
+		chunk = std::make_unique<StringChunk>();
+	}
+	chunk->Strings[index % SGL_CONSTANT_CHUNK_STRINGS] = value;
+	chunk->Values[index % SGL_CONSTANT_CHUNK_STRINGS] = get_string_table().intern(value);
+
+	_stringIndices[value] = static_cast<std::uint32_t>(index);
+	_stringCount = index + 1;
+
+	return static_cast<std::uint32_t>(index);
+}
\ No newline at end of file
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "SGLString.h"
+
+// Most constants a pool can hold, pool indices are 16-bit operands
+constexpr std::size_t SGL_MAX_CONSTANTS = 65536;
+
+// Number of 32-bit words in each block of pool storage
+constexpr std::size_t SGL_CONSTANT_CHUNK_WORDS = 1024;
+
+// Number of strings in each block of pool storage
+constexpr std::size_t SGL_CONSTANT_CHUNK_STRINGS = 256;
+
+// Value returned when a constant can't be added to the pool
+constexpr std::uint32_t SGL_INVALID_CONSTANT = 0xFFFFFFFF;
+
+/**
+ * Deduplicated storage for the constants used by compiled code
+ *
+ * Numeric constants are stored as aligned 32-bit words and deduplicated by bit pattern, so
+ * every use of the same value anywhere in the module (or in every module sharing the pool)
+ * refers to the same word. String constants are deduplicated by content, and each is interned in
+ * the string table so the code that pushes it gets the same value as every other use of it.
+ *
+ * Storage is allocated in fixed blocks that never move, so code running on one thread can
+ * keep reading constants while a lazily compiled function adds more on another.
+ */
+class ConstantPool
+{
+public:
+
+	ConstantPool();
+
+	/**
+	 * Returns the index of the given int, adding it if it isn't already in the pool
+	 * Returns SGL_INVALID_CONSTANT if the pool is full
+	 */
+	std::uint32_t add_int(int value);
+
+	/**
+	 * Returns the index of the given float, adding it if it isn't already in the pool
+	 * Returns SGL_INVALID_CONSTANT if the pool is full
+	 */
+	std::uint32_t add_float(float value);
+
+	/**
+	 * Returns the index of the given 32-bit pattern, adding it if it isn't already in the pool
+	 * Returns SGL_INVALID_CONSTANT if the pool is full
+	 */
+	std::uint32_t add_word(std::uint32_t word);
+
+	/**
+	 * Returns the index of the given string, adding it if it isn't already in the pool
+	 * String indices are separate from numeric indices
+	 * Returns SGL_INVALID_CONSTANT if the pool is full
+	 */
+	std::uint32_t add_string(const std::string& value);
+
+	/**
+	 * Returns the 32-bit word at the given index
+	 */
+	std::uint32_t get_word(std::uint32_t index) const
+	{
+		return _chunks[index / SGL_CONSTANT_CHUNK_WORDS]->Words[index % SGL_CONSTANT_CHUNK_WORDS];
+	}
+
+	/**
+	 * Returns the string at the given index
+	 */
+	const std::string& get_string(std::uint32_t index) const
+	{
+		return _stringChunks[index / SGL_CONSTANT_CHUNK_STRINGS]->Strings[index % SGL_CONSTANT_CHUNK_STRINGS];
+	}
+
+	/**
+	 * Returns the value STRING_CONST_POOL pushes for the string at the given index
+	 */
+	SGLString get_string_value(std::uint32_t index) const
+	{
+		return _stringChunks[index / SGL_CONSTANT_CHUNK_STRINGS]->Values[index % SGL_CONSTANT_CHUNK_STRINGS];
+	}
+
+	/**
+	 * Returns the number of numeric constants in the pool
+	 */
+	std::size_t get_word_count() const
+	{
+		return _wordCount;
+	}
+
+	/**
+	 * Returns the number of string constants in the pool
+	 */
+	std::size_t get_string_count() const
+	{
+		return _stringCount;
+	}
+
+private:
+
+	/**
+	 * A fixed block of storage, aligned so wider constants can be read with aligned loads
+	 */
+	struct alignas(16) Chunk
+	{
+		std::uint32_t Words[SGL_CONSTANT_CHUNK_WORDS];
+	};
+
+	/**
+	 * A fixed block of string storage
+	 */
+	struct StringChunk
+	{
+		std::string Strings[SGL_CONSTANT_CHUNK_STRINGS];
+		// The strings as script values, interned
+		SGLString Values[SGL_CONSTANT_CHUNK_STRINGS];
+	};
+
+	// Blocks of numeric constants, allocated as they fill up
+	std::array<std::unique_ptr<Chunk>, SGL_MAX_CONSTANTS / SGL_CONSTANT_CHUNK_WORDS> _chunks;
+	// Number of numeric constants written
+	std::atomic<std::size_t> _wordCount;
+	// Word -> index lookup used for deduplication
+	std::unordered_map<std::uint32_t, std::uint32_t> _wordIndices;
+
+	// Blocks of string constants, allocated as they fill up
+	std::array<std::unique_ptr<StringChunk>, SGL_MAX_CONSTANTS / SGL_CONSTANT_CHUNK_STRINGS> _stringChunks;
+	// Number of string constants written
+	std::atomic<std::size_t> _stringCount;
+	// String -> index lookup used for deduplication
+	std::unordered_map<std::string, std::uint32_t> _stringIndices;
+
+	// Guards adding constants
+	std::mutex _mutex;
+
+};
\ No newline at end of file
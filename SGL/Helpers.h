@@ -1,72 +1,113 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <type_traits>
 
 /**
- * Reads the requested type from the buffer, making sure it's aligned properly
- * Also can perform endian swapping if SGL_BIG_ENDIAN is defined
+ * Reads the requested type from the buffer
+ * Bytecode is always in this machine's byte order by the time it runs (see Script::load_from_bytecode),
+ * so this is a plain load. memcpy is only there because operands don't sit on aligned offsets.
  */
 template <class T>
-T read_from_buffer(std::uint8_t* buffer)
+T read_from_buffer(const std::uint8_t* buffer)
 {
-	T ret = 0;
+	T ret;
 	std::memcpy(&ret, buffer, sizeof(T));
-
-#ifdef SGL_BIG_ENDIAN
-	// do endian swap on integral types
-	if constexpr (std::is_integral_v<T>)
-	{
-		constexpr const std::size_t Tsize = sizeof(T);
-		if constexpr (Tsize == 2)
-		{
-			_byteswap_ushort(ret);
-		}
-		if constexpr (Tsize == 4)
-		{
-			_byteswap_ulong(ret);
-		}
-		if constexpr (Tsize == 8)
-		{
-			_byteswap_uint64(ret);
-		}
-	}
-#endif
-
 	return ret;
 }
 
 /**
- * Stores the requested value into the given buffer
- * Also can perform endian swapping if SGL_BIG_ENDIAN is defined
+ * Stores the requested value into the given buffer in this machine's byte order
  */
 template <class T>
 void store_to_buffer(std::uint8_t* buffer, std::size_t max_size, const T& value)
 {
-	T write = value;
+	// only write up to the size of the buffer
+	std::memcpy(buffer, &value, std::min(max_size, sizeof(T)));
+}
+
+/**
+ * Returns true if this machine stores the least significant byte first
+ */
+inline bool is_host_little_endian()
+{
+	const std::uint16_t probe = 1;
+	std::uint8_t first;
+	std::memcpy(&first, &probe, 1);
+	return first == 1;
+}
+
+/**
+ * Returns the value with its bytes reversed
+ */
+template <class T>
+T swap_endian(T value)
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be byte swapped");
+
+	std::uint8_t bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	std::reverse(bytes, bytes + sizeof(T));
+	std::memcpy(&value, bytes, sizeof(T));
+	return value;
+}
+
+/**
+ * Reverses the bytes of a value stored in a buffer, in place
+ */
+inline void swap_endian_in_buffer(std::uint8_t* buffer, std::size_t size)
+{
+	std::reverse(buffer, buffer + size);
+}
 
-#ifdef SGL_BIG_ENDIAN
-	// do endian swap on integral types
-	if constexpr (std::is_integral_v<T>)
+/**
+ * Returns a copy of the array sorted by 'less', usable in constant expressions
+ * std::sort isn't constexpr before C++20, so this is a heapsort to keep compile time low on big tables
+ */
+template <class T, std::size_t N, class Less>
+constexpr std::array<T, N> sort_constexpr(std::array<T, N> items, Less less)
+{
+	auto swap_items = [&items](std::size_t a, std::size_t b)
 	{
-		constexpr const std::size_t Tsize = sizeof(T);
-		if constexpr (Tsize == 2)
-		{
-			_byteswap_ushort(write);
-		}
-		if constexpr (Tsize == 4)
-		{
-			_byteswap_ulong(write);
-		}
-		if constexpr (Tsize == 8)
+		T swapped = items[a];
+		items[a] = items[b];
+		items[b] = swapped;
+	};
+
+	// moves the item at 'root' down until it's larger than both children, within the first 'end' items
+	auto sift_down = [&items, &less, &swap_items](std::size_t root, std::size_t end)
+	{
+		for (std::size_t child = root * 2 + 1; child < end; child = root * 2 + 1)
 		{
-			_byteswap_uint64(write);
+			if (child + 1 < end && less(items[child], items[child + 1]))
+			{
+				++child;
+			}
+
+			if (!less(items[root], items[child]))
+			{
+				return;
+			}
+
+			swap_items(root, child);
+			root = child;
 		}
+	};
+
+	for (std::size_t i = N / 2; i-- > 0;)
+	{
+		sift_down(i, N);
 	}
-#endif
 
-	// only write up to the size of the buffer
-	std::memcpy(buffer, &write, std::min(max_size, sizeof(T)));
+	for (std::size_t end = N; end > 1; --end)
+	{
+		swap_items(0, end - 1);
+		sift_down(0, end - 1);
+	}
+
+	return items;
 }
\ No newline at end of file
@@ -4,16 +4,48 @@
 
 #include "SGLTypes.h"
 
+// Size in bytes of one variable slot in a function's frame
+constexpr std::size_t SGL_SLOT_SIZE = 4;
+
+// Most variable slots a frame can have
+// Slot operands are a single byte, slots past 255 are reached with the WIDE prefix
+constexpr std::size_t SGL_MAX_FRAME_SLOTS = 65536;
+
+// Largest globals block a script can have, global instructions hold a 16-bit offset
+constexpr std::size_t SGL_MAX_GLOBALS_SIZE = 65536;
+
+// Fewest cases an if/else-if chain on one int32 needs before the compiler turns it into a switch
+constexpr std::size_t SGL_SWITCH_MIN_CASES = 4;
+
+// Most cases a switch can have, its case count is 16 bits
+constexpr std::size_t SGL_SWITCH_MAX_CASES = 65535;
+
 enum SGLInstruction : std::uint8_t
 {
 	// Pushes an integer constant onto the stack
 	// Following 4 bytes after this instruction are the int constant
 	INT_CONST,
-	// Pops the integer on top of the stack and stores it to a variable position
-	// Following 1 byte is the variable pos to store to
+	// Pushes the integer 0 onto the stack
+	INT_CONST_0,
+	// Pushes the integer 1 onto the stack
+	INT_CONST_1,
+	// Pushes an integer constant that fits in a signed byte onto the stack
+	// Following 1 byte is the constant, sign extended to 32 bits
+	INT_CONST_8,
+	// Pushes an integer constant that fits in 16 bits onto the stack
+	// Following 2 bytes are the constant, sign extended to 32 bits
+	INT_CONST_16,
+	// Pushes an integer constant from the script's constant pool onto the stack
+	// Following 2 bytes are the index of the constant in the pool
+	INT_CONST_POOL,
+	// Pushes a float constant from the script's constant pool onto the stack
+	// Following 2 bytes are the index of the constant in the pool
+	FLOAT_CONST_POOL,
+	// Pops the integer on top of the stack and stores it to a variable slot in the current frame
+	// Following 1 byte is the variable slot to store to
 	INT_STORE,
-	// Loads an integer value from a variable position and pushes the value to the stack
-	// Following 1 byte is the variable pos to load from
+	// Loads an integer value from a variable slot in the current frame and pushes the value to the stack
+	// Following 1 byte is the variable slot to load from
 	INT_LOAD,
 	// Pops the top two ints on the stack, adds them, and pushes the result
 	INT_ADD,
@@ -29,40 +61,939 @@ enum SGLInstruction : std::uint8_t
 	INT_TO_FLOAT,
 	// Pops the top float on the stack, casts to int, and pushes the int
 	FLOAT_TO_INT,
+	// Prefix that widens the slot operand of the instruction after it to 2 bytes
+	// Following 1 byte is the load or store instruction being widened, then the 2 byte slot
+	WIDE,
+	// Pushes a float constant onto the stack
+	// Following 4 bytes after this instruction are the float constant
+	FLOAT_CONST,
+	// Pops the float on top of the stack and stores it to a variable slot in the current frame
+	// Following 1 byte is the variable slot to store to
+	FLOAT_STORE,
+	// Loads a float value from a variable slot in the current frame and pushes the value to the stack
+	// Following 1 byte is the variable slot to load from
+	FLOAT_LOAD,
+	// Pops the top two floats on the stack, adds them, and pushes the result
+	FLOAT_ADD,
+	// Pops the top two floats on the stack, subtracts them (left to right), and pushes the result
+	FLOAT_SUB,
+	// Pops the top two floats on the stack, multiplies them, and pushes the result
+	FLOAT_MUL,
+	// Pops the top two floats on the stack, divides them (left to right), and pushes the result
+	FLOAT_DIV,
+	// Pushes a 64-bit integer constant onto the stack
+	// Following 8 bytes after this instruction are the constant
+	INT64_CONST,
+	// Pushes a zero 8 bytes wide onto the stack, which is also a double 0.0
+	INT64_CONST_0,
+	// Pushes a double constant onto the stack
+	// Following 8 bytes after this instruction are the constant
+	DOUBLE_CONST,
+	// Pops the 64-bit integer on top of the stack and stores it to a variable slot in the current frame
+	// Following 1 byte is the first of the two variable slots to store to
+	INT64_STORE,
+	// Loads a 64-bit integer from a variable slot in the current frame and pushes the value to the stack
+	// Following 1 byte is the first of the two variable slots to load from
+	INT64_LOAD,
+	// Pops the double on top of the stack and stores it to a variable slot in the current frame
+	// Following 1 byte is the first of the two variable slots to store to
+	DOUBLE_STORE,
+	// Loads a double from a variable slot in the current frame and pushes the value to the stack
+	// Following 1 byte is the first of the two variable slots to load from
+	DOUBLE_LOAD,
+	// Pops the top two 64-bit ints on the stack, adds them, and pushes the result
+	INT64_ADD,
+	// Pops the top two 64-bit ints on the stack, subtracts them (left to right), and pushes the result
+	INT64_SUB,
+	// Pops the top two 64-bit ints on the stack, multiplies them, and pushes the result
+	INT64_MUL,
+	// Pops the top two 64-bit ints on the stack, divides them (left to right), and pushes the result
+	INT64_DIV,
+	// Pops the top two 64-bit ints on the stack, % them (left to right), and pushes the result
+	INT64_MOD,
+	// Pops the top two doubles on the stack, adds them, and pushes the result
+	DOUBLE_ADD,
+	// Pops the top two doubles on the stack, subtracts them (left to right), and pushes the result
+	DOUBLE_SUB,
+	// Pops the top two doubles on the stack, multiplies them, and pushes the result
+	DOUBLE_MUL,
+	// Pops the top two doubles on the stack, divides them (left to right), and pushes the result
+	DOUBLE_DIV,
+	// Pops the top int on the stack, casts to a 64-bit int, and pushes the result
+	INT_TO_INT64,
+	// Pops the top int on the stack, casts to double, and pushes the double
+	INT_TO_DOUBLE,
+	// Pops the top float on the stack, casts to a 64-bit int, and pushes the result
+	FLOAT_TO_INT64,
+	// Pops the top float on the stack, casts to double, and pushes the double
+	FLOAT_TO_DOUBLE,
+	// Pops the top 64-bit int on the stack, casts to int, and pushes the int
+	INT64_TO_INT,
+	// Pops the top 64-bit int on the stack, casts to float, and pushes the float
+	INT64_TO_FLOAT,
+	// Pops the top 64-bit int on the stack, casts to double, and pushes the double
+	INT64_TO_DOUBLE,
+	// Pops the top double on the stack, casts to int, and pushes the int
+	DOUBLE_TO_INT,
+	// Pops the top double on the stack, casts to float, and pushes the float
+	DOUBLE_TO_FLOAT,
+	// Pops the top double on the stack, casts to a 64-bit int, and pushes the result
+	DOUBLE_TO_INT64,
+	// Pops floats off the stack and pushes a vector made from them, the first float pushed is the first lane
+	// Following 1 byte is the number of lanes, unused lanes are zeroed
+	VEC_MAKE,
+	// Pops a float off the stack and pushes a vector with it in every lane
+	// Following 1 byte is the number of lanes, unused lanes are zeroed
+	VEC_SPLAT,
+	// Pops the vector on top of the stack and stores it to a variable slot in the current frame
+	// Following 1 byte is the first of the four variable slots to store to
+	VEC_STORE,
+	// Loads a vector from a variable slot in the current frame and pushes the value to the stack
+	// Following 1 byte is the first of the four variable slots to load from
+	VEC_LOAD,
+	// Pops the top two vectors on the stack, adds them lane by lane, and pushes the result
+	VEC_ADD,
+	// Pops the top two vectors on the stack, subtracts them lane by lane (left to right), and pushes the result
+	VEC_SUB,
+	// Pops the top two vectors on the stack, multiplies them lane by lane, and pushes the result
+	VEC_MUL,
+	// Pops the top two vectors on the stack, divides them lane by lane (left to right), and pushes the result
+	VEC_DIV,
+	// Pops the top two vectors on the stack and pushes their dot product as a float
+	// Following 1 byte is the number of lanes
+	VEC_DOT,
+	// Pops the top two vec3s on the stack and pushes their cross product (left to right)
+	VEC_CROSS,
+	// Pops the vector on top of the stack and pushes its length as a float
+	// Following 1 byte is the number of lanes
+	VEC_LENGTH,
+	// Pops the vector on top of the stack and pushes it scaled to a length of 1
+	// Following 1 byte is the number of lanes
+	VEC_NORMALIZE,
+	// Pops the vector on top of the stack and pushes one of its lanes as a float
+	// Following 1 byte is the lane
+	VEC_EXTRACT,
+	// Pops the top float on the stack and pushes its square root
+	FLOAT_SQRT,
+	// Pops the top float on the stack and pushes its absolute value
+	FLOAT_ABS,
+	// Pops the top float on the stack and pushes the largest whole number not greater than it
+	FLOAT_FLOOR,
+	// Pops the top float on the stack and pushes its sine (radians)
+	FLOAT_SIN,
+	// Pops the top float on the stack and pushes its cosine (radians)
+	FLOAT_COS,
+	// Pops the top two floats on the stack and pushes the smaller
+	FLOAT_MINIMUM,
+	// Pops the top two floats on the stack and pushes the larger
+	FLOAT_MAXIMUM,
+	// Pops a float, a lower bound and an upper bound (pushed in that order) and pushes the float clamped between them
+	FLOAT_CLAMP,
+	// Pops the top int on the stack and pushes its absolute value
+	INT_ABS,
+	// Pops the top two ints on the stack and pushes the smaller
+	INT_MINIMUM,
+	// Pops the top two ints on the stack and pushes the larger
+	INT_MAXIMUM,
+	// Pops an int, a lower bound and an upper bound (pushed in that order) and pushes the int clamped between them
+	INT_CLAMP,
+	// Calls a registered native function, which pops its arguments and pushes its return value
+	// Following 2 bytes are the index of the function in the native registry
+	CALL_NATIVE,
+	// Pops a native object pointer, reads the 4 byte field at a constant offset into the object, and pushes it
+	// Following 2 bytes are the byte offset of the field
+	FIELD_LOAD,
+	// Pops a native object pointer, then the 4 byte value under it, and writes the value to the field
+	// Following 2 bytes are the byte offset of the field
+	FIELD_STORE,
+	// Same as FIELD_LOAD for an 8 byte field
+	// Following 2 bytes are the byte offset of the field
+	FIELD_LOAD_64,
+	// Same as FIELD_STORE for an 8 byte field
+	// Following 2 bytes are the byte offset of the field
+	FIELD_STORE_64,
+	// Reads the 4 byte global at a constant offset into the instance's globals block and pushes it
+	// Following 2 bytes are the byte offset of the global
+	GLOBAL_LOAD,
+	// Pops the 4 byte value on top of the stack and writes it to a global
+	// Following 2 bytes are the byte offset of the global
+	GLOBAL_STORE,
+	// Same as GLOBAL_LOAD for an 8 byte global
+	// Following 2 bytes are the byte offset of the global
+	GLOBAL_LOAD_64,
+	// Same as GLOBAL_STORE for an 8 byte global
+	// Following 2 bytes are the byte offset of the global
+	GLOBAL_STORE_64,
+	// Same as GLOBAL_LOAD for a vector global
+	// Following 2 bytes are the byte offset of the global
+	GLOBAL_LOAD_VEC,
+	// Same as GLOBAL_STORE for a vector global
+	// Following 2 bytes are the byte offset of the global
+	GLOBAL_STORE_VEC,
+	// Pushes a string constant from the script's constant pool onto the stack
+	// Following 2 bytes are the index of the string in the pool
+	STRING_CONST_POOL,
+	// Pops the top two strings on the stack and pushes them joined (left to right)
+	// A result too long to be inline goes in the call's temporaries
+	STRING_CONCAT,
+	// Same as GLOBAL_STORE_VEC for a string global, a long string is copied into the global's buffer in the
+	// instance's string store so it outlives the call, replacing what the global held
+	// Following 2 bytes are the byte offset of the global
+	GLOBAL_STORE_STRING,
+	// Pops a value and appends its text to the line the VM is printing
+	// Following byte is the type ID of the value, one of the built-in types
+	PRINT,
+	// Hands the line the VM is printing to the print sink and starts a new one
+	PRINT_END,
+	// Jumps by a signed displacement, counted from the end of the instruction
+	// Following 1 byte is the displacement
+	JMP_8,
+	// Same as JMP_8 with a longer reach
+	// Following 4 bytes are the displacement
+	JMP,
+	// Pops the top two ints on the stack, and jumps if they're equal
+	// Following 1 byte is the signed displacement, counted from the end of the instruction
+	INT_EQ_JMP_8,
+	// Same as INT_EQ_JMP_8 with a longer reach
+	// Following 4 bytes are the displacement
+	INT_EQ_JMP,
+	// Pops the top two ints on the stack, and jumps if they're not equal
+	// Following 1 byte is the signed displacement, counted from the end of the instruction
+	INT_NE_JMP_8,
+	// Same as INT_NE_JMP_8 with a longer reach
+	// Following 4 bytes are the displacement
+	INT_NE_JMP,
+	// Pops the top two ints on the stack, and jumps if the left one is less than the right one
+	// Following 1 byte is the signed displacement, counted from the end of the instruction
+	INT_LT_JMP_8,
+	// Same as INT_LT_JMP_8 with a longer reach
+	// Following 4 bytes are the displacement
+	INT_LT_JMP,
+	// Pops the top two ints on the stack, and jumps if the left one is less than or equal to the right one
+	// Following 1 byte is the signed displacement, counted from the end of the instruction
+	INT_LE_JMP_8,
+	// Same as INT_LE_JMP_8 with a longer reach
+	// Following 4 bytes are the displacement
+	INT_LE_JMP,
+	// Pops the top two ints on the stack, and jumps if the left one is greater than the right one
+	// Following 1 byte is the signed displacement, counted from the end of the instruction
+	INT_GT_JMP_8,
+	// Same as INT_GT_JMP_8 with a longer reach
+	// Following 4 bytes are the displacement
+	INT_GT_JMP,
+	// Pops the top two ints on the stack, and jumps if the left one is greater than or equal to the right one
+	// Following 1 byte is the signed displacement, counted from the end of the instruction
+	INT_GE_JMP_8,
+	// Same as INT_GE_JMP_8 with a longer reach
+	// Following 4 bytes are the displacement
+	INT_GE_JMP,
+	// Pops the top two floats on the stack and pushes -1, 0 or 1 as the left one is less, equal or greater
+	// Pushes -1 if either is NaN, so > and >= come out false
+	FLOAT_CMPL,
+	// Same as FLOAT_CMPL but pushes 1 if either is NaN, so < and <= come out false
+	FLOAT_CMPG,
+	// Pops the top two 64-bit ints on the stack and pushes -1, 0 or 1 as the left one is less, equal or greater
+	INT64_CMP,
+	// Same as FLOAT_CMPL for doubles
+	DOUBLE_CMPL,
+	// Same as FLOAT_CMPG for doubles
+	DOUBLE_CMPG,
+	// Pops the top two strings on the stack and pushes 0 if they're equal, 1 if not
+	STRING_CMP,
+	// Ends the call, a return value is left on top of the stack
+	RETURN,
+	// Pops an int and jumps by the entry of a table indexed by the int minus the table's low value,
+	// or by the default displacement if the int is outside the table
+	// Following 2 bytes are the number of entries, 4 bytes the default displacement, 4 bytes the low value,
+	// then 4 bytes per entry. Displacements count from the end of the table
+	TABLE_SWITCH,
+	// Pops an int and binary searches a list of keys for it, jumping by the displacement next to the
+	// matching key, or by the default displacement if there's no match
+	// Following 2 bytes are the number of keys, 4 bytes the default displacement, then 8 bytes per key,
+	// the key and its displacement, in ascending order of keys. Displacements count from the end of the list
+	LOOKUP_SWITCH,
+	// Pops a number and pushes its text, the same text PRINT gives it
+	// A result too long to be inline goes in the call's temporaries
+	// Following byte is the type ID of the number, int32, float, int64 or double
+	NUMBER_TO_STRING,
 	// Invalid instruction, used to denote compilation failures
 	INVALID_INSTRUCTION,
 	// Number of instructions total
 	INSTRUCTION_COUNT
 };
 
-inline SGLInstruction get_cast_instruction(SGLType from, SGLType to)
+/**
+ * Layout of the operand bytes that follow an instruction
+ * Used by anything that has to walk bytecode without running it, such as the loader
+ */
+enum class SGLOperand : std::uint8_t
+{
+	// No operand
+	NONE,
+	// 1 byte value
+	BYTE,
+	// 2 byte value
+	SHORT,
+	// 4 byte value
+	WORD,
+	// 8 byte value
+	LONG,
+	// 2 byte constant pool index
+	POOL_INDEX,
+	// 2 byte native function index
+	NATIVE_INDEX,
+	// 2 byte string constant index, strings are indexed apart from numeric constants
+	STRING_INDEX,
+	// 1 byte instruction followed by a 2 byte slot (WIDE only)
+	WIDE_SLOT,
+	// 2 byte entry count, 4 byte default displacement and 4 byte low value, followed by the table (TABLE_SWITCH only)
+	SWITCH_TABLE,
+	// 2 byte key count and 4 byte default displacement, followed by the keys (LOOKUP_SWITCH only)
+	SWITCH_LOOKUP,
+};
+
+/**
+ * Returns the layout of the operands that follow the instruction
+ */
+inline SGLOperand get_operand_layout(SGLInstruction instruction)
+{
+	switch (instruction)
+	{
+		case INT_CONST:
+		case FLOAT_CONST:
+		case JMP:
+		case INT_EQ_JMP:
+		case INT_NE_JMP:
+		case INT_LT_JMP:
+		case INT_LE_JMP:
+		case INT_GT_JMP:
+		case INT_GE_JMP:
+			return SGLOperand::WORD;
+		case INT64_CONST:
+		case DOUBLE_CONST:
+			return SGLOperand::LONG;
+		case INT_CONST_8:
+		case INT_STORE:
+		case INT_LOAD:
+		case FLOAT_STORE:
+		case FLOAT_LOAD:
+		case INT64_STORE:
+		case INT64_LOAD:
+		case DOUBLE_STORE:
+		case DOUBLE_LOAD:
+		case VEC_MAKE:
+		case VEC_SPLAT:
+		case VEC_STORE:
+		case VEC_LOAD:
+		case VEC_DOT:
+		case VEC_LENGTH:
+		case VEC_NORMALIZE:
+		case VEC_EXTRACT:
+		case PRINT:
+		case NUMBER_TO_STRING:
+		case JMP_8:
+		case INT_EQ_JMP_8:
+		case INT_NE_JMP_8:
+		case INT_LT_JMP_8:
+		case INT_LE_JMP_8:
+		case INT_GT_JMP_8:
+		case INT_GE_JMP_8:
+			return SGLOperand::BYTE;
+		case INT_CONST_16:
+		case FIELD_LOAD:
+		case FIELD_STORE:
+		case FIELD_LOAD_64:
+		case FIELD_STORE_64:
+		case GLOBAL_LOAD:
+		case GLOBAL_STORE:
+		case GLOBAL_LOAD_64:
+		case GLOBAL_STORE_64:
+		case GLOBAL_LOAD_VEC:
+		case GLOBAL_STORE_VEC:
+		case GLOBAL_STORE_STRING:
+			return SGLOperand::SHORT;
+		case INT_CONST_POOL:
+		case FLOAT_CONST_POOL:
+			return SGLOperand::POOL_INDEX;
+		case STRING_CONST_POOL:
+			return SGLOperand::STRING_INDEX;
+		case WIDE:
+			return SGLOperand::WIDE_SLOT;
+		case CALL_NATIVE:
+			return SGLOperand::NATIVE_INDEX;
+		case TABLE_SWITCH:
+			return SGLOperand::SWITCH_TABLE;
+		case LOOKUP_SWITCH:
+			return SGLOperand::SWITCH_LOOKUP;
+		default:
+			return SGLOperand::NONE;
+	}
+}
+
+/**
+ * Returns the number of operand bytes that follow the instruction
+ * Switches have a table after these, see get_switch_table_size
+ */
+inline std::size_t get_operand_size(SGLOperand layout)
+{
+	switch (layout)
+	{
+		case SGLOperand::BYTE:
+			return 1;
+		case SGLOperand::SHORT:
+		case SGLOperand::POOL_INDEX:
+		case SGLOperand::NATIVE_INDEX:
+		case SGLOperand::STRING_INDEX:
+			return 2;
+		case SGLOperand::WORD:
+			return 4;
+		case SGLOperand::LONG:
+			return 8;
+		case SGLOperand::WIDE_SLOT:
+			return 3;
+		case SGLOperand::SWITCH_TABLE:
+			return 10;
+		case SGLOperand::SWITCH_LOOKUP:
+			return 6;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * Returns the number of bytes in the table that follows a switch's operands, 'caseCount' is its first operand
+ */
+inline std::size_t get_switch_table_size(SGLOperand layout, std::uint16_t caseCount)
+{
+	return caseCount * (layout == SGLOperand::SWITCH_LOOKUP ? 2 * sizeof(std::int32_t) : sizeof(std::int32_t));
+}
+
+/**
+ * Cast instructions indexed by [from][to] type ID
+ * Only built-in types have casts, INVALID_INSTRUCTION means no cast exists
+ * Scalars become vectors with VEC_SPLAT, which takes an operand and so isn't in the table
+ */
+constexpr SGLInstruction CAST_TABLE[SGL_BUILTIN_TYPE_COUNT][SGL_BUILTIN_TYPE_COUNT] =
+{
+	//				-> int32				-> float				-> int64				-> double				-> vec2					-> vec3					-> vec4					-> string				-> void
+	/* int32  */ {	INVALID_INSTRUCTION,	INT_TO_FLOAT,			INT_TO_INT64,			INT_TO_DOUBLE,			INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+	/* float  */ {	FLOAT_TO_INT,			INVALID_INSTRUCTION,	FLOAT_TO_INT64,			FLOAT_TO_DOUBLE,		INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+	/* int64  */ {	INT64_TO_INT,			INT64_TO_FLOAT,			INVALID_INSTRUCTION,	INT64_TO_DOUBLE,		INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+	/* double */ {	DOUBLE_TO_INT,			DOUBLE_TO_FLOAT,		DOUBLE_TO_INT64,		INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+	/* vec2   */ {	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+	/* vec3   */ {	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+	/* vec4   */ {	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+	/* string */ {	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+	/* void   */ {	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+};
+
+/**
+ * Returns the instruction that casts a value of type 'from' to type 'to'
+ * Returns INVALID_INSTRUCTION if there's no such cast
+ */
+inline SGLInstruction get_cast_instruction(SGLTypeId from, SGLTypeId to)
+{
+	if (from >= SGL_BUILTIN_TYPE_COUNT || to >= SGL_BUILTIN_TYPE_COUNT)
+	{
+		return INVALID_INSTRUCTION;
+	}
+
+	return CAST_TABLE[from][to];
+}
+
+inline SGLInstruction get_cast_instruction(const SGLType& from, const SGLType& to)
+{
+	return get_cast_instruction(from.TypeId, to.TypeId);
+}
+
+/**
+ * Arithmetic operations, used as the column index of the arithmetic table
+ */
+enum SGLArithmetic : std::uint8_t
+{
+	ARITH_ADD,
+	ARITH_SUB,
+	ARITH_MUL,
+	ARITH_DIV,
+	ARITH_MOD,
+	ARITH_COUNT
+};
+
+/**
+ * Arithmetic instructions indexed by [operand type ID][operation]
+ * INVALID_INSTRUCTION means the type doesn't support the operation
+ */
+constexpr SGLInstruction ARITHMETIC_TABLE[SGL_BUILTIN_TYPE_COUNT][ARITH_COUNT] =
+{
+	//				+						-						*						/						%
+	/* int32  */ {	INT_ADD,				INT_SUB,				INT_MUL,				INT_DIV,				INT_MOD },
+	/* float  */ {	FLOAT_ADD,				FLOAT_SUB,				FLOAT_MUL,				FLOAT_DIV,				INVALID_INSTRUCTION },
+	/* int64  */ {	INT64_ADD,				INT64_SUB,				INT64_MUL,				INT64_DIV,				INT64_MOD },
+	/* double */ {	DOUBLE_ADD,				DOUBLE_SUB,				DOUBLE_MUL,				DOUBLE_DIV,				INVALID_INSTRUCTION },
+	/* vec2   */ {	VEC_ADD,				VEC_SUB,				VEC_MUL,				VEC_DIV,				INVALID_INSTRUCTION },
+	/* vec3   */ {	VEC_ADD,				VEC_SUB,				VEC_MUL,				VEC_DIV,				INVALID_INSTRUCTION },
+	/* vec4   */ {	VEC_ADD,				VEC_SUB,				VEC_MUL,				VEC_DIV,				INVALID_INSTRUCTION },
+	/* string */ {	STRING_CONCAT,			INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+	/* void   */ {	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION,	INVALID_INSTRUCTION },
+};
+
+/**
+ * Returns the instruction that performs the operation on two operands of the given type
+ * Returns INVALID_INSTRUCTION if there's no such instruction
+ */
+inline SGLInstruction get_arithmetic_instruction(SGLTypeId type, SGLArithmetic op)
+{
+	if (type >= SGL_BUILTIN_TYPE_COUNT)
+	{
+		return INVALID_INSTRUCTION;
+	}
+
+	return ARITHMETIC_TABLE[type][op];
+}
+
+/**
+ * Comparisons, used as the index of the comparison tables
+ */
+enum SGLComparison : std::uint8_t
+{
+	CMP_EQ,
+	CMP_NE,
+	CMP_LT,
+	CMP_LE,
+	CMP_GT,
+	CMP_GE,
+	CMP_COUNT
+};
+
+// Fused compare-and-branch of two ints for each comparison, in the long form
+constexpr SGLInstruction JUMP_TABLE[CMP_COUNT] = { INT_EQ_JMP, INT_NE_JMP, INT_LT_JMP, INT_LE_JMP, INT_GT_JMP, INT_GE_JMP };
+
+// Comparison that's true exactly when the one at the same index is false, for ints
+constexpr SGLComparison INVERSE_TABLE[CMP_COUNT] = { CMP_NE, CMP_EQ, CMP_GE, CMP_GT, CMP_LE, CMP_LT };
+
+/**
+ * Returns the instruction that reduces two operands of the given type to an int compared against 0,
+ * -1, 0 or 1 as the left one is less, equal or greater
+ * Floating types pick the NaN result that makes the comparison come out false, so branching on the
+ * inverse of the int comparison is still right when either side is NaN
+ * Returns INT_CONST_0 for int32, which branches on its operands directly, and INVALID_INSTRUCTION
+ * if the type can't be compared that way
+ */
+inline SGLInstruction get_compare_instruction(SGLTypeId type, SGLComparison comparison)
 {
-	if (from.TypeName == "int32")
+	bool isGreater = comparison == CMP_GT || comparison == CMP_GE;
+	switch (type)
 	{
-		// INT_TO_*
-		if (to.TypeName == "float")
-		{
-			return INT_TO_FLOAT;
-		}
-		else
-		{
+		case SGL_TYPE_INT32:
+			return INT_CONST_0;
+		case SGL_TYPE_FLOAT:
+			return isGreater ? FLOAT_CMPL : FLOAT_CMPG;
+		case SGL_TYPE_INT64:
+			return INT64_CMP;
+		case SGL_TYPE_DOUBLE:
+			return isGreater ? DOUBLE_CMPL : DOUBLE_CMPG;
+		case SGL_TYPE_STRING:
+			return comparison == CMP_EQ || comparison == CMP_NE ? STRING_CMP : INVALID_INSTRUCTION;
+		default:
 			return INVALID_INSTRUCTION;
-		}
 	}
-	else if (from.TypeName == "float")
+}
+
+/**
+ * Returns true for the instructions that jump, in either form
+ */
+inline bool is_jump_instruction(SGLInstruction instruction)
+{
+	return instruction >= JMP_8 && instruction <= INT_GE_JMP;
+}
+
+/**
+ * Returns the 8-bit displacement form of a jump, every jump's short form comes right before its long one
+ */
+inline SGLInstruction get_short_jump_instruction(SGLInstruction instruction)
+{
+	return static_cast<SGLInstruction>(instruction - 1);
+}
+
+/**
+ * Variable slot instructions indexed by type ID
+ * Strings are 16 bytes like vectors, so they're moved by the same instructions
+ */
+constexpr SGLInstruction LOAD_TABLE[SGL_BUILTIN_TYPE_COUNT] = { INT_LOAD, FLOAT_LOAD, INT64_LOAD, DOUBLE_LOAD, VEC_LOAD, VEC_LOAD, VEC_LOAD, VEC_LOAD, INVALID_INSTRUCTION };
+constexpr SGLInstruction STORE_TABLE[SGL_BUILTIN_TYPE_COUNT] = { INT_STORE, FLOAT_STORE, INT64_STORE, DOUBLE_STORE, VEC_STORE, VEC_STORE, VEC_STORE, VEC_STORE, INVALID_INSTRUCTION };
+
+/**
+ * Returns the instruction that loads a variable of the given type
+ * Returns INVALID_INSTRUCTION if variables of the type can't be loaded
+ */
+inline SGLInstruction get_load_instruction(SGLTypeId type)
+{
+	if (type >= SGL_BUILTIN_TYPE_COUNT)
 	{
-		// FLOAT_TO_*
-		if (to.TypeName == "int32")
-		{
-			return FLOAT_TO_INT;
-		}
-		else
-		{
+		// a native object variable holds an 8 byte pointer
+		return get_type(type).IsNativeObject ? INT64_LOAD : INVALID_INSTRUCTION;
+	}
+
+	return LOAD_TABLE[type];
+}
+
+/**
+ * Returns the instruction that stores a variable of the given type
+ * Returns INVALID_INSTRUCTION if variables of the type can't be stored
+ */
+inline SGLInstruction get_store_instruction(SGLTypeId type)
+{
+	if (type >= SGL_BUILTIN_TYPE_COUNT)
+	{
+		return get_type(type).IsNativeObject ? INT64_STORE : INVALID_INSTRUCTION;
+	}
+
+	return STORE_TABLE[type];
+}
+
+/**
+ * Returns the instruction that reads a native object's field of the given type
+ * Only the width matters since the bits are copied as they are
+ */
+inline SGLInstruction get_field_load_instruction(SGLTypeId type)
+{
+	return get_type(type).TypeSize == 8 ? FIELD_LOAD_64 : FIELD_LOAD;
+}
+
+/**
+ * Returns the instruction that writes a native object's field of the given type
+ */
+inline SGLInstruction get_field_store_instruction(SGLTypeId type)
+{
+	return get_type(type).TypeSize == 8 ? FIELD_STORE_64 : FIELD_STORE;
+}
+
+/**
+ * Returns the instruction that reads a global of the given type
+ * Like fields, globals are moved by width, so the type only picks the size
+ * Returns INVALID_INSTRUCTION if globals of the type aren't supported
+ */
+inline SGLInstruction get_global_load_instruction(SGLTypeId type)
+{
+	switch (get_type(type).get_value_size())
+	{
+		case 4:
+			return GLOBAL_LOAD;
+		case 8:
+			return GLOBAL_LOAD_64;
+		case 16:
+			return GLOBAL_LOAD_VEC;
+		default:
 			return INVALID_INSTRUCTION;
-		}
 	}
-	else
+}
+
+/**
+ * Returns the instruction that writes a global of the given type
+ * Returns INVALID_INSTRUCTION if globals of the type aren't supported
+ */
+inline SGLInstruction get_global_store_instruction(SGLTypeId type)
+{
+	if (type == SGL_TYPE_STRING)
 	{
-		return INVALID_INSTRUCTION;
+		return GLOBAL_STORE_STRING;
+	}
+
+	switch (get_type(type).get_value_size())
+	{
+		case 4:
+			return GLOBAL_STORE;
+		case 8:
+			return GLOBAL_STORE_64;
+		case 16:
+			return GLOBAL_STORE_VEC;
+		default:
+			return INVALID_INSTRUCTION;
+	}
+}
+
+/**
+ * Returns the number of frame slots a load or store touches, starting at its slot operand
+ * Returns 0 for instructions that don't have a slot operand
+ */
+inline std::size_t get_slot_count(SGLInstruction instruction)
+{
+	switch (instruction)
+	{
+		case INT_STORE:
+		case INT_LOAD:
+		case FLOAT_STORE:
+		case FLOAT_LOAD:
+			return 1;
+		case INT64_STORE:
+		case INT64_LOAD:
+		case DOUBLE_STORE:
+		case DOUBLE_LOAD:
+			return 2;
+		case VEC_STORE:
+		case VEC_LOAD:
+			return 4;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * Returns the number of bytes a global load or store touches, starting at its offset operand
+ * Returns 0 for instructions that don't access globals
+ */
+inline std::size_t get_global_access_size(SGLInstruction instruction)
+{
+	switch (instruction)
+	{
+		case GLOBAL_LOAD:
+		case GLOBAL_STORE:
+			return 4;
+		case GLOBAL_LOAD_64:
+		case GLOBAL_STORE_64:
+			return 8;
+		case GLOBAL_LOAD_VEC:
+		case GLOBAL_STORE_VEC:
+		case GLOBAL_STORE_STRING:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * Returns the number of bytes the instruction leaves on the stack, minus what it pops
+ * Vectors take 16 bytes on the stack whatever their lane count
+ * 'operand' is the byte operand of instructions that need it, VEC_MAKE's lane count or PRINT's and NUMBER_TO_STRING's type
+ * A WIDE instruction has the effect of the instruction it widens
+ * CALL_NATIVE depends on the native's signature, so it's left to the caller and counts as 0 here
+ * RETURN ends the call, whatever it leaves on the stack is never seen by the code after it
+ */
+inline int get_stack_effect(SGLInstruction instruction, std::uint8_t operand = 0)
+{
+	switch (instruction)
+	{
+		case INT_CONST:
+		case INT_CONST_0:
+		case INT_CONST_1:
+		case INT_CONST_8:
+		case INT_CONST_16:
+		case INT_CONST_POOL:
+		case FLOAT_CONST_POOL:
+		case FLOAT_CONST:
+		case INT_LOAD:
+		case FLOAT_LOAD:
+		case GLOBAL_LOAD:
+		case INT_TO_INT64:
+		case INT_TO_DOUBLE:
+		case FLOAT_TO_INT64:
+		case FLOAT_TO_DOUBLE:
+			return 4;
+		case INT64_CONST:
+		case INT64_CONST_0:
+		case DOUBLE_CONST:
+		case INT64_LOAD:
+		case DOUBLE_LOAD:
+		case GLOBAL_LOAD_64:
+			return 8;
+		case VEC_SPLAT:
+			return 12;
+		case VEC_LOAD:
+		case GLOBAL_LOAD_VEC:
+		case STRING_CONST_POOL:
+			return 16;
+		case VEC_MAKE:
+			return 16 - 4 * operand;
+		case INT_STORE:
+		case FLOAT_STORE:
+		case GLOBAL_STORE:
+		case INT_ADD:
+		case INT_SUB:
+		case INT_MUL:
+		case INT_DIV:
+		case INT_MOD:
+		case FLOAT_ADD:
+		case FLOAT_SUB:
+		case FLOAT_MUL:
+		case FLOAT_DIV:
+		case FLOAT_MINIMUM:
+		case FLOAT_MAXIMUM:
+		case INT_MINIMUM:
+		case INT_MAXIMUM:
+		case INT64_TO_INT:
+		case INT64_TO_FLOAT:
+		case DOUBLE_TO_INT:
+		case DOUBLE_TO_FLOAT:
+		case FIELD_LOAD:
+		case FLOAT_CMPL:
+		case FLOAT_CMPG:
+		case TABLE_SWITCH:
+		case LOOKUP_SWITCH:
+			return -4;
+		case INT64_STORE:
+		case DOUBLE_STORE:
+		case GLOBAL_STORE_64:
+		case INT64_ADD:
+		case INT64_SUB:
+		case INT64_MUL:
+		case INT64_DIV:
+		case INT64_MOD:
+		case DOUBLE_ADD:
+		case DOUBLE_SUB:
+		case DOUBLE_MUL:
+		case DOUBLE_DIV:
+		case FLOAT_CLAMP:
+		case INT_CLAMP:
+		case INT_EQ_JMP_8:
+		case INT_EQ_JMP:
+		case INT_NE_JMP_8:
+		case INT_NE_JMP:
+		case INT_LT_JMP_8:
+		case INT_LT_JMP:
+		case INT_LE_JMP_8:
+		case INT_LE_JMP:
+		case INT_GT_JMP_8:
+		case INT_GT_JMP:
+		case INT_GE_JMP_8:
+		case INT_GE_JMP:
+			return -8;
+		case FIELD_STORE:
+		case VEC_LENGTH:
+		case VEC_EXTRACT:
+		case INT64_CMP:
+		case DOUBLE_CMPL:
+		case DOUBLE_CMPG:
+			return -12;
+		case VEC_STORE:
+		case GLOBAL_STORE_VEC:
+		case VEC_ADD:
+		case VEC_SUB:
+		case VEC_MUL:
+		case VEC_DIV:
+		case VEC_CROSS:
+		case FIELD_STORE_64:
+		case STRING_CONCAT:
+		case GLOBAL_STORE_STRING:
+			return -16;
+		case VEC_DOT:
+		case STRING_CMP:
+			return -28;
+		case PRINT:
+			return -get_type(operand).get_value_size();
+		case NUMBER_TO_STRING:
+			return get_type(SGL_TYPE_STRING).get_value_size() - get_type(operand).get_value_size();
+		default:
+			return 0;
+	}
+}
+
+/**
+ * Returns the number of bytes the instruction pops before it pushes anything, which have to be on the stack for it to run
+ * What it pushes is this plus get_stack_effect, and the same operand and WIDE rules apply
+ * CALL_NATIVE pops its native's arguments, so it's left to the caller and counts as 0 here
+ * RETURN's value is checked against the function's return type, so it counts as 0 here too
+ */
+inline std::size_t get_stack_pops(SGLInstruction instruction, std::uint8_t operand = 0)
+{
+	switch (instruction)
+	{
+		case INT_STORE:
+		case FLOAT_STORE:
+		case GLOBAL_STORE:
+		case INT_TO_FLOAT:
+		case FLOAT_TO_INT:
+		case INT_TO_INT64:
+		case INT_TO_DOUBLE:
+		case FLOAT_TO_INT64:
+		case FLOAT_TO_DOUBLE:
+		case VEC_SPLAT:
+		case FLOAT_SQRT:
+		case FLOAT_ABS:
+		case FLOAT_FLOOR:
+		case FLOAT_SIN:
+		case FLOAT_COS:
+		case INT_ABS:
+		case TABLE_SWITCH:
+		case LOOKUP_SWITCH:
+			return 4;
+		case INT64_STORE:
+		case DOUBLE_STORE:
+		case GLOBAL_STORE_64:
+		case INT_ADD:
+		case INT_SUB:
+		case INT_MUL:
+		case INT_DIV:
+		case INT_MOD:
+		case FLOAT_ADD:
+		case FLOAT_SUB:
+		case FLOAT_MUL:
+		case FLOAT_DIV:
+		case FLOAT_MINIMUM:
+		case FLOAT_MAXIMUM:
+		case INT_MINIMUM:
+		case INT_MAXIMUM:
+		case INT64_TO_INT:
+		case INT64_TO_FLOAT:
+		case INT64_TO_DOUBLE:
+		case DOUBLE_TO_INT:
+		case DOUBLE_TO_FLOAT:
+		case DOUBLE_TO_INT64:
+		case FIELD_LOAD:
+		case FIELD_LOAD_64:
+		case FLOAT_CMPL:
+		case FLOAT_CMPG:
+		case INT_EQ_JMP_8:
+		case INT_EQ_JMP:
+		case INT_NE_JMP_8:
+		case INT_NE_JMP:
+		case INT_LT_JMP_8:
+		case INT_LT_JMP:
+		case INT_LE_JMP_8:
+		case INT_LE_JMP:
+		case INT_GT_JMP_8:
+		case INT_GT_JMP:
+		case INT_GE_JMP_8:
+		case INT_GE_JMP:
+			return 8;
+		case FLOAT_CLAMP:
+		case INT_CLAMP:
+		case FIELD_STORE:
+			return 12;
+		case INT64_ADD:
+		case INT64_SUB:
+		case INT64_MUL:
+		case INT64_DIV:
+		case INT64_MOD:
+		case DOUBLE_ADD:
+		case DOUBLE_SUB:
+		case DOUBLE_MUL:
+		case DOUBLE_DIV:
+		case INT64_CMP:
+		case DOUBLE_CMPL:
+		case DOUBLE_CMPG:
+		case VEC_STORE:
+		case GLOBAL_STORE_VEC:
+		case GLOBAL_STORE_STRING:
+		case VEC_LENGTH:
+		case VEC_NORMALIZE:
+		case VEC_EXTRACT:
+		case FIELD_STORE_64:
+			return 16;
+		case VEC_ADD:
+		case VEC_SUB:
+		case VEC_MUL:
+		case VEC_DIV:
+		case VEC_DOT:
+		case VEC_CROSS:
+		case STRING_CONCAT:
+		case STRING_CMP:
+			return 32;
+		case VEC_MAKE:
+			return 4 * operand;
+		case PRINT:
+		case NUMBER_TO_STRING:
+			return get_type(operand).get_value_size();
+		default:
+			return 0;
 	}
 }
\ No newline at end of file
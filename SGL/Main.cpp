@@ -1,22 +1,104 @@
 // SGL (Simple Game Language) Compiler
 
+#include <chrono>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
 #include <sstream>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
 
 #include "SGLTypes.h"
 #include "Compiler_Old.h"
+#include "Script.h"
+#include "ScriptInstance.h"
+#include "SGLString.h"
+#include "StateRegion.h"
 #include "VirtualMachine.h"
+#include "VMPool.h"
 #include "Instructions.h"
 #include "Helpers.h"
+#include "NativeFunctions.h"
 
 #include "Compiler.h"
 
 auto testScript = 
 "func: GetHeadshotMultiplier() -> float { return 2.0F; }\n\nfunc: ExecuteAction(float in) -> void\n{\n\tfloat out = in * GetHeadshotMultiplier();\n\tprint(\"Total damage out: \" + out);\n}";
 
+// VM, script and remaining depth for the recursion in the stack benchmark
+VirtualMachine* g_recursionVM = nullptr;
+const Script* g_recursionScript = nullptr;
+int g_recursionLeft = 0;
+
+/**
+ * Native that calls back into the script that called it until the benchmark's depth runs out
+ */
+std::int32_t recurse_into_script(std::int32_t depth)
+{
+	if (--g_recursionLeft > 0)
+	{
+		g_recursionVM->execute_function(*g_recursionScript, "Deep");
+	}
+	return depth + 1;
+}
+
+/**
+ * Returns a copy of compiled code with every short jump in its long form, for the jump benchmark
+ * With 'unfuse' every compare-and-branch first subtracts its operands and compares the difference
+ * against 0, the way a branch would without the fused instructions
+ */
+std::vector<std::uint8_t> widen_jumps(const std::vector<std::uint8_t>& code, bool unfuse)
+{
+	// where each instruction starts in the code, and where it ends up once the jumps before it grow
+	std::vector<std::size_t> starts;
+	std::unordered_map<std::size_t, std::size_t> moved;
+	std::size_t grown = 0;
+	for (std::size_t pos = 0; pos < code.size();)
+	{
+		SGLInstruction instruction = static_cast<SGLInstruction>(code[pos]);
+		SGLOperand layout = get_operand_layout(instruction);
+		starts.push_back(pos);
+		moved[pos] = pos + grown;
+		if (is_jump_instruction(instruction))
+		{
+			bool isFused = instruction != JMP_8 && instruction != JMP;
+			grown += (layout == SGLOperand::BYTE ? 3 : 0) + (unfuse && isFused ? 2 : 0);
+		}
+		pos += 1 + get_operand_size(layout);
+	}
+	moved[code.size()] = code.size() + grown;
+
+	std::vector<std::uint8_t> widened;
+	for (std::size_t pos : starts)
+	{
+		SGLInstruction instruction = static_cast<SGLInstruction>(code[pos]);
+		SGLOperand layout = get_operand_layout(instruction);
+		std::size_t length = 1 + get_operand_size(layout);
+		if (!is_jump_instruction(instruction))
+		{
+			widened.insert(widened.end(), code.begin() + pos, code.begin() + pos + length);
+			continue;
+		}
+
+		bool isShort = layout == SGLOperand::BYTE;
+		std::int32_t displacement = isShort ? static_cast<std::int8_t>(code[pos + 1]) : read_from_buffer<std::int32_t>(&code[pos + 1]);
+		std::size_t target = pos + length + displacement;
+		if (unfuse && instruction != JMP_8 && instruction != JMP)
+		{
+			widened.push_back(INT_SUB);
+			widened.push_back(INT_CONST_0);
+		}
+		widened.push_back(static_cast<std::uint8_t>(isShort ? instruction + 1 : instruction));
+		std::size_t operand = widened.size();
+		widened.resize(operand + sizeof(std::int32_t));
+		store_to_buffer<std::int32_t>(&widened[operand], sizeof(std::int32_t), static_cast<std::int32_t>(moved[target] - widened.size()));
+	}
+	return widened;
+}
+
 int input_loop()
 {
 	std::string filename;
@@ -80,11 +162,616 @@ int main(const char** argv, int argc)
 	// Hello world in SGL
 	std::string test = "func: Hello() { print(\"Hello, world!\"); }";
 
+	// Report what the compiler parses and compiles, on the print sink's diagnostic channel
+	SGL::set_verbose(true);
+
 	SGL::compile_source("func: Hello(int32 i, float j) -> int32 {}");
 	SGL::compile_source("func: Test3(int32 p){}");
 	SGL::compile_source("func: TestLogic() { if (5 == 5) { print(\"Yep, numbers still work!\"); } }");
 	SGL::compile_source(testScript);
 
+	{
+		// Lazy mode only parses signatures, bodies get compiled on their first call
+		Script lazyScript;
+		SGL::compile_source(testScript, lazyScript, SGL::CompileMode::Lazy);
+		std::cout << "Lazy load: " << lazyScript.get_compiled_function_count() << " compiled, "
+			<< lazyScript.get_deferred_function_count() << " deferred" << std::endl;
+
+		VirtualMachine vm;
+		vm.execute_function(lazyScript, "GetHeadshotMultiplier");
+		std::cout << "After first call: " << lazyScript.get_compiled_function_count() << " compiled, "
+			<< lazyScript.get_deferred_function_count() << " deferred" << std::endl;
+	}
+
+	{
+		// Benchmark of compiling a type-heavy script, every function mixes all the numeric types and a vector
+		// so most expressions go through type lookups, promotions and casts
+		std::string typeScript;
+		for (int fn = 0; fn < 32; ++fn)
+		{
+			typeScript += "func: Mix" + std::to_string(fn) + "(int32 a, float b, int64 c, double d, vec3 v) -> double\n{\n"
+				"\tfloat x = a * b;\n\tdouble y = c + d;\n\tint32 i = x;\n\tvec3 w = v * b + a;\n\tint64 z = c + i;\n"
+				"\tfloat l = length(w);\n\treturn y + x + z + l;\n}\n\n";
+		}
+
+		// the per-function reports would drown the timing
+		SGL::set_verbose(false);
+
+		constexpr int compileCount = 200;
+		auto start = std::chrono::steady_clock::now();
+		for (int compile = 0; compile < compileCount; ++compile)
+		{
+			Script typeHeavy;
+			SGL::compile_source(typeScript, typeHeavy, SGL::CompileMode::Eager);
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+
+		SGL::set_verbose(true);
+
+		std::cout << "Type-heavy compile: " << std::chrono::duration<double, std::micro>(elapsed).count() / compileCount
+			<< " us per script of 32 functions" << std::endl;
+	}
+
+	{
+		// Benchmark of short calls, each through a VM from the pool vs a VM created for the call
+		// Measured with g++ 12 on one core of a Linux VM: about 85-98 ns pooled vs 120-167 ns new at -O2,
+		// and 85-106 ns pooled vs 119-169 ns new at -O1 with _DEBUG, the runs vary a lot
+		Script benchScript;
+		SGL::compile_source("func: Tick() { float x = 2.5F; float y = x * 4.0F; }", benchScript, SGL::CompileMode::Eager);
+
+		// the name is looked up once, each call goes straight to the function
+		std::size_t tick = benchScript.find_function("Tick");
+
+		constexpr int callCount = 1000000;
+		constexpr std::size_t stackSize = 1024;
+		VMPool pool(4, stackSize);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int call = 0; call < callCount; ++call)
+		{
+			VMPool::Lease vm = pool.acquire();
+			vm->execute_function(benchScript, tick);
+		}
+		auto pooled = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		for (int call = 0; call < callCount; ++call)
+		{
+			VirtualMachine vm(stackSize);
+			vm.execute_function(benchScript, tick);
+		}
+		auto fresh = std::chrono::steady_clock::now() - start;
+
+		std::cout << "Acquire, execute, release: " << std::chrono::duration<double, std::nano>(pooled).count() / callCount
+			<< " ns per call pooled, " << std::chrono::duration<double, std::nano>(fresh).count() / callCount
+			<< " ns per call with a new VM, " << pool.get_vm_count() << " VMs in the pool" << std::endl;
+	}
+
+	{
+		// Benchmark of the short constant forms against the 4-byte INT_CONST they replace, on straight-line
+		// code full of small constants. The long copy is the same code with each short form widened.
+		// Hardware i-cache misses aren't measured, that needs performance counters. The interpreter loop is
+		// the same either way, so what changes is the bytecode the VM reads, and its size is reported instead.
+		// Measured with g++ 12 at -O2 on one core of a Linux VM: 634 bytes vs 981, and 1.59-1.64 us per call
+		// vs 1.60-1.81 us, so the short forms take a third off the code and cost nothing to decode
+		std::string constScript = "func: Consts() { int32 a = 1; int32 b = 0; int32 c = 8;";
+		for (int step = 0; step < 16; ++step)
+		{
+			constScript += " a = a * 3 + 100; b = b + a % 7 - 1; c = c - 16 + a / 5 + 1000;";
+		}
+		constScript += " }";
+
+		Script constBench;
+		SGL::set_verbose(false);
+		SGL::compile_source(constScript, constBench, SGL::CompileMode::Eager);
+		SGL::set_verbose(true);
+		const SGL::FunctionData* consts = constBench.get_function("Consts");
+
+		std::vector<std::uint8_t> longCode;
+		std::size_t pos = 0;
+		while (pos < consts->Bytecode.size())
+		{
+			auto instruction = static_cast<SGLInstruction>(consts->Bytecode[pos]);
+			std::size_t length = 1 + get_operand_size(get_operand_layout(instruction));
+
+			int value = 0;
+			bool isShort = true;
+			switch (instruction)
+			{
+				case INT_CONST_0: value = 0; break;
+				case INT_CONST_1: value = 1; break;
+				case INT_CONST_8: value = static_cast<std::int8_t>(consts->Bytecode[pos + 1]); break;
+				case INT_CONST_16: value = read_from_buffer<std::int16_t>(&consts->Bytecode[pos + 1]); break;
+				default: isShort = false; break;
+			}
+
+			if (isShort)
+			{
+				longCode.push_back(INT_CONST);
+				longCode.resize(longCode.size() + sizeof(int));
+				store_to_buffer<int>(&longCode[longCode.size() - sizeof(int)], sizeof(int), value);
+			}
+			else
+			{
+				longCode.insert(longCode.end(), consts->Bytecode.begin() + pos, consts->Bytecode.begin() + pos + length);
+			}
+			pos += length;
+		}
+
+		constexpr int callCount = 200000;
+		VirtualMachine vm;
+		auto run = [&](const std::vector<std::uint8_t>& code)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (int call = 0; call < callCount; ++call)
+			{
+				vm.execute_bytecode(code.data(), code.size(), consts->FrameSize, consts->MaxStackSize);
+			}
+			return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / callCount;
+		};
+
+		double shortTime = run(consts->Bytecode);
+		double longTime = run(longCode);
+		std::cout << "Short constants: " << consts->Bytecode.size() << " bytes, " << shortTime << " ns per call; 4-byte constants: "
+			<< longCode.size() << " bytes, " << longTime << " ns per call" << std::endl;
+	}
+
+	{
+		// Benchmark of operand-heavy code, where nearly every instruction carries a global offset or an
+		// inline constant, run from a loaded image so it goes through load-time byte order canonicalization.
+		// Operand reads are a plain memcpy since then, the second number is what decoding the same operands
+		// costs with the per-read byte swap that big-endian builds used to pay, measured on its own
+		// Measured with g++ 12 at -O2 on one core of a Linux VM: 2.2-3.7 ns per instruction in the VM, with 288
+		// of its 416 instructions carrying multi-byte operands, and 1.1-1.7 ns per operand read vs 1.6-3.2 ns
+		// with the swap, so the swap alone would have added 40-90% to every operand read
+		std::string operandScript = "int32 I0; int32 I1; int32 I2; float F0; float F1; int64 L0; int64 L1; double D0; double D1;\n"
+			"func: Operands() {";
+		for (int step = 0; step < 16; ++step)
+		{
+			operandScript += " I0 = I1 + I2 * 40000; F0 = F1 * 2.5F + F0; L0 = L1 + 5000000000; D0 = D1 * 1.5 + D0; I2 = I0 - 70000;";
+		}
+		operandScript += " }";
+
+		Script compiled;
+		SGL::set_verbose(false);
+		SGL::compile_source(operandScript, compiled, SGL::CompileMode::Eager);
+		SGL::set_verbose(true);
+
+		std::vector<std::uint8_t> image;
+		compiled.save_to_bytecode(image);
+		auto loaded = std::make_shared<Script>();
+		loaded->load_from_bytecode(image.data(), image.size());
+
+		// where each multi-byte operand is and how wide it is
+		const std::vector<std::uint8_t>& code = loaded->get_function("Operands")->Bytecode;
+		std::vector<std::pair<std::size_t, std::size_t>> operands;
+		std::size_t instructionCount = 0;
+		for (std::size_t pos = 0; pos < code.size(); ++instructionCount)
+		{
+			SGLOperand layout = get_operand_layout(static_cast<SGLInstruction>(code[pos]));
+			std::size_t size = get_operand_size(layout);
+			if (size >= sizeof(std::uint16_t))
+			{
+				operands.push_back({ pos + 1, size });
+			}
+			pos += 1 + size;
+		}
+
+		constexpr int callCount = 100000;
+		ScriptInstance instance(loaded);
+		std::size_t operandsFunction = loaded->find_function("Operands");
+		VirtualMachine vm(1024);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int call = 0; call < callCount; ++call)
+		{
+			vm.execute_function(instance, operandsFunction);
+		}
+		auto executed = std::chrono::steady_clock::now() - start;
+
+		auto decode = [&](bool swap)
+		{
+			std::uint64_t sum = 0;
+			auto decodeStart = std::chrono::steady_clock::now();
+			for (int call = 0; call < callCount; ++call)
+			{
+				for (const auto& operand : operands)
+				{
+					const std::uint8_t* bytes = &code[operand.first];
+					switch (operand.second)
+					{
+						case 2: sum += swap ? swap_endian(read_from_buffer<std::uint16_t>(bytes)) : read_from_buffer<std::uint16_t>(bytes); break;
+						case 4: sum += swap ? swap_endian(read_from_buffer<std::uint32_t>(bytes)) : read_from_buffer<std::uint32_t>(bytes); break;
+						default: sum += swap ? swap_endian(read_from_buffer<std::uint64_t>(bytes)) : read_from_buffer<std::uint64_t>(bytes); break;
+					}
+				}
+			}
+			auto elapsed = std::chrono::steady_clock::now() - decodeStart;
+
+			// keeps the reads from being optimized away
+			volatile std::uint64_t keep = sum;
+			return std::chrono::duration<double, std::nano>(elapsed).count() / (static_cast<double>(callCount) * operands.size());
+		};
+
+		double plain = decode(false);
+		double swapped = decode(true);
+		std::cout << "Operand-heavy code: " << std::chrono::duration<double, std::nano>(executed).count() / (static_cast<double>(callCount) * instructionCount)
+			<< " ns per instruction, " << operands.size() << " of " << instructionCount << " instructions with multi-byte operands; operand reads "
+			<< plain << " ns, " << swapped << " ns with a byte swap" << std::endl;
+	}
+
+	{
+		// Benchmark of what segmented stacks cost idle VMs and VMs running deep reentrant calls, with every
+		// VM taking its memory from one counting allocator
+		// Measured with g++ 12 at -O2 on one core of a Linux VM: 1000 idle VMs hold 250 KB, with 100 of them
+		// 1000 calls deep they hold 3.4 MB and 250 KB again after shrink_stack, where a 64 KiB stack for each
+		// of the 1000 up front would be 64 MB. Each reentrant call takes 160-250 ns.
+		register_native<std::int32_t(std::int32_t)>("Recurse", &recurse_into_script);
+
+		Script deepScript;
+		SGL::set_verbose(false);
+		SGL::compile_source("func: Deep() { vec4 a = vec4(1, 2, 3, 4); int32 n = Recurse(1); vec4 b = a * n; }", deepScript, SGL::CompileMode::Eager);
+		SGL::set_verbose(true);
+
+		constexpr int vmCount = 1000;
+		constexpr int deepCount = 100;
+		constexpr int depth = 1000;
+		SGLMallocAllocator stackAllocator;
+		std::vector<std::unique_ptr<VirtualMachine>> vms;
+		for (int vm = 0; vm < vmCount; ++vm)
+		{
+			vms.push_back(std::make_unique<VirtualMachine>(256, stackAllocator));
+		}
+		std::size_t idleBytes = stackAllocator.get_bytes_in_use();
+
+		auto start = std::chrono::steady_clock::now();
+		g_recursionScript = &deepScript;
+		for (int vm = 0; vm < deepCount; ++vm)
+		{
+			g_recursionVM = vms[vm].get();
+			g_recursionLeft = depth;
+			vms[vm]->execute_function(deepScript, "Deep");
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		std::size_t deepBytes = stackAllocator.get_bytes_in_use();
+
+		for (auto& vm : vms)
+		{
+			vm->shrink_stack();
+		}
+
+		std::cout << "Segmented stacks: " << idleBytes / 1024 << " KB for " << vmCount << " idle VMs, " << deepBytes / 1024 << " KB with "
+			<< deepCount << " of them " << depth << " calls deep, " << stackAllocator.get_bytes_in_use() / 1024 << " KB after shrink_stack, "
+			<< std::chrono::duration<double, std::nano>(elapsed).count() / (static_cast<double>(deepCount) * depth) << " ns per reentrant call" << std::endl;
+	}
+
+	{
+		// Benchmark of full and delta snapshots of a state region holding the globals of 1000 instances,
+		// with 5% of them ticking between a snapshot and its delta
+		// Measured with g++ 12 at -O2 on one core of a Linux VM: the 48 KB region saves in 1.6-1.8 us and
+		// restores in 1.4-1.6 us, the 50 of its 188 pages the ticks wrote save as a delta in 1.4-1.6 us and
+		// apply in 1.0-1.1 us
+		auto entityScript = std::make_shared<Script>();
+		SGL::set_verbose(false);
+		SGL::compile_source("int32 Hp = 100; float X; float Y = 1.5F; int64 Frames; vec3 Vel;\n"
+			"func: Tick() { Hp = Hp - 1; X = X + Y; Frames = Frames + 1; Vel = Vel + 1; }", *entityScript, SGL::CompileMode::Eager);
+		SGL::set_verbose(true);
+
+		constexpr int entityCount = 1000;
+		constexpr int snapshotCount = 10000;
+		SGLStateRegion region(1 << 20);
+		std::vector<ScriptInstance> entities;
+		entities.reserve(entityCount);
+		for (int entity = 0; entity < entityCount; ++entity)
+		{
+			entities.emplace_back(entityScript, region);
+		}
+		std::size_t tick = entityScript->find_function("Tick");
+		VirtualMachine vm(256);
+
+		std::vector<std::uint8_t> snapshot;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < snapshotCount; ++i)
+		{
+			region.save_snapshot(snapshot);
+		}
+		auto saved = std::chrono::steady_clock::now() - start;
+
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < snapshotCount; ++i)
+		{
+			region.restore_snapshot(snapshot);
+		}
+		auto restored = std::chrono::steady_clock::now() - start;
+
+		SGLStateDelta delta;
+		std::chrono::steady_clock::duration deltaSaved{}, deltaApplied{};
+		for (int i = 0; i < snapshotCount; ++i)
+		{
+			region.save_snapshot(snapshot);
+			for (int entity = i % 20; entity < entityCount; entity += 20)
+			{
+				vm.execute_function(entities[entity], tick);
+			}
+			auto deltaStart = std::chrono::steady_clock::now();
+			region.save_delta(delta);
+			auto deltaEnd = std::chrono::steady_clock::now();
+			region.apply_delta(delta);
+			deltaSaved += deltaEnd - deltaStart;
+			deltaApplied += std::chrono::steady_clock::now() - deltaEnd;
+		}
+
+		auto perSnapshot = [&](std::chrono::steady_clock::duration elapsed) { return std::chrono::duration<double, std::nano>(elapsed).count() / snapshotCount; };
+		std::cout << "State snapshots: " << entityCount << " instances in " << snapshot.size() << " bytes, full save " << perSnapshot(saved)
+			<< " ns, restore " << perSnapshot(restored) << " ns; " << delta.Pages.size() << " pages written by 5% of them, delta save "
+			<< perSnapshot(deltaSaved) << " ns, apply " << perSnapshot(deltaApplied) << " ns" << std::endl;
+	}
+
+	{
+		// Benchmark of a script that builds a long string out of 16 joins on every call, with the VM's
+		// temporaries taking its memory from a counting allocator, and of the same joins made with
+		// concat_strings on the temporaries and on malloc
+		// Measured with g++ 12 at -O2 on one core of a Linux VM: 640-710 ns per call with no upstream
+		// allocations after the first call and 1472 bytes of temporaries at peak; the joins alone take
+		// 320-350 ns on the temporaries and 600-630 ns on malloc
+		Script joinScript;
+		SGL::set_verbose(false);
+		SGL::compile_source("func: Join() { string label = \"entity_\"; for (int32 i = 0; i < 16; i = i + 1) { label = label + \"component_\"; } }",
+			joinScript, SGL::CompileMode::Eager);
+		SGL::set_verbose(true);
+
+		constexpr int callCount = 200000;
+		constexpr int joinCount = 16;
+		SGLMallocAllocator vmAllocator;
+		VirtualMachine vm(256, vmAllocator);
+		std::size_t join = joinScript.find_function("Join");
+		vm.execute_function(joinScript, join);
+		std::size_t warmAllocations = vmAllocator.get_allocation_count();
+
+		auto start = std::chrono::steady_clock::now();
+		for (int call = 0; call < callCount; ++call)
+		{
+			vm.execute_function(joinScript, join);
+		}
+		auto scripted = std::chrono::steady_clock::now() - start;
+		std::size_t upstreamAllocations = vmAllocator.get_allocation_count() - warmAllocations;
+
+		SGLString entity = get_string_table().intern("entity_");
+		SGLString component = get_string_table().intern("component_");
+		auto joinAll = [&](SGLAllocator& allocator, bool freeEach)
+		{
+			std::size_t length = 0;
+			auto joinStart = std::chrono::steady_clock::now();
+			for (int call = 0; call < callCount; ++call)
+			{
+				SGLString label = entity;
+				for (int i = 0; i < joinCount; ++i)
+				{
+					SGLString joined = concat_strings(label, component, allocator);
+					if (freeEach && label.is_temporary())
+					{
+						allocator.deallocate(const_cast<char*>(label.view().data()), label.length());
+					}
+					label = joined;
+				}
+				length += label.length();
+				if (freeEach)
+				{
+					allocator.deallocate(const_cast<char*>(label.view().data()), label.length());
+				}
+				else
+				{
+					static_cast<SGLScratchAllocator&>(allocator).reset();
+				}
+			}
+			auto elapsed = std::chrono::steady_clock::now() - joinStart;
+
+			// keeps the joins from being optimized away
+			volatile std::size_t keep = length;
+			return std::chrono::duration<double, std::nano>(elapsed).count() / callCount;
+		};
+
+		SGLMallocAllocator heap;
+		SGLScratchAllocator scratch(SGL_TEMPORARIES_DEFAULT_SIZE, heap);
+		double onScratch = joinAll(scratch, false);
+		double onHeap = joinAll(heap, true);
+		std::cout << "Call temporaries: " << std::chrono::duration<double, std::nano>(scripted).count() / callCount << " ns per call of " << joinCount
+			<< " joins, " << upstreamAllocations << " upstream allocations over " << callCount << " calls, peak " << vm.get_temporaries().get_peak_bytes()
+			<< " bytes; the joins alone " << onScratch << " ns on temporaries, " << onHeap << " ns on malloc" << std::endl;
+	}
+
+	{
+		// Benchmark of comparing and joining interned and inline strings against std::string, and of a
+		// script storing a new status string to a global on every tick
+		// Measured with g++ 12 at -O2 on one core of a Linux VM, loop overhead included: equality of long
+		// strings 3.6-5.4 ns with std::string and 2.4-4.6 ns interned, of short ones 3.6-5.9 ns with
+		// std::string and 2.1-3.3 ns inline; joining a long and a short one 56-57 ns with std::string and
+		// 24-28 ns with concat_strings; 100k status stores 106-161 ns each, leaving 2 buffers of 67 bytes
+		constexpr int compareCount = 10000000;
+		const std::vector<std::string> longNames = { "component_name_transform_0", "component_name_transform_0", "component_name_transform_1" };
+		const std::vector<std::string> shortNames = { "pos", "pos", "vel" };
+		std::vector<SGLString> longInterned, shortInline;
+		for (std::size_t i = 0; i < longNames.size(); ++i)
+		{
+			longInterned.push_back(get_string_table().intern(longNames[i]));
+			shortInline.push_back(get_string_table().intern(shortNames[i]));
+		}
+
+		// 'names' is indexed with the loop counter so the comparisons can't be hoisted out of the loop
+		auto compare = [&](const auto& names)
+		{
+			int equal = 0;
+			auto compareStart = std::chrono::steady_clock::now();
+			for (int i = 0; i < compareCount; ++i)
+			{
+				equal += names[i % 3] == names[(i + 1) % 3];
+			}
+			auto elapsed = std::chrono::steady_clock::now() - compareStart;
+
+			// keeps the comparisons from being optimized away
+			volatile int keep = equal;
+			return std::chrono::duration<double, std::nano>(elapsed).count() / compareCount;
+		};
+
+		constexpr int joinCount = 2000000;
+		SGLScratchAllocator temporaries(SGL_TEMPORARIES_DEFAULT_SIZE, get_default_allocator());
+		std::size_t length = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < joinCount; ++i)
+		{
+			std::string joined = longNames[i % 3] + shortNames[i % 3];
+			length += joined.size();
+		}
+		auto joinedStd = std::chrono::steady_clock::now() - start;
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < joinCount; ++i)
+		{
+			SGLString joined = concat_strings(longInterned[i % 3], shortInline[i % 3], temporaries);
+			length += joined.length();
+			if (i % 256 == 255)
+			{
+				temporaries.reset();
+			}
+		}
+		auto joinedInterned = std::chrono::steady_clock::now() - start;
+		volatile std::size_t keepLength = length;
+
+		auto statusScript = std::make_shared<Script>();
+		SGL::set_verbose(false);
+		SGL::compile_source("string Status; int32 Health;\nfunc: Tick() { Health = Health + 1; Status = \"Health remaining right now: \" + Health; }",
+			*statusScript, SGL::CompileMode::Eager);
+		SGL::set_verbose(true);
+
+		constexpr int tickCount = 100000;
+		ScriptInstance instance(statusScript);
+		std::size_t tick = statusScript->find_function("Tick");
+		VirtualMachine vm(256);
+		start = std::chrono::steady_clock::now();
+		for (int i = 0; i < tickCount; ++i)
+		{
+			vm.execute_function(instance, tick);
+		}
+		auto ticked = std::chrono::steady_clock::now() - start;
+
+		std::cout << "Strings: equality " << compare(longNames) << " ns for long std::string, " << compare(longInterned) << " ns interned, "
+			<< compare(shortNames) << " ns for short std::string, " << compare(shortInline) << " ns inline; joins "
+			<< std::chrono::duration<double, std::nano>(joinedStd).count() / joinCount << " ns with std::string, "
+			<< std::chrono::duration<double, std::nano>(joinedInterned).count() / joinCount << " ns with concat_strings; " << tickCount << " status stores "
+			<< std::chrono::duration<double, std::nano>(ticked).count() / tickCount << " ns each, leaving " << instance.get_strings().get_string_count()
+			<< " buffers of " << instance.get_strings().get_byte_count() << " bytes" << std::endl;
+	}
+
+	{
+		// Benchmark of branchy loops with the short jumps the compiler emits, with every jump widened to
+		// its long form, and with the compare-and-branch instructions unfused, plus the compile time of a
+		// long else-if chain
+		// Measured with g++ 12 at -O2 on one core of a Linux VM: counting takes 34-44 ms short in 35 bytes,
+		// 34-43 ms long in 44 bytes and 45-56 ms unfused, clamping 59-60 ms short in 60 bytes, 54-57 ms long
+		// in 75 bytes and 79-82 ms unfused; a 4000-case chain compiles in 10-13 ms
+		Script loopScript;
+		SGL::set_verbose(false);
+		SGL::compile_source(
+			"func: Count() { int32 c = 0; for (int32 i = 0; i < 1000000; i = i + 1) { if (i % 3 == 0) c = c + 1; } }\n"
+			"func: Clamp() { int32 s = 0; for (int32 x = -1000; x < 999000; x = x + 1) { int32 y = x % 2000; if (y < 0) y = 0; else if (y > 1000) y = 1000; s = s + y; } }",
+			loopScript, SGL::CompileMode::Eager);
+		SGL::set_verbose(true);
+
+		VirtualMachine vm(256);
+		for (const char* name : { "Count", "Clamp" })
+		{
+			const SGL::FunctionData* function = loopScript.get_function(name);
+			const std::vector<std::uint8_t>* forms[] = { &function->Bytecode, nullptr, nullptr };
+			std::vector<std::uint8_t> widened = widen_jumps(function->Bytecode, false);
+			std::vector<std::uint8_t> unfused = widen_jumps(function->Bytecode, true);
+			forms[1] = &widened;
+			forms[2] = &unfused;
+
+			// best of 5 runs of each form, taken in turn so they all see the same machine
+			double best[3] = { 1e9, 1e9, 1e9 };
+			for (int round = 0; round < 5; ++round)
+			{
+				for (int form = 0; form < 3; ++form)
+				{
+					auto start = std::chrono::steady_clock::now();
+					vm.execute_bytecode(forms[form]->data(), forms[form]->size(), function->FrameSize, function->MaxStackSize, &loopScript.get_constants());
+					best[form] = std::min(best[form], std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+				}
+			}
+
+			std::cout << "Jumps in " << name << ": " << best[0] << " ms in " << forms[0]->size() << " bytes short, " << best[1] << " ms in "
+				<< forms[1]->size() << " bytes long, " << best[2] << " ms unfused per 1M iterations" << std::endl;
+		}
+
+		constexpr int caseCount = 4000;
+		std::string chain = "int32 X; int32 R;\nfunc: F() {\n";
+		for (int i = 0; i < caseCount; ++i)
+		{
+			chain += std::string(i ? " else " : "\t") + "if (X < " + std::to_string(i * 2) + ") { R = " + std::to_string(i + 1) + "; }\n";
+		}
+		chain += " else { R = -1; }\n}\n";
+
+		Script chainScript;
+		SGL::set_verbose(false);
+		auto start = std::chrono::steady_clock::now();
+		SGL::compile_source(chain, chainScript, SGL::CompileMode::Eager);
+		auto compiled = std::chrono::steady_clock::now() - start;
+		SGL::set_verbose(true);
+		std::cout << "Compiling a " << caseCount << "-case else-if chain: " << std::chrono::duration<double, std::milli>(compiled).count() << " ms" << std::endl;
+	}
+
+	{
+		// Benchmark of a 64-state machine stepped a million times, written so the compiler turns it into a
+		// switch and, by wrapping the state in parentheses, so it stays a chain of compares; the dense
+		// states become a TABLE_SWITCH and the sparse ones a LOOKUP_SWITCH
+		// Measured with g++ 12 at -O2 on one core of a Linux VM: the dense chain takes 280-334 ns per step in
+		// 1076 bytes and the TABLE_SWITCH 33-44 ns in 873 bytes, the sparse chain 290-367 ns in 1207 bytes
+		// and the LOOKUP_SWITCH 38-46 ns in 1195 bytes
+		struct StateMachine
+		{
+			const char* Name;
+			const char* Subject;
+			int Scale;
+		};
+		const StateMachine machines[] = {
+			{ "dense if chain", "(S)", 1 }, { "TABLE_SWITCH", "S", 1 },
+			{ "sparse if chain", "(S)", 1000 }, { "LOOKUP_SWITCH", "S", 1000 } };
+
+		constexpr int stateCount = 64;
+		constexpr int stepCount = 1000000;
+		VirtualMachine vm(256);
+		std::cout << "64-state machine:";
+		const char* separator = " ";
+		for (const StateMachine& machine : machines)
+		{
+			std::string source = "int32 S;\nfunc: Run() { for (int32 i = 0; i < " + std::to_string(stepCount) + "; i = i + 1) { ";
+			for (int state = 0; state < stateCount; ++state)
+			{
+				source += std::string(state ? "else " : "") + "if (" + machine.Subject + " == " + std::to_string(state * machine.Scale) + ") S = "
+					+ std::to_string(((state * 37 + 11) % stateCount) * machine.Scale) + "; ";
+			}
+			source += "} }";
+
+			auto machineScript = std::make_shared<Script>();
+			SGL::set_verbose(false);
+			SGL::compile_source(source, *machineScript, SGL::CompileMode::Eager);
+			SGL::set_verbose(true);
+
+			ScriptInstance instance(machineScript);
+			std::size_t run = machineScript->find_function("Run");
+			double best = 1e9;
+			for (int round = 0; round < 5; ++round)
+			{
+				auto start = std::chrono::steady_clock::now();
+				vm.execute_function(instance, run);
+				best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / stepCount);
+			}
+
+			std::cout << separator << machine.Name << " " << best << " ns per step in " << machineScript->get_function("Run")->Bytecode.size() << " bytes";
+			separator = ", ";
+		}
+		std::cout << std::endl;
+	}
+
 	register_datatypes();
 
 	execute_compiler_test();
@@ -117,7 +804,7 @@ int main(const char** argv, int argc)
 		bytecode[59] = INT_DIV;													// INT_DIV (10 * (w + z * (8 * x)) % y / (x + 1))
 		bytecode[60] = INT_STORE; bytecode[61] = 4;								// INT_STORE 4 (i = result of above)
 
-		vm.execute_bytecode(bytecode, 61);
+		vm.execute_bytecode(bytecode, 62, 5, 5 * sizeof(int));
 	}
 
 	int x = 5;
@@ -0,0 +1,100 @@
+#include "NativeFunctions.h"
+
+#include <iostream>
+
+bool SGLNativeRegistry::mount_static_functions(const SGLNativeTable& table)
+{
+	if (_staticFunctions.Count != 0 || !_functions.empty())
+	{
+		std::cerr << "Static natives must be mounted once, before any native is registered at runtime" << std::endl;
+		return false;
+	}
+
+	if (table.Count > SGL_MAX_NATIVE_FUNCTIONS)
+	{
+		std::cerr << "Static native table has " << table.Count << " natives, the limit is " << SGL_MAX_NATIVE_FUNCTIONS << std::endl;
+		return false;
+	}
+
+	// the table is sorted, so duplicates sit next to each other
+	for (std::size_t i = 0; i < table.Count; ++i)
+	{
+		if (i > 0 && table.Functions[i - 1].Name == table.Functions[i].Name)
+		{
+			std::cerr << "Native function " << table.Functions[i].Name << " is in the static table more than once" << std::endl;
+			return false;
+		}
+
+		if (!validate_function(table.Functions[i]))
+		{
+			return false;
+		}
+	}
+
+	_staticFunctions = table;
+	return true;
+}
+
+std::uint32_t SGLNativeRegistry::register_function(SGLNativeFunction function)
+{
+	if (find_function_index(function.Name) != SGL_INVALID_NATIVE)
+	{
+		std::cerr << "Native function " << function.Name << " is already registered" << std::endl;
+		return SGL_INVALID_NATIVE;
+	}
+
+	if (!validate_function(function))
+	{
+		return SGL_INVALID_NATIVE;
+	}
+
+	if (get_function_count() >= SGL_MAX_NATIVE_FUNCTIONS)
+	{
+		std::cerr << "Too many native functions registered, unable to register " << function.Name << std::endl;
+		return SGL_INVALID_NATIVE;
+	}
+
+	_names.emplace_back(function.Name);
+	function.Name = _names.back();
+
+	std::uint32_t index = static_cast<std::uint32_t>(get_function_count());
+	_indices[function.Name] = index;
+	_functions.push_back(function);
+
+	return index;
+}
+
+std::uint32_t SGLNativeRegistry::find_function_index(std::string_view name) const
+{
+	std::uint32_t index = _staticFunctions.find_function_index(name);
+	if (index != SGL_INVALID_NATIVE)
+	{
+		return index;
+	}
+
+	auto it = _indices.find(name);
+	if (it == _indices.end())
+	{
+		return SGL_INVALID_NATIVE;
+	}
+
+	return it->second;
+}
+
+bool SGLNativeRegistry::validate_function(const SGLNativeFunction& function) const
+{
+	// pointers to types that weren't registered with register_object_type have no SGL type yet
+	bool hasUnknownType = function.get_return_type() == SGL_INVALID_TYPE_ID;
+	for (std::size_t i = 0; i < function.ParamCount; ++i)
+	{
+		hasUnknownType |= *function.ParamTypes[i] == SGL_INVALID_TYPE_ID;
+	}
+
+	if (hasUnknownType)
+	{
+		std::cerr << "Native function " << function.Name << " uses an object type that isn't registered" << std::endl;
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SGLTypes.h"
+#include "Stack.h"
+
+// Native C++ function binding
+
+// Largest number of native functions, call sites hold a 16-bit index
+constexpr std::size_t SGL_MAX_NATIVE_FUNCTIONS = 65536;
+
+// Index returned when a native function isn't registered
+constexpr std::uint32_t SGL_INVALID_NATIVE = 0xFFFFFFFF;
+
+/**
+ * Pops a native's argument off the stack
+ * Object pointers are held in SGL_OBJECT_REFERENCE_SIZE bytes whatever the host's pointer size is
+ */
+template <class T>
+T pop_native_value(VMStack& stack)
+{
+	if constexpr (std::is_pointer_v<T>)
+	{
+		static_assert(sizeof(T) <= SGL_OBJECT_REFERENCE_SIZE, "Object pointers must fit in a script value");
+		return reinterpret_cast<T>(static_cast<std::uintptr_t>(stack.pop<std::uint64_t>()));
+	}
+	else
+	{
+		return stack.pop<T>();
+	}
+}
+
+/**
+ * Pushes a native's return value onto the stack
+ */
+template <class T>
+void push_native_value(VMStack& stack, T value)
+{
+	if constexpr (std::is_pointer_v<T>)
+	{
+		stack.push<std::uint64_t>(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(value)));
+	}
+	else
+	{
+		stack.push<T>(value);
+	}
+}
+
+// Type erased pointer to the registered function, cast back to its real type by its thunk
+using SGLNativePointer = void (*)();
+
+// Pops a native's arguments off the stack, calls it and pushes what it returns
+using SGLNativeThunk = void (*)(VMStack& stack, SGLNativePointer function);
+
+/**
+ * A registered native function
+ * Plain constant data, so static native tables are built at compile time
+ * Types are referred to through where their IDs are kept, since object types only get an ID once
+ * they're registered or mounted
+ */
+struct SGLNativeFunction
+{
+	// Name scripts call the function by
+	std::string_view Name;
+	// Type of the value the function returns
+	const SGLTypeId* ReturnType = nullptr;
+	// Types of the function's parameters, in order
+	const SGLTypeId* const* ParamTypes = nullptr;
+	// Number of parameters
+	std::size_t ParamCount = 0;
+	// The function itself, unused by the thunks of static natives which call it directly
+	SGLNativePointer Function = nullptr;
+	// Thunk generated for the function's signature
+	SGLNativeThunk Thunk = nullptr;
+
+	/**
+	 * Returns the SGL type of the return value
+	 */
+	SGLTypeId get_return_type() const
+	{
+		return *ReturnType;
+	}
+
+	/**
+	 * Returns the SGL types of the parameters, in order
+	 */
+	std::vector<SGLTypeId> get_param_types() const
+	{
+		std::vector<SGLTypeId> types(ParamCount);
+		for (std::size_t i = 0; i < ParamCount; ++i)
+		{
+			types[i] = *ParamTypes[i];
+		}
+
+		return types;
+	}
+};
+
+/**
+ * Thunks generated per signature
+ * Arguments are pushed left to right, so they're popped right to left straight into a tuple and
+ * the function is called through its real type, without any boxing or allocation
+ */
+template <class Signature>
+struct SGLNativeCaller;
+
+template <class R, class... Args>
+struct SGLNativeCaller<R(Args...)>
+{
+	using Pointer = R (*)(Args...);
+
+	// Where the return type's ID is kept
+	static constexpr const SGLTypeId* ReturnType = &SGLNativeType<std::decay_t<R>>::Id;
+
+	// Where the parameter types' IDs are kept, in order
+	static constexpr std::array<const SGLTypeId*, sizeof...(Args)> ParamTypes = { &SGLNativeType<std::decay_t<Args>>::Id... };
+
+	static void call(VMStack& stack, SGLNativePointer function)
+	{
+		call(stack, reinterpret_cast<Pointer>(function), std::index_sequence_for<Args...>());
+	}
+
+	/**
+	 * Thunk for a function known at compile time, which calls it directly instead of through a pointer
+	 */
+	template <Pointer Function>
+	static void call_static(VMStack& stack, SGLNativePointer)
+	{
+		call(stack, Function, std::index_sequence_for<Args...>());
+	}
+
+private:
+
+	template <std::size_t... I>
+	static void call(VMStack& stack, Pointer function, std::index_sequence<I...>)
+	{
+		constexpr std::size_t count = sizeof...(Args);
+		std::tuple<std::decay_t<Args>...> args;
+
+		// the comma fold runs left to right, so the last argument is popped first
+		(void)(..., (std::get<count - 1 - I>(args) = pop_native_value<std::tuple_element_t<count - 1 - I, decltype(args)>>(stack)));
+
+		if constexpr (std::is_void_v<R>)
+		{
+			std::apply(function, args);
+		}
+		else
+		{
+			push_native_value<R>(stack, std::apply(function, args));
+		}
+	}
+};
+
+/**
+ * A table of natives built at compile time
+ * Views constant data, the registry never copies or frees what it points to
+ */
+struct SGLNativeTable
+{
+	// Natives sorted by name, each native's index is its position
+	const SGLNativeFunction* Functions = nullptr;
+	// Number of natives in the table
+	std::size_t Count = 0;
+
+	/**
+	 * Returns the index of the native with the given name, or SGL_INVALID_NATIVE if the table doesn't have it
+	 */
+	std::uint32_t find_function_index(std::string_view name) const
+	{
+		const SGLNativeFunction* end = Functions + Count;
+		const SGLNativeFunction* function = std::lower_bound(Functions, end, name, [](const SGLNativeFunction& function, std::string_view name)
+		{
+			return function.Name < name;
+		});
+
+		return (function != end && function->Name == name) ? static_cast<std::uint32_t>(function - Functions) : SGL_INVALID_NATIVE;
+	}
+};
+
+/**
+ * Natives described entirely at compile time, see make_static_native_table
+ */
+template <std::size_t N>
+struct SGLStaticNativeTable
+{
+	// Natives sorted by name
+	std::array<SGLNativeFunction, N> Functions;
+
+	/**
+	 * Returns a view of the table for the registry
+	 */
+	SGLNativeTable get_table() const
+	{
+		return { Functions.data(), N };
+	}
+};
+
+/**
+ * The list of native functions scripts can call, shared by the compiler and the VM
+ *
+ * Natives in the mounted static table come first and cost nothing to set up, natives registered
+ * at runtime follow them.
+ */
+class SGLNativeRegistry
+{
+public:
+
+	/**
+	 * Mounts a table of natives built at compile time, which then behave like registered natives
+	 * Only one table can be mounted, before any native is registered at runtime and after the
+	 * object types its natives use are registered
+	 * Returns false if the table can't be mounted
+	 */
+	bool mount_static_functions(const SGLNativeTable& table);
+
+	template <std::size_t N>
+	bool mount_static_functions(const SGLStaticNativeTable<N>& table)
+	{
+		return mount_static_functions(table.get_table());
+	}
+
+	/**
+	 * Registers a native function and returns its index
+	 * Returns SGL_INVALID_NATIVE if the name is taken or the registry is full
+	 */
+	std::uint32_t register_function(SGLNativeFunction function);
+
+	/**
+	 * Returns the index of the native with the given name, or SGL_INVALID_NATIVE if there is none
+	 */
+	std::uint32_t find_function_index(std::string_view name) const;
+
+	/**
+	 * Returns the native at the given index
+	 */
+	const SGLNativeFunction& get_function(std::uint32_t index) const
+	{
+		return index < _staticFunctions.Count ? _staticFunctions.Functions[index] : _functions[index - _staticFunctions.Count];
+	}
+
+	/**
+	 * Returns the number of registered natives
+	 */
+	std::size_t get_function_count() const
+	{
+		return _staticFunctions.Count + _functions.size();
+	}
+
+private:
+
+	/**
+	 * Returns false and explains why if the native can't be called from scripts
+	 */
+	bool validate_function(const SGLNativeFunction& function) const;
+
+	// Natives of the mounted static table, empty if there is none
+	SGLNativeTable _staticFunctions;
+
+	// Natives registered at runtime, indexed by call site index minus the static count
+	// deque so references handed out by get_function stay valid as more are registered
+	std::deque<SGLNativeFunction> _functions;
+	// Storage for the names of natives registered at runtime, which SGLNativeFunction only views
+	std::deque<std::string> _names;
+	// Name -> index lookup for natives registered at runtime, only used when compiling call sites
+	std::unordered_map<std::string_view, std::uint32_t> _indices;
+
+};
+
+/**
+ * Returns the native function registry
+ */
+inline SGLNativeRegistry& get_native_registry()
+{
+	static SGLNativeRegistry registry;
+	return registry;
+}
+
+/**
+ * Registers a C++ function that scripts can call by name, for example
+ * register_native<float(float, std::int32_t)>("ScaleDamage", &ScaleDamage);
+ * Pointers to native object types can be passed and returned once the type is registered
+ * Returns the native's index, or SGL_INVALID_NATIVE if it couldn't be registered
+ */
+template <class Signature>
+std::uint32_t register_native(const std::string& name, Signature* function)
+{
+	using Caller = SGLNativeCaller<Signature>;
+
+	SGLNativeFunction native;
+	native.Name = name;
+	native.ReturnType = Caller::ReturnType;
+	native.ParamTypes = Caller::ParamTypes.data();
+	native.ParamCount = Caller::ParamTypes.size();
+	native.Function = reinterpret_cast<SGLNativePointer>(function);
+	native.Thunk = &Caller::call;
+
+	return get_native_registry().register_function(native);
+}
+
+/**
+ * Describes a native at compile time, see SGL_STATIC_NATIVE
+ * The function is a template argument, so its thunk calls it directly
+ */
+template <class Signature, Signature* Function>
+constexpr SGLNativeFunction make_static_native(std::string_view name)
+{
+	using Caller = SGLNativeCaller<Signature>;
+
+	SGLNativeFunction native;
+	native.Name = name;
+	native.ReturnType = Caller::ReturnType;
+	native.ParamTypes = Caller::ParamTypes.data();
+	native.ParamCount = Caller::ParamTypes.size();
+	native.Thunk = &Caller::template call_static<Function>;
+	return native;
+}
+
+/**
+ * Builds a table of natives at compile time, sorted by name so lookups can binary search it
+ * Mount it with get_native_registry().mount_static_functions before registering natives at runtime
+ */
+template <class... T>
+constexpr SGLStaticNativeTable<sizeof...(T)> make_static_native_table(const T&... natives)
+{
+	return { sort_constexpr(std::array<SGLNativeFunction, sizeof...(T)>{ natives... }, [](const SGLNativeFunction& lh, const SGLNativeFunction& rh)
+	{
+		return lh.Name < rh.Name;
+	}) };
+}
+
+// Helper macro to describe a native at compile time, called by a name exactly matching the C++ function's name
+#define SGL_STATIC_NATIVE(FUNCTION) make_static_native<decltype(FUNCTION), &FUNCTION>(#FUNCTION)
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "PrintSink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	// Bytes in front of each line in a ring
+	constexpr std::size_t LINE_HEADER_SIZE = 2 * sizeof(std::uint32_t);
+
+	// Source of sink IDs
+	std::atomic<std::uint64_t> nextSinkId{ 1 };
+
+	/**
+	 * Copies into a ring at a position that may wrap around its end
+	 */
+	void copy_to_ring(char* ring, std::size_t pos, const void* data, std::size_t size)
+	{
+		std::size_t offset = pos & (SGL_PRINT_RING_SIZE - 1);
+		std::size_t first = std::min(size, SGL_PRINT_RING_SIZE - offset);
+		std::memcpy(ring + offset, data, first);
+		std::memcpy(ring, static_cast<const char*>(data) + first, size - first);
+	}
+
+	/**
+	 * Copies out of a ring from a position that may wrap around its end
+	 */
+	void copy_from_ring(const char* ring, std::size_t pos, void* data, std::size_t size)
+	{
+		std::size_t offset = pos & (SGL_PRINT_RING_SIZE - 1);
+		std::size_t first = std::min(size, SGL_PRINT_RING_SIZE - offset);
+		std::memcpy(data, ring + offset, first);
+		std::memcpy(static_cast<char*>(data) + first, ring, size - first);
+	}
+
+	/**
+	 * Writes lines to stdout or stderr
+	 */
+	void write_to_stdio(SGLPrintChannel channel, std::string_view text)
+	{
+		std::FILE* file = channel == SGLPrintChannel::Output ? stdout : stderr;
+		std::fwrite(text.data(), 1, text.size(), file);
+		std::fflush(file);
+	}
+}
+
+SGLPrintSink::SGLPrintSink()
+	: _id(nextSinkId.fetch_add(1, std::memory_order_relaxed))
+	, _writer(write_to_stdio)
+{
+	_thread = std::thread(&SGLPrintSink::run, this);
+}
+
+SGLPrintSink::~SGLPrintSink()
+{
+	{
+		std::lock_guard<std::mutex> lock(_stateMutex);
+		_stop = true;
+	}
+	_wake.notify_one();
+	_thread.join();
+}
+
+bool SGLPrintSink::write(SGLPrintChannel channel, std::string_view line)
+{
+	Ring& ring = get_thread_ring();
+
+	// a line longer than the whole ring is cut short, it could never fit otherwise
+	line = line.substr(0, SGL_PRINT_RING_SIZE - LINE_HEADER_SIZE);
+	std::size_t size = LINE_HEADER_SIZE + line.size();
+
+	std::size_t head = ring.Head.load(std::memory_order_relaxed);
+	std::size_t tail = ring.Tail.load(std::memory_order_acquire);
+	if (SGL_PRINT_RING_SIZE - (head - tail) < size)
+	{
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		_wake.notify_one();
+		return false;
+	}
+
+	std::uint32_t header[2] = { static_cast<std::uint32_t>(line.size()), static_cast<std::uint32_t>(channel) };
+	copy_to_ring(ring.Memory.get(), head, header, sizeof(header));
+	copy_to_ring(ring.Memory.get(), head + LINE_HEADER_SIZE, line.data(), line.size());
+
+	// publishes the line to the writer thread
+	ring.Head.store(head + size, std::memory_order_release);
+
+	// a ring past half full gets drained now instead of at the next interval
+	if (head + size - tail > SGL_PRINT_RING_SIZE / 2)
+	{
+		_wake.notify_one();
+	}
+
+	return true;
+}
+
+void SGLPrintSink::flush()
+{
+	std::unique_lock<std::mutex> lock(_stateMutex);
+
+	// the pass in progress might have missed the latest lines, the one after it can't
+	std::uint64_t target = _passes + 2;
+	_wake.notify_one();
+	_passed.wait(lock, [&]() { return _passes >= target || _stop; });
+}
+
+void SGLPrintSink::set_writer(SGLPrintWriter writer)
+{
+	std::lock_guard<std::mutex> lock(_writerMutex);
+	_writer = writer ? std::move(writer) : SGLPrintWriter(write_to_stdio);
+}
+
+SGLPrintSink::Ring& SGLPrintSink::get_thread_ring()
+{
+	/**
+	 * The ring the thread is writing to, given back to the sink when the thread exits
+	 */
+	struct CachedRing
+	{
+		std::uint64_t SinkId = 0;
+		Ring* Current = nullptr;
+
+		~CachedRing()
+		{
+			if (Current)
+			{
+				Current->InUse.store(false, std::memory_order_release);
+			}
+		}
+	};
+	thread_local CachedRing cached;
+
+	if (cached.SinkId == _id)
+	{
+		return *cached.Current;
+	}
+
+	std::lock_guard<std::mutex> lock(_ringsMutex);
+
+	// a ring given back by a thread that has exited, or a new one
+	Ring* ring = nullptr;
+	for (auto& existing : _rings)
+	{
+		bool inUse = false;
+		if (existing->InUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+		{
+			ring = existing.get();
+			break;
+		}
+	}
+
+	if (!ring)
+	{
+		_rings.push_back(std::make_unique<Ring>());
+		ring = _rings.back().get();
+	}
+
+	// a thread that used another sink before gives that ring back
+	if (cached.Current)
+	{
+		cached.Current->InUse.store(false, std::memory_order_release);
+	}
+
+	cached.SinkId = _id;
+	cached.Current = ring;
+	return *ring;
+}
+
+bool SGLPrintSink::drain()
+{
+	bool any = false;
+
+	std::lock_guard<std::mutex> lock(_ringsMutex);
+	for (auto& ring : _rings)
+	{
+		std::size_t tail = ring->Tail.load(std::memory_order_relaxed);
+		std::size_t head = ring->Head.load(std::memory_order_acquire);
+		while (tail != head)
+		{
+			std::uint32_t header[2];
+			copy_from_ring(ring->Memory.get(), tail, header, sizeof(header));
+
+			std::string& batch = _batches[header[1] == static_cast<std::uint32_t>(SGLPrintChannel::Output) ? 0 : 1];
+			std::size_t pos = batch.size();
+			batch.resize(pos + header[0]);
+			copy_from_ring(ring->Memory.get(), tail + LINE_HEADER_SIZE, &batch[pos], header[0]);
+			batch.push_back('\n');
+
+			tail += LINE_HEADER_SIZE + header[0];
+			any = true;
+		}
+
+		// hands the drained bytes back to the writing thread
+		ring->Tail.store(tail, std::memory_order_release);
+	}
+
+	return any;
+}
+
+void SGLPrintSink::run()
+{
+	bool isDone = false;
+	while (!isDone)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_stateMutex);
+			_wake.wait_for(lock, std::chrono::milliseconds(SGL_PRINT_INTERVAL_MS));
+			isDone = _stop;
+		}
+
+		// once stopping, this pass is the last so it picks up everything
+		drain();
+
+		std::size_t dropped = _dropped.load(std::memory_order_relaxed);
+		if (dropped != _droppedReported)
+		{
+			append_text(_batches[1], "[print dropped ");
+			append_text(_batches[1], dropped - _droppedReported);
+			append_text(_batches[1], " lines, the ring was full]\n");
+			_droppedReported = dropped;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_writerMutex);
+			for (std::size_t i = 0; i < 2; ++i)
+			{
+				if (!_batches[i].empty())
+				{
+					_writer(i == 0 ? SGLPrintChannel::Output : SGLPrintChannel::Diagnostic, _batches[i]);
+					_batches[i].clear();
+				}
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_stateMutex);
+			++_passes;
+		}
+		_passed.notify_all();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Bytes in each thread's ring, a power of two
+constexpr std::size_t SGL_PRINT_RING_SIZE = 64 * 1024;
+
+// Longest the writer thread sleeps before looking for new lines, in milliseconds
+constexpr int SGL_PRINT_INTERVAL_MS = 2;
+
+/**
+ * Where a line goes
+ */
+enum class SGLPrintChannel : std::uint32_t
+{
+	// What scripts print
+	Output,
+	// Errors the VM runs into while running code
+	Diagnostic
+};
+
+// Writes a batch of lines, each ending in a newline, to wherever the host wants them
+using SGLPrintWriter = std::function<void(SGLPrintChannel channel, std::string_view text)>;
+
+/**
+ * Appends the text of a value to a line without going through iostreams
+ */
+inline void append_text(std::string& line, std::string_view text)
+{
+	line.append(text);
+}
+
+template <class T>
+void append_text(std::string& line, T value)
+{
+	if constexpr (std::is_same_v<T, char>)
+	{
+		line.push_back(value);
+	}
+	else if constexpr (std::is_arithmetic_v<T>)
+	{
+		// shortest text that reads back as the same value, for floats too
+		char buffer[32];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		line.append(buffer, result.ptr);
+	}
+	else
+	{
+		line.append(std::string_view(value));
+	}
+}
+
+/**
+ * Takes lines from any number of threads and writes them out on a thread of its own
+ *
+ * Each thread that writes gets a ring of its own, so writing a line is a copy into memory only
+ * that thread touches plus one atomic store, no locks and no I/O. The writer thread wakes up
+ * every few milliseconds (sooner if a ring is filling up), drains every ring, and hands each
+ * channel's lines to the writer in one batch. A thread's lines come out in the order it wrote
+ * them. If a ring is full the line is dropped rather than making the thread wait, and the
+ * number of dropped lines is reported with the next batch.
+ *
+ * A sink has to outlive every thread that writes to it.
+ */
+class SGLPrintSink
+{
+public:
+
+	/**
+	 * Starts the writer thread, lines go to stdout and stderr until set_writer says otherwise
+	 */
+	SGLPrintSink();
+
+	SGLPrintSink(const SGLPrintSink&) = delete;
+	SGLPrintSink& operator=(const SGLPrintSink&) = delete;
+
+	/**
+	 * Writes out whatever is left and stops the writer thread
+	 */
+	~SGLPrintSink();
+
+	/**
+	 * Queues a line, without a newline, to be written
+	 * Returns false if the line was dropped because this thread's ring is full
+	 */
+	bool write(SGLPrintChannel channel, std::string_view line);
+
+	/**
+	 * Builds a line out of strings and numbers and queues it
+	 */
+	template <class... T>
+	bool write_line(SGLPrintChannel channel, const T&... parts)
+	{
+		thread_local std::string line;
+		line.clear();
+		(append_text(line, parts), ...);
+		return write(channel, line);
+	}
+
+	/**
+	 * Waits until every line queued before the call has been handed to the writer
+	 */
+	void flush();
+
+	/**
+	 * Replaces what lines are written with, it's called on the writer thread
+	 */
+	void set_writer(SGLPrintWriter writer);
+
+	/**
+	 * Returns the number of lines dropped because a ring was full
+	 */
+	std::size_t get_dropped_count() const
+	{
+		return _dropped.load(std::memory_order_relaxed);
+	}
+
+private:
+
+	/**
+	 * Lines written by one thread and not yet drained
+	 * Each line is an 8 byte header, its length then its channel, followed by its characters
+	 * Only the thread that owns the ring moves Head and only the writer thread moves Tail
+	 */
+	struct Ring
+	{
+		std::unique_ptr<char[]> Memory{ new char[SGL_PRINT_RING_SIZE] };
+		// Total bytes ever written, the next write goes at Head % SGL_PRINT_RING_SIZE
+		std::atomic<std::size_t> Head{ 0 };
+		// Total bytes ever drained
+		std::atomic<std::size_t> Tail{ 0 };
+		// True while a thread owns the ring, rings of threads that have exited are handed to new ones
+		std::atomic<bool> InUse{ true };
+	};
+
+	/**
+	 * Returns the calling thread's ring, taking one the first time the thread writes
+	 */
+	Ring& get_thread_ring();
+
+	/**
+	 * Moves every line waiting in the rings into the batches
+	 * Returns true if there were any
+	 */
+	bool drain();
+
+	/**
+	 * Body of the writer thread
+	 */
+	void run();
+
+	// Told apart from sinks that used to be at the same address, for the thread's cached ring
+	std::uint64_t _id;
+	// Every ring handed out so far
+	std::vector<std::unique_ptr<Ring>> _rings;
+	// Guards _rings
+	std::mutex _ringsMutex;
+
+	// Lines drained but not written yet, one batch per channel
+	std::string _batches[2];
+	// Writes batches out
+	SGLPrintWriter _writer;
+	// Guards _writer
+	std::mutex _writerMutex;
+
+	// Number of drain passes the writer thread has finished
+	std::uint64_t _passes = 0;
+	// True once the writer thread should stop
+	bool _stop = false;
+	// Guards _passes and _stop
+	std::mutex _stateMutex;
+	// Wakes the writer thread early
+	std::condition_variable _wake;
+	// Signalled after every pass, for flush
+	std::condition_variable _passed;
+
+	// Lines dropped because their ring was full
+	std::atomic<std::size_t> _dropped{ 0 };
+	// Dropped lines already reported
+	std::size_t _droppedReported = 0;
+
+	std::thread _thread;
+
+};
+
+/**
+ * Returns the sink print and the VM's diagnostics go to
+ */
+inline SGLPrintSink& get_print_sink()
+{
+	static SGLPrintSink sink;
+	return sink;
+}
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "SGLString.h"
+
+#include "Allocator.h"
+#include "PrintSink.h"
+
+namespace
+{
+	/**
+	 * Returns a string made of 'left' followed by 'right', see concat_strings
+	 */
+	SGLString make_string(std::string_view left, std::string_view right, SGLAllocator& temporaries)
+	{
+		std::size_t length = left.size() + right.size();
+
+		// short results stay inline, so they're still equal by their bytes
+		if (length <= SGL_STRING_INLINE_CAPACITY)
+		{
+			SGLString str;
+			std::memcpy(str.Bytes, left.data(), left.size());
+			std::memcpy(str.Bytes + left.size(), right.data(), right.size());
+			str.Bytes[15] = static_cast<std::uint8_t>(length);
+			return str;
+		}
+
+		auto* chars = static_cast<char*>(temporaries.allocate(length, 1));
+		if (!chars)
+		{
+			get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Out of memory for a string of ", length, " characters");
+			return {};
+		}
+
+		std::memcpy(chars, left.data(), left.size());
+		std::memcpy(chars + left.size(), right.data(), right.size());
+		return SGLString::make_pointer(chars, length, SGLString::TEMPORARY);
+	}
+}
+
+SGLString SGLStringTable::intern(std::string_view chars)
+{
+	if (chars.size() <= SGL_STRING_INLINE_CAPACITY)
+	{
+		return SGLString::make_inline(chars);
+	}
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	auto existing = _lookup.find(chars);
+	if (existing == _lookup.end())
+	{
+		_strings.emplace_back(chars);
+		existing = _lookup.insert(_strings.back()).first;
+	}
+
+	return SGLString::make_pointer(existing->data(), existing->size(), SGLString::INTERNED);
+}
+
+std::size_t SGLStringTable::get_string_count() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _strings.size();
+}
+
+SGLStringStore::SGLStringStore(SGLAllocator& allocator)
+	: _allocator(&allocator)
+{}
+
+SGLStringStore::SGLStringStore(SGLStringStore&& other) noexcept
+	: _allocator(other._allocator)
+	, _buffers(std::move(other._buffers))
+	, _byteCount(other._byteCount)
+	, _call(other._call)
+	, _callDepth(other._callDepth)
+{
+	other._buffers.clear();
+	other._byteCount = 0;
+}
+
+SGLStringStore& SGLStringStore::operator=(SGLStringStore&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		_allocator = other._allocator;
+		_buffers = std::move(other._buffers);
+		_byteCount = other._byteCount;
+		_call = other._call;
+		_callDepth = other._callDepth;
+
+		other._buffers.clear();
+		other._byteCount = 0;
+	}
+	return *this;
+}
+
+SGLStringStore::~SGLStringStore()
+{
+	release();
+}
+
+SGLString SGLStringStore::replace(std::uint16_t offset, const SGLString& previous, const SGLString& str)
+{
+	std::vector<Buffer>& buffers = _buffers[offset];
+
+	// code in this call may have loaded the old value, so its buffer waits for a later call
+	if (previous.Bytes[15] == SGLString::KEPT)
+	{
+		const char* chars = previous.view().data();
+		for (Buffer& buffer : buffers)
+		{
+			if (buffer.Chars == chars)
+			{
+				buffer.LastCall = _call;
+				break;
+			}
+		}
+	}
+
+	if (str.is_canonical())
+	{
+		return str;
+	}
+
+	// kept strings are copied too, the global they came from reuses its buffers
+	std::string_view chars = str.view();
+	Buffer* target = nullptr;
+	for (Buffer& buffer : buffers)
+	{
+		if (buffer.LastCall != _call && buffer.Capacity >= chars.size())
+		{
+			target = &buffer;
+			break;
+		}
+	}
+
+	if (!target)
+	{
+		// free buffers that are too small are only going to be passed over, so this one takes their place
+		for (std::size_t i = buffers.size(); i-- > 0;)
+		{
+			if (buffers[i].LastCall != _call)
+			{
+				_allocator->deallocate(buffers[i].Chars, buffers[i].Capacity);
+				_byteCount -= buffers[i].Capacity;
+				buffers.erase(buffers.begin() + i);
+			}
+		}
+
+		auto* memory = static_cast<char*>(_allocator->allocate(chars.size(), 1));
+		if (!memory)
+		{
+			get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Out of memory for a string of ", chars.size(), " characters");
+			return {};
+		}
+
+		buffers.push_back({ memory, static_cast<std::uint32_t>(chars.size()), _call });
+		_byteCount += chars.size();
+		target = &buffers.back();
+	}
+
+	std::memcpy(target->Chars, chars.data(), chars.size());
+	_allocator->mark_written(target->Chars, chars.size());
+	target->LastCall = _call;
+	return SGLString::make_pointer(target->Chars, chars.size(), SGLString::KEPT);
+}
+
+void SGLStringStore::begin_call()
+{
+	if (_callDepth++ == 0)
+	{
+		++_call;
+	}
+}
+
+void SGLStringStore::end_call()
+{
+	--_callDepth;
+}
+
+std::size_t SGLStringStore::get_string_count() const
+{
+	std::size_t count = 0;
+	for (const auto& buffers : _buffers)
+	{
+		count += buffers.second.size();
+	}
+	return count;
+}
+
+void SGLStringStore::release()
+{
+	for (const auto& buffers : _buffers)
+	{
+		for (const Buffer& buffer : buffers.second)
+		{
+			_allocator->deallocate(buffer.Chars, buffer.Capacity);
+		}
+	}
+
+	_buffers.clear();
+	_byteCount = 0;
+}
+
+SGLString concat_strings(const SGLString& lh, const SGLString& rh, SGLAllocator& temporaries)
+{
+	return make_string(lh.view(), rh.view(), temporaries);
+}
+
+SGLString make_temporary_string(std::string_view chars, SGLAllocator& temporaries)
+{
+	return make_string(chars, {}, temporaries);
+}
\ No newline at end of file
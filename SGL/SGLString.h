@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class SGLAllocator;
+
+// Longest string held inside the value itself, anything longer points at its characters
+constexpr std::size_t SGL_STRING_INLINE_CAPACITY = 15;
+
+/**
+ * In-memory form of the SGL string type, 16 bytes like a vector so it moves the same way
+ *
+ * Strings of up to 15 characters live in the value, with their length in the last byte. Longer
+ * strings hold a pointer and a length, and the last byte says where the characters are: interned
+ * strings are in the string table and live as long as the program, temporary ones are in the
+ * temporaries of the call that made them (see VirtualMachine::get_temporaries), and kept ones are
+ * in a buffer of the global that holds them, in its script instance's string store.
+ *
+ * Every string short enough to be inline is, and the table holds one copy of each interned string,
+ * so two inline or interned strings are equal exactly when their 16 bytes are.
+ */
+struct alignas(16) SGLString
+{
+	// Characters then length of an inline string, or pointer, length, padding then kind of a longer one
+	std::uint8_t Bytes[16] = {};
+
+	// Kinds of longer strings, kept in the last byte, above any inline length
+	static constexpr std::uint8_t KEPT = 0x20;
+	static constexpr std::uint8_t INTERNED = 0x40;
+	static constexpr std::uint8_t TEMPORARY = 0x80;
+
+	/**
+	 * Makes an inline string, the characters must fit in SGL_STRING_INLINE_CAPACITY
+	 */
+	static SGLString make_inline(std::string_view chars)
+	{
+		SGLString str;
+		std::memcpy(str.Bytes, chars.data(), chars.size());
+		str.Bytes[15] = static_cast<std::uint8_t>(chars.size());
+		return str;
+	}
+
+	/**
+	 * Makes a string that points at characters held somewhere else
+	 */
+	static SGLString make_pointer(const char* chars, std::size_t length, std::uint8_t kind)
+	{
+		SGLString str;
+		std::uint32_t length32 = static_cast<std::uint32_t>(length);
+		std::memcpy(str.Bytes, &chars, sizeof(chars));
+		std::memcpy(str.Bytes + 8, &length32, sizeof(length32));
+		str.Bytes[15] = kind;
+		return str;
+	}
+
+	/**
+	 * Returns true if the characters are held in the value
+	 */
+	bool is_inline() const
+	{
+		return Bytes[15] <= SGL_STRING_INLINE_CAPACITY;
+	}
+
+	/**
+	 * Returns true if the characters are in a call's temporaries and go away when it returns
+	 */
+	bool is_temporary() const
+	{
+		return Bytes[15] == TEMPORARY;
+	}
+
+	/**
+	 * Returns true if the string is inline or interned, so its bytes alone say what its characters are
+	 */
+	bool is_canonical() const
+	{
+		return is_inline() || Bytes[15] == INTERNED;
+	}
+
+	/**
+	 * Returns the number of characters
+	 */
+	std::size_t length() const
+	{
+		if (is_inline())
+		{
+			return Bytes[15];
+		}
+
+		std::uint32_t length;
+		std::memcpy(&length, Bytes + 8, sizeof(length));
+		return length;
+	}
+
+	/**
+	 * Returns the characters, which aren't null terminated
+	 */
+	std::string_view view() const
+	{
+		if (is_inline())
+		{
+			return { reinterpret_cast<const char*>(Bytes), Bytes[15] };
+		}
+
+		const char* chars;
+		std::memcpy(&chars, Bytes, sizeof(chars));
+		return { chars, length() };
+	}
+
+	/**
+	 * Strings are equal if their characters are
+	 * Only needs to look at the characters when one side isn't canonical, see above
+	 */
+	friend bool operator==(const SGLString& lh, const SGLString& rh)
+	{
+		if (std::memcmp(lh.Bytes, rh.Bytes, sizeof(lh.Bytes)) == 0)
+		{
+			return true;
+		}
+
+		if (lh.is_canonical() && rh.is_canonical())
+		{
+			return false;
+		}
+
+		return lh.view() == rh.view();
+	}
+
+	friend bool operator!=(const SGLString& lh, const SGLString& rh)
+	{
+		return !(lh == rh);
+	}
+};
+
+/**
+ * One copy of every long string that has been interned, shared by every script
+ *
+ * String literals are interned when they're compiled or loaded, so the same literal in any
+ * function of any script is the same pointer. Interned strings are never freed, so strings made at
+ * runtime aren't interned, a global keeps its strings in its instance's SGLStringStore instead.
+ */
+class SGLStringTable
+{
+public:
+
+	/**
+	 * Returns the interned string with the given characters, adding it if it's new
+	 * Short strings are returned inline and never touch the table
+	 */
+	SGLString intern(std::string_view chars);
+
+	/**
+	 * Returns the number of strings in the table
+	 */
+	std::size_t get_string_count() const;
+
+private:
+
+	// Characters of every interned string, deque so they never move
+	std::deque<std::string> _strings;
+	// Views of _strings, for lookups
+	std::unordered_set<std::string_view> _lookup;
+	// Guards the table, since functions compiled lazily intern on whatever thread calls them
+	mutable std::mutex _mutex;
+
+};
+
+/**
+ * Returns the string table
+ */
+inline SGLStringTable& get_string_table()
+{
+	static SGLStringTable table;
+	return table;
+}
+
+/**
+ * The long strings stored into one script instance's globals
+ *
+ * Each string global gets its own buffers, taken from the allocator the instance's globals came
+ * from, and a store copies the string into one of them so it outlives the call. A store replaces
+ * what the global held, and the buffer that held it is reused by a later store to the same global.
+ * Code may still be holding the old value until the call that replaced it returns, so a buffer is
+ * only reused by a later call, which bounds the memory a global takes to what one call stores to it
+ * plus what it holds. Since the buffers are in the same allocator as the globals, a SGLStateRegion
+ * snapshot has the characters too, and restoring it brings back the strings its globals point at.
+ * Not synchronized, an instance is only run by one VM at a time.
+ */
+class SGLStringStore
+{
+public:
+
+	/**
+	 * Creates a store that keeps its strings in 'allocator', which has to outlive it
+	 */
+	explicit SGLStringStore(SGLAllocator& allocator);
+
+	SGLStringStore(SGLStringStore&& other) noexcept;
+	SGLStringStore& operator=(SGLStringStore&& other) noexcept;
+
+	SGLStringStore(const SGLStringStore&) = delete;
+	SGLStringStore& operator=(const SGLStringStore&) = delete;
+
+	~SGLStringStore();
+
+	/**
+	 * Returns the string to write to the global at 'offset' in place of 'previous', copying it into
+	 * one of the global's buffers unless it's inline or interned
+	 * Returns an empty string if the allocator is out of memory
+	 */
+	SGLString replace(std::uint16_t offset, const SGLString& previous, const SGLString& str);
+
+	/**
+	 * Called by the VM around each call into the instance, calls made from inside a call count as part of it
+	 */
+	void begin_call();
+	void end_call();
+
+	/**
+	 * Returns the number of buffers in the store
+	 */
+	std::size_t get_string_count() const;
+
+	/**
+	 * Returns the number of characters the store's buffers can hold
+	 */
+	std::size_t get_byte_count() const
+	{
+		return _byteCount;
+	}
+
+private:
+
+	/**
+	 * Characters of one string a global holds or held
+	 */
+	struct Buffer
+	{
+		char* Chars = nullptr;
+		std::uint32_t Capacity = 0;
+		// Call that last stored to or replaced this, the buffer isn't reused until a later one
+		std::uint32_t LastCall = 0;
+	};
+
+	/**
+	 * Frees every buffer
+	 */
+	void release();
+
+	// Where the buffers come from
+	SGLAllocator* _allocator;
+	// Buffers of each string global, by the global's offset
+	std::unordered_map<std::uint16_t, std::vector<Buffer>> _buffers;
+	// Total capacity of the buffers
+	std::size_t _byteCount = 0;
+	// Number of the outermost call running, or the last one that ran
+	std::uint32_t _call = 0;
+	// How many calls into the instance are running, more than one if a native calls back into it
+	std::uint32_t _callDepth = 0;
+
+};
+
+/**
+ * Returns 'lh' followed by 'rh'
+ * A result too long to be inline is a temporary string whose characters are taken from 'temporaries'
+ * Returns an empty string if 'temporaries' is out of memory
+ */
+SGLString concat_strings(const SGLString& lh, const SGLString& rh, SGLAllocator& temporaries);
+
+/**
+ * Returns a temporary copy of the characters, for natives that build strings to hand back to a script
+ * Returns an empty string if 'temporaries' is out of memory
+ */
+SGLString make_temporary_string(std::string_view chars, SGLAllocator& temporaries);
\ No newline at end of file
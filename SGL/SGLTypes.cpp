@@ -1,14 +1,216 @@
 #include "SGLTypes.h"
 
+#include "SGLString.h"
+#include "VectorMath.h"
+
+namespace
+{
+	/**
+	 * Returns the description of a built-in type
+	 */
+	constexpr SGLType make_builtin_type(std::string_view name, int size, int alignment, SGLBuiltinType id)
+	{
+		SGLType type;
+		type.TypeName = name;
+		type.TypeSize = size;
+		type.TypeAlignment = alignment;
+		type.TypeId = id;
+		return type;
+	}
+
+	// The built-in types, order must match SGLBuiltinType
+	constexpr SGLType g_builtin_types[SGL_BUILTIN_TYPE_COUNT] =
+	{
+		make_builtin_type("int32", sizeof(std::int32_t), alignof(std::int32_t), SGL_TYPE_INT32),
+		make_builtin_type("float", sizeof(float), alignof(float), SGL_TYPE_FLOAT),
+		make_builtin_type("int64", sizeof(std::int64_t), alignof(std::int64_t), SGL_TYPE_INT64),
+		make_builtin_type("double", sizeof(double), alignof(double), SGL_TYPE_DOUBLE),
+		make_builtin_type("vec2", sizeof(SGLVector), alignof(SGLVector), SGL_TYPE_VEC2),
+		make_builtin_type("vec3", sizeof(SGLVector), alignof(SGLVector), SGL_TYPE_VEC3),
+		make_builtin_type("vec4", sizeof(SGLVector), alignof(SGLVector), SGL_TYPE_VEC4),
+		make_builtin_type("string", sizeof(SGLString), alignof(SGLString), SGL_TYPE_STRING),
+		// "void" is special, it has no size
+		make_builtin_type("void", 0, 0, SGL_TYPE_VOID),
+	};
+}
+
+SGLTypeRegistry::SGLTypeRegistry()
+	: _builtinTypes(g_builtin_types)
+{}
+
+bool SGLTypeRegistry::mount_static_types(const SGLTypeTable& table)
+{
+	if (_staticTypes.Count != 0 || !_types.empty())
+	{
+		std::cerr << "Static types must be mounted once, before any type is registered at runtime" << std::endl;
+		return false;
+	}
+
+	if (table.FirstId != SGL_BUILTIN_TYPE_COUNT || table.Count > static_cast<std::size_t>(SGL_INVALID_TYPE_ID) - static_cast<std::size_t>(table.FirstId))
+	{
+		std::cerr << "Static type table has IDs that don't follow the built-in types" << std::endl;
+		return false;
+	}
+
+	// the table is sorted, so duplicates sit next to each other
+	for (std::size_t i = 0; i < table.Count; ++i)
+	{
+		const SGLType& type = table.Types[i];
+		if ((i > 0 && table.Types[i - 1].TypeName == type.TypeName) || find_type_id(type.TypeName) != SGL_INVALID_TYPE_ID)
+		{
+			std::cerr << "Static type " << type.TypeName << " is already registered" << std::endl;
+			return false;
+		}
+	}
+
+	_staticTypes = table;
+	_firstRuntimeId = static_cast<SGLTypeId>(table.FirstId + table.Count);
+
+	for (std::size_t i = 0; i < table.Count; ++i)
+	{
+		if (table.Types[i].PointerTypeId)
+		{
+			*table.Types[i].PointerTypeId = table.Types[i].TypeId;
+		}
+	}
+
+	return true;
+}
+
+SGLTypeId SGLTypeRegistry::register_type(const std::string& specifier, int size, int alignment)
+{
+	SGLTypeId existing = find_type_id(specifier);
+	if (existing != SGL_INVALID_TYPE_ID)
+	{
+		return existing;
+	}
+
+	if (get_type_count() >= SGL_INVALID_TYPE_ID)
+	{
+		std::cerr << "Too many types registered, unable to register " << specifier << std::endl;
+		return SGL_INVALID_TYPE_ID;
+	}
+
+	_names.push_back(specifier);
+
+	SGLType type;
+	type.TypeName = _names.back();
+	type.TypeSize = size;
+	type.TypeAlignment = alignment;
+	type.TypeId = static_cast<SGLTypeId>(get_type_count());
+
+	_types.push_back(type);
+	_fields.emplace_back();
+	_ids[type.TypeName] = type.TypeId;
+
+	return type.TypeId;
+}
+
+SGLTypeId SGLTypeRegistry::register_object_type(const std::string& specifier, int size, int alignment)
+{
+	bool isNew = find_type_id(specifier) == SGL_INVALID_TYPE_ID;
+
+	SGLTypeId id = register_type(specifier, size, alignment);
+	if (id == SGL_INVALID_TYPE_ID)
+	{
+		return id;
+	}
+
+	// an existing value type can't change into a pointer behind the compiler's back
+	if (!isNew && !get_type(id).IsNativeObject)
+	{
+		std::cerr << "Type " << specifier << " is already registered as a value type" << std::endl;
+		return SGL_INVALID_TYPE_ID;
+	}
+
+	if (isNew)
+	{
+		_types[id - _firstRuntimeId].IsNativeObject = true;
+	}
+
+	return id;
+}
+
+bool SGLTypeRegistry::register_field(SGLTypeId owner, const std::string& name, std::size_t offset, SGLTypeId fieldType)
+{
+	if (!get_type(owner).IsNativeObject)
+	{
+		std::cerr << "Field " << name << " belongs to a type that isn't registered as a native object" << std::endl;
+		return false;
+	}
+	else if (owner < _firstRuntimeId)
+	{
+		std::cerr << "Field " << name << " can't be added to " << get_type(owner).TypeName << ", static types are fixed" << std::endl;
+		return false;
+	}
+
+	SGLType& type = _types[owner - _firstRuntimeId];
+	if (type.find_field(name))
+	{
+		std::cerr << type.TypeName << " already has a field named " << name << std::endl;
+		return false;
+	}
+
+	// fields are read straight out of the object, so only scalars the VM moves as one value are allowed
+	if (fieldType != SGL_TYPE_INT32 && fieldType != SGL_TYPE_FLOAT && fieldType != SGL_TYPE_INT64 && fieldType != SGL_TYPE_DOUBLE)
+	{
+		std::cerr << "Field " << type.TypeName << "." << name << " must be an int32, float, int64 or double" << std::endl;
+		return false;
+	}
+
+	if (offset > SGL_MAX_FIELD_OFFSET || offset + get_type(fieldType).TypeSize > static_cast<std::size_t>(type.TypeSize))
+	{
+		std::cerr << "Field " << type.TypeName << "." << name << " at offset " << offset << " is out of reach" << std::endl;
+		return false;
+	}
+
+	_names.push_back(name);
+
+	SGLField field;
+	field.Name = _names.back();
+	field.Offset = static_cast<std::uint32_t>(offset);
+	field.Type = fieldType;
+
+	// kept sorted so find_field can binary search, the same as static types
+	auto& fields = _fields[owner - _firstRuntimeId];
+	fields.insert(std::upper_bound(fields.begin(), fields.end(), field, [](const SGLField& lh, const SGLField& rh)
+	{
+		return lh.Name < rh.Name;
+	}), field);
+
+	type.Fields = fields.data();
+	type.FieldCount = fields.size();
+
+	return true;
+}
+
+SGLTypeId SGLTypeRegistry::find_type_id(std::string_view specifier) const
+{
+	// few enough built-in types that a scan beats sorting them
+	for (std::size_t i = 0; i < SGL_BUILTIN_TYPE_COUNT; ++i)
+	{
+		if (_builtinTypes[i].TypeName == specifier)
+		{
+			return _builtinTypes[i].TypeId;
+		}
+	}
+
+	SGLTypeId id = _staticTypes.find_type_id(specifier);
+	if (id != SGL_INVALID_TYPE_ID)
+	{
+		return id;
+	}
+
+	auto it = _ids.find(specifier);
+	if (it == _ids.end())
+	{
+		return SGL_INVALID_TYPE_ID;
+	}
+
+	return it->second;
+}
+
 void register_datatypes()
 {
-	register_type<int>("int32");
-	register_type<float>("float");
-	
-	// registering the "void" type is special
-	SGLType voidType;
-	voidType.TypeAlignment = 0;
-	voidType.TypeSize = 0;
-	voidType.TypeName = "void";
-	get_types()["void"] = voidType;
+	get_type_registry();
 }
\ No newline at end of file
@@ -1,29 +1,327 @@
 #pragma once
 
+#include <cstddef>
+#include <array>
+#include <cstdint>
+#include <deque>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "Helpers.h"
 
 // SGL type definitions and registration
 
+/**
+ * Every registered type gets a dense integer ID in the order it was registered
+ * IDs are what the compiler and VM compare, names are only used to look a type up from source
+ */
+using SGLTypeId = std::uint16_t;
+
+// ID held by types that were never registered
+constexpr SGLTypeId SGL_INVALID_TYPE_ID = std::numeric_limits<SGLTypeId>::max();
+
+/**
+ * IDs of the built-in types
+ * The registry always registers these first and in this order, so they are usable as table indices
+ */
+enum SGLBuiltinType : SGLTypeId
+{
+	// 32-bit signed int
+	SGL_TYPE_INT32,
+	// 32-bit float
+	SGL_TYPE_FLOAT,
+	// 64-bit signed int
+	SGL_TYPE_INT64,
+	// 64-bit float
+	SGL_TYPE_DOUBLE,
+	// 2, 3 and 4 lane float vectors, all stored as 16 aligned bytes
+	SGL_TYPE_VEC2,
+	SGL_TYPE_VEC3,
+	SGL_TYPE_VEC4,
+	// text, stored inline or as a pointer to its characters, see SGLString
+	SGL_TYPE_STRING,
+	// typeless expression (mainly used internally)
+	SGL_TYPE_VOID,
+	// Number of built-in types
+	SGL_BUILTIN_TYPE_COUNT
+};
+
+struct SGLString;
+
+// Size of a native object pointer held by a script value, the same on 32 and 64-bit hosts so frames are too
+constexpr int SGL_OBJECT_REFERENCE_SIZE = 8;
+
+// Largest byte offset a field can be at, field instructions hold a 16-bit offset
+constexpr std::size_t SGL_MAX_FIELD_OFFSET = 65535;
+
+/**
+ * Returns the number of lanes of a vector type, or 0 if the type isn't a vector
+ */
+inline std::uint8_t get_vector_lanes(SGLTypeId type)
+{
+	return (type >= SGL_TYPE_VEC2 && type <= SGL_TYPE_VEC4) ? static_cast<std::uint8_t>(type - SGL_TYPE_VEC2 + 2) : 0;
+}
+
+/**
+ * A field of a native object type, read and written in place through the object's pointer
+ * Plain constant data, so the fields of static types can be built at compile time
+ */
+struct SGLField
+{
+	// Name of the field as it is written in SGL
+	std::string_view Name;
+	// Byte offset of the field from the start of the object
+	std::uint32_t Offset = 0;
+	// Type of the field, always a scalar
+	SGLTypeId Type = SGL_INVALID_TYPE_ID;
+};
+
 /**
  * Holds information pertaining to an SGL type
+ * Plain constant data, so the built-in types and static type tables are built at compile time
+ * Names and fields of types registered at runtime are owned by the registry
  */
 struct SGLType
 {
 	// Name of the type as it is written in SGL
-	std::string TypeName = "";
+	std::string_view TypeName = "";
 	// Size of the type in bytes
 	int TypeSize = 0;
 	// Byte alignment required by the type
 	int TypeAlignment = 0;
+	// ID assigned when the type was registered
+	SGLTypeId TypeId = SGL_INVALID_TYPE_ID;
+	// True for C++ types that scripts only ever hold a pointer to
+	bool IsNativeObject = false;
+	// Fields scripts can reach through a pointer to a native object, sorted by name
+	const SGLField* Fields = nullptr;
+	// Number of fields
+	std::size_t FieldCount = 0;
+	// Where the ID of pointers to the C++ type is kept, filled in when a static table is mounted
+	SGLTypeId* PointerTypeId = nullptr;
+
+	/**
+	 * Returns true if the type is registered
+	 */
+	bool is_valid() const
+	{
+		return TypeId != SGL_INVALID_TYPE_ID;
+	}
+
+	/**
+	 * Returns the number of bytes a value of the type takes up in a frame or on the stack
+	 * Native objects stay where the host put them, so their values are pointers
+	 */
+	int get_value_size() const
+	{
+		return IsNativeObject ? SGL_OBJECT_REFERENCE_SIZE : TypeSize;
+	}
+
+	/**
+	 * Returns the alignment of a value of the type, see get_value_size
+	 */
+	int get_value_alignment() const
+	{
+		return IsNativeObject ? SGL_OBJECT_REFERENCE_SIZE : TypeAlignment;
+	}
+
+	/**
+	 * Returns the field with the given name, or nullptr if the type has no such field
+	 */
+	const SGLField* find_field(std::string_view name) const
+	{
+		const SGLField* end = Fields + FieldCount;
+		const SGLField* field = std::lower_bound(Fields, end, name, [](const SGLField& field, std::string_view name)
+		{
+			return field.Name < name;
+		});
+
+		return (field != end && field->Name == name) ? field : nullptr;
+	}
+
+	/**
+	 * Comparison operators, types are the same if their IDs are
+	 */
+	friend bool operator==(const SGLType& lh, const SGLType& rh)
+	{
+		return lh.TypeId == rh.TypeId;
+	}
+
+	friend bool operator!=(const SGLType& lh, const SGLType& rh)
+	{
+		return lh.TypeId != rh.TypeId;
+	}
+};
+
+/**
+ * A table of types whose IDs follow on from another table's
+ * Views constant data, the registry never copies or frees what it points to
+ */
+struct SGLTypeTable
+{
+	// Types sorted by name, each type's ID is FirstId plus its index
+	const SGLType* Types = nullptr;
+	// Number of types in the table
+	std::size_t Count = 0;
+	// ID of the first type
+	SGLTypeId FirstId = 0;
+
+	/**
+	 * Returns the ID of the type with the given name, or SGL_INVALID_TYPE_ID if the table doesn't have it
+	 */
+	SGLTypeId find_type_id(std::string_view specifier) const
+	{
+		const SGLType* end = Types + Count;
+		const SGLType* type = std::lower_bound(Types, end, specifier, [](const SGLType& type, std::string_view name)
+		{
+			return type.TypeName < name;
+		});
+
+		return (type != end && type->TypeName == specifier) ? type->TypeId : SGL_INVALID_TYPE_ID;
+	}
 };
 
-// Map of registered types and their specifiers
-inline std::unordered_map<std::string, SGLType>& get_types()
+/**
+ * Types described entirely at compile time, see make_static_type_table
+ */
+template <std::size_t N>
+struct SGLStaticTypeTable
+{
+	// Types sorted by name, IDs start right after the built-in types
+	std::array<SGLType, N> Types;
+
+	/**
+	 * Returns a view of the table for the registry
+	 */
+	SGLTypeTable get_table() const
+	{
+		return { Types.data(), N, SGL_BUILTIN_TYPE_COUNT };
+	}
+};
+
+/**
+ * The one list of types shared by the compilers and the VM
+ *
+ * Types come from up to three places, in ID order: the built-in types, one static table mounted
+ * at startup, and types registered at runtime. The first two are constant data that is searched
+ * in place, so they cost nothing to set up. Only runtime registration allocates and hashes.
+ */
+class SGLTypeRegistry
 {
-	static std::unordered_map<std::string, SGLType> map;
-	return map;
+public:
+
+	/**
+	 * Creates the registry with the built-in types already registered
+	 */
+	SGLTypeRegistry();
+
+	/**
+	 * Mounts a table of types built at compile time, which then behave like registered types
+	 * Only one table can be mounted, and only before any type is registered at runtime, since
+	 * the table's IDs were fixed when it was built
+	 * Returns false if the table can't be mounted or a name in it is taken
+	 */
+	bool mount_static_types(const SGLTypeTable& table);
+
+	template <std::size_t N>
+	bool mount_static_types(const SGLStaticTypeTable<N>& table)
+	{
+		return mount_static_types(table.get_table());
+	}
+
+	/**
+	 * Registers a new type and returns its ID
+	 * If the specifier is already taken, the existing type's ID is returned instead
+	 */
+	SGLTypeId register_type(const std::string& specifier, int size, int alignment);
+
+	/**
+	 * Registers a new type with the size and alignment of T
+	 */
+	template <typename T>
+	SGLTypeId register_type(const std::string& specifier)
+	{
+		return register_type(specifier, sizeof(T), alignof(T));
+	}
+
+	/**
+	 * Registers a C++ type that scripts hold pointers to and reach into through its fields
+	 * If the specifier is already taken, the existing type's ID is returned instead
+	 */
+	SGLTypeId register_object_type(const std::string& specifier, int size, int alignment);
+
+	/**
+	 * Adds a field to a native object type
+	 * Returns false if the type isn't a native object, the name is taken, or the field can't be reached
+	 */
+	bool register_field(SGLTypeId owner, const std::string& name, std::size_t offset, SGLTypeId fieldType);
+
+	/**
+	 * Returns the ID for the given specifier, or SGL_INVALID_TYPE_ID if it isn't registered
+	 */
+	SGLTypeId find_type_id(std::string_view specifier) const;
+
+	/**
+	 * Returns the type with the given ID, or an invalid type if the ID is out of range
+	 */
+	const SGLType& get_type(SGLTypeId id) const
+	{
+		if (id < SGL_BUILTIN_TYPE_COUNT)
+		{
+			return _builtinTypes[id];
+		}
+
+		if (id < _firstRuntimeId)
+		{
+			return _staticTypes.Types[id - _staticTypes.FirstId];
+		}
+
+		std::size_t index = id - _firstRuntimeId;
+		return index < _types.size() ? _types[index] : _invalidType;
+	}
+
+	/**
+	 * Returns the number of registered types
+	 */
+	std::size_t get_type_count() const
+	{
+		return _firstRuntimeId + _types.size();
+	}
+
+private:
+
+	// The built-in types, indexed by ID
+	const SGLType* _builtinTypes;
+	// Types of the mounted static table, empty if there is none
+	SGLTypeTable _staticTypes;
+	// ID of the first type registered at runtime
+	SGLTypeId _firstRuntimeId = SGL_BUILTIN_TYPE_COUNT;
+
+	// Types registered at runtime, indexed by ID minus _firstRuntimeId
+	// deque so references handed out by get_type stay valid as more types are registered
+	std::deque<SGLType> _types;
+	// Fields of types registered at runtime, parallel to _types
+	std::deque<std::vector<SGLField>> _fields;
+	// Storage for the names of types and fields registered at runtime, which SGLType and SGLField only view
+	std::deque<std::string> _names;
+	// Specifier -> ID lookup for types registered at runtime
+	std::unordered_map<std::string_view, SGLTypeId> _ids;
+	// Returned for unknown IDs and specifiers
+	SGLType _invalidType;
+
+};
+
+/**
+ * Returns the type registry
+ */
+inline SGLTypeRegistry& get_type_registry()
+{
+	static SGLTypeRegistry registry;
+	return registry;
 }
 
 /**
@@ -31,43 +329,194 @@ inline std::unordered_map<std::string, SGLType>& get_types()
  */
 inline bool is_type_registered(const std::string& specifier)
 {
-	if (get_types().count(specifier) > 0)
-	{
-		return true;
-	}
-	return false;
+	return get_type_registry().find_type_id(specifier) != SGL_INVALID_TYPE_ID;
+}
+
+/**
+ * Returns the type with the given ID
+ */
+inline const SGLType& get_type(SGLTypeId id)
+{
+	return get_type_registry().get_type(id);
+}
+
+/**
+ * Returns the type with the given name, or an invalid type if it isn't registered
+ */
+inline const SGLType& get_type(const std::string& specifier)
+{
+	const SGLTypeRegistry& registry = get_type_registry();
+	return registry.get_type(registry.find_type_id(specifier));
 }
 
 /**
  * Registers a new SGL type with the given specifier
  */
 template <typename T>
-void register_type(const std::string& specifier)
+SGLTypeId register_type(const std::string& specifier)
 {
 	// Check if type is already registered
 	if (is_type_registered(specifier))
 	{
 		std::cout << "Type with specifier " << specifier << " already registered." << std::endl;
-		return;
+		return get_type_registry().find_type_id(specifier);
+	}
+
+	return get_type_registry().register_type(specifier, sizeof(T), alignof(T));
+}
+
+/**
+ * Maps the C++ types natives and fields use to their SGL type
+ * Scalars map to built-in types, pointers to the native object type their pointee was registered as
+ */
+template <class T>
+struct SGLNativeType;
+
+template <> struct SGLNativeType<std::int32_t> { static constexpr SGLTypeId Id = SGL_TYPE_INT32; };
+template <> struct SGLNativeType<float> { static constexpr SGLTypeId Id = SGL_TYPE_FLOAT; };
+template <> struct SGLNativeType<std::int64_t> { static constexpr SGLTypeId Id = SGL_TYPE_INT64; };
+template <> struct SGLNativeType<double> { static constexpr SGLTypeId Id = SGL_TYPE_DOUBLE; };
+template <> struct SGLNativeType<SGLString> { static constexpr SGLTypeId Id = SGL_TYPE_STRING; };
+template <> struct SGLNativeType<void> { static constexpr SGLTypeId Id = SGL_TYPE_VOID; };
+
+template <class T>
+struct SGLNativeType<T*>
+{
+	// Set by register_object_type<T> or by mounting a static table with T in it, invalid until then
+	static inline SGLTypeId Id = SGL_INVALID_TYPE_ID;
+};
+
+// const pointers share the ID of plain ones
+template <class T>
+struct SGLNativeType<const T*> : SGLNativeType<T*> {};
+
+/**
+ * Registers a C++ type as a native object type scripts can hold pointers to
+ */
+template <typename T>
+SGLTypeId register_object_type(const std::string& specifier)
+{
+	SGLTypeId id = get_type_registry().register_object_type(specifier, sizeof(T), alignof(T));
+	if (id != SGL_INVALID_TYPE_ID)
+	{
+		SGLNativeType<T*>::Id = id;
 	}
 
-	// Create the new type
+	return id;
+}
+
+/**
+ * Registers a field of a native object type that was registered with register_object_type<T>
+ * The field's type comes from its C++ type, use SGL_REGISTER_FIELD to fill in the offset and type
+ */
+template <typename T, typename F>
+bool register_field(const std::string& name, std::size_t offset)
+{
+	return get_type_registry().register_field(SGLNativeType<T*>::Id, name, offset, SGLNativeType<F>::Id);
+}
+
+/**
+ * Describes a field of a native object type at compile time, see SGL_STATIC_FIELD
+ */
+template <typename T, typename F>
+constexpr SGLField make_static_field(std::string_view name, std::size_t offset)
+{
+	static_assert(sizeof(T) <= SGL_MAX_FIELD_OFFSET, "Fields of objects this big can't all be reached");
+
+	SGLField field;
+	field.Name = name;
+	field.Offset = static_cast<std::uint32_t>(offset);
+	field.Type = SGLNativeType<F>::Id;
+	return field;
+}
+
+/**
+ * Sorts the fields of a native object type by name at compile time, so lookups can binary search them
+ */
+template <class... T>
+constexpr std::array<SGLField, sizeof...(T)> make_static_fields(const T&... fields)
+{
+	return sort_constexpr(std::array<SGLField, sizeof...(T)>{ fields... }, [](const SGLField& lh, const SGLField& rh)
+	{
+		return lh.Name < rh.Name;
+	});
+}
+
+/**
+ * Describes a native object type at compile time, see SGL_STATIC_OBJECT_TYPE
+ */
+template <typename T>
+constexpr SGLType make_static_object_type(std::string_view name)
+{
 	SGLType type;
-	type.TypeName = specifier;
+	type.TypeName = name;
 	type.TypeSize = sizeof(T);
 	type.TypeAlignment = alignof(T);
-	// Add it to the type map
-	get_types()[specifier] = type;
+	type.IsNativeObject = true;
+	type.PointerTypeId = &SGLNativeType<T*>::Id;
+	return type;
+}
+
+/**
+ * 'fields' must outlive the program, which it does when it's a constexpr made by make_static_fields
+ */
+template <typename T, std::size_t N>
+constexpr SGLType make_static_object_type(std::string_view name, const std::array<SGLField, N>& fields)
+{
+	SGLType type = make_static_object_type<T>(name);
+	type.Fields = fields.data();
+	type.FieldCount = N;
+	return type;
+}
+
+/**
+ * Builds a table of types at compile time, sorted by name with IDs following the built-in types
+ * Mount it with get_type_registry().mount_static_types before registering anything at runtime
+ */
+template <class... T>
+constexpr SGLStaticTypeTable<sizeof...(T)> make_static_type_table(const T&... types)
+{
+	SGLStaticTypeTable<sizeof...(T)> table{ sort_constexpr(std::array<SGLType, sizeof...(T)>{ types... }, [](const SGLType& lh, const SGLType& rh)
+	{
+		return lh.TypeName < rh.TypeName;
+	}) };
+
+	for (std::size_t i = 0; i < sizeof...(T); ++i)
+	{
+		table.Types[i].TypeId = static_cast<SGLTypeId>(SGL_BUILTIN_TYPE_COUNT + i);
+	}
+
+	return table;
 }
 
 /**
  * Registers SGL's PODs:
- * int32 - 32-bit signed int
- * float - 32-bit float
- * bool  - true/false
- * void  - typeless expression (mainly used internally)
+ * int32  - 32-bit signed int
+ * float  - 32-bit float
+ * int64  - 64-bit signed int
+ * double - 64-bit float
+ * vec2   - 2 float vector
+ * vec3   - 3 float vector
+ * vec4   - 4 float vector
+ * string - text
+ * void   - typeless expression (mainly used internally)
+ *
+ * The built-in types are a constant table, so this only forces the registry to be created early
  */
 void register_datatypes();
 
 // Helper macro to register the type with a name exactly matching the C++ type's name
-#define SGL_REGISTER_TYPE(TYPE) register_type<TYPE>(#TYPE);
\ No newline at end of file
+#define SGL_REGISTER_TYPE(TYPE) register_type<TYPE>(#TYPE);
+
+// Helper macro to register a native object type with a name exactly matching the C++ type's name
+#define SGL_REGISTER_OBJECT_TYPE(TYPE) register_object_type<TYPE>(#TYPE);
+
+// Helper macro to register a field of a native object type under its C++ name
+#define SGL_REGISTER_FIELD(TYPE, FIELD) register_field<TYPE, decltype(TYPE::FIELD)>(#FIELD, offsetof(TYPE, FIELD));
+
+// Helper macro to describe a field of a native object type at compile time under its C++ name
+#define SGL_STATIC_FIELD(TYPE, FIELD) make_static_field<TYPE, decltype(TYPE::FIELD)>(#FIELD, offsetof(TYPE, FIELD))
+
+// Helper macro to describe a native object type at compile time under its C++ name
+// FIELDS is optional, and is a constexpr array of fields made by make_static_fields
+#define SGL_STATIC_OBJECT_TYPE(TYPE, ...) make_static_object_type<TYPE>(#TYPE, ##__VA_ARGS__)
\ No newline at end of file
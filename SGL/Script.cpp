@@ -0,0 +1,940 @@
+#include "Script.h"
+
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string_view>
+
+#include "Helpers.h"
+#include "Instructions.h"
+#include "NativeFunctions.h"
+#include "Stack.h"
+
+Script::Script()
+	: Script(std::make_shared<ConstantPool>())
+{}
+
+Script::Script(std::shared_ptr<ConstantPool> constants)
+	: _constants(std::move(constants))
+{}
+
+bool Script::add_function(SGL::FunctionData function, bool isCompiled)
+{
+	if (!_functionIndices.emplace(function.FunctionName, _functions.size()).second)
+	{
+		std::cerr << "Function " << function.FunctionName << " is declared more than once" << std::endl;
+		return false;
+	}
+
+	auto entry = std::make_unique<ScriptFunction>();
+	entry->Function = std::move(function);
+	entry->State = isCompiled ? BodyState::Compiled : BodyState::Deferred;
+
+	if (isCompiled)
+	{
+		// burn the flag so get_function never tries to compile it again
+		std::call_once(entry->CompileFlag, [] {});
+	}
+
+	_functions.push_back(std::move(entry));
+	return true;
+}
+
+bool Script::set_globals(std::vector<SGL::GlobalData> globals, std::vector<std::uint8_t> image)
+{
+	if (!_globals.empty())
+	{
+		std::cerr << "Script globals are already laid out" << std::endl;
+		return false;
+	}
+
+	// instances copy the block whole, padding included
+	image.resize((image.size() + SGL_STACK_ALIGNMENT - 1) & ~(SGL_STACK_ALIGNMENT - 1), 0);
+
+	_globals = std::move(globals);
+	_globalsImage = std::move(image);
+	return true;
+}
+
+std::size_t Script::find_function(const std::string& name) const
+{
+	auto found = _functionIndices.find(name);
+	return found != _functionIndices.end() ? found->second : SGL_INVALID_FUNCTION;
+}
+
+const SGL::FunctionData* Script::get_function(std::size_t index) const
+{
+	if (index >= _functions.size())
+	{
+		return nullptr;
+	}
+
+	auto& entry = _functions[index];
+
+	// call_once blocks any other caller until the first one finishes compiling
+	std::call_once(entry->CompileFlag, [this, &entry]
+	{
+		bool result = SGL::compile_function_body(entry->Function, *_constants, _globals);
+		entry->State = result ? BodyState::Compiled : BodyState::Failed;
+	});
+
+	if (entry->State != BodyState::Compiled)
+	{
+		return nullptr;
+	}
+
+	return &entry->Function;
+}
+
+std::size_t Script::get_compiled_function_count() const
+{
+	std::size_t count = 0;
+	for (const auto& entry : _functions)
+	{
+		if (entry->State == BodyState::Compiled)
+		{
+			++count;
+		}
+	}
+
+	return count;
+}
+
+std::size_t Script::get_deferred_function_count() const
+{
+	std::size_t count = 0;
+	for (const auto& entry : _functions)
+	{
+		if (entry->State == BodyState::Deferred)
+		{
+			++count;
+		}
+	}
+
+	return count;
+}
+
+/**
+ *****************************************************************
+ *						Bytecode images
+ *****************************************************************
+ *
+ * Layout, every number is in the byte order of the machine that wrote it:
+ *
+ * char[4]	"SGLB"
+ * u32		byte order mark, 0x01020304 as the writer saw it
+ * u32		format version
+ * u32		numeric constant count, followed by that many u32 words
+ * u32		string constant count, followed by that many strings
+ * u32		native function count, followed by that many native names, in the writer's registry order
+ * u32		global count, followed by that many globals: string name, string type, u32 offset
+ * u32		globals image size, image bytes
+ * u32		function count, followed by that many functions:
+ *			string name, string return type, u32 param count, (string type, string name) per param,
+ *			u32 frame size, u32 code size, code bytes
+ *
+ * Strings are a u32 length followed by the characters. Types and natives are written by name
+ * since their IDs and indices depend on the order they were registered in. Field offsets of
+ * native objects are baked into the code, so an image only suits hosts with the same object layouts.
+ * A function's max stack size and whether it writes globals aren't written, the loader works them out
+ * from the code it has checked rather than trusting the image with how much stack the VM reserves or
+ * which calls can change an instance.
+ */
+
+namespace
+{
+	// Identifies a bytecode image
+	constexpr char BYTECODE_MAGIC[4] = { 'S', 'G', 'L', 'B' };
+	// Written in the writer's byte order, reads back swapped if the reader's order differs
+	constexpr std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+	// Bumped whenever the layout changes
+	constexpr std::uint32_t BYTECODE_VERSION = 7;
+
+	/**
+	 * Appends values to a bytecode image
+	 */
+	struct BytecodeWriter
+	{
+		std::vector<std::uint8_t>& Out;
+
+		template <class T>
+		void write(const T& value)
+		{
+			auto pos = Out.size();
+			Out.resize(pos + sizeof(T));
+			store_to_buffer<T>(&Out[pos], sizeof(T), value);
+		}
+
+		void write_string(std::string_view str)
+		{
+			write<std::uint32_t>(static_cast<std::uint32_t>(str.size()));
+			Out.insert(Out.end(), str.begin(), str.end());
+		}
+	};
+
+	/**
+	 * Reads values out of a bytecode image, swapping them if the image's byte order isn't ours
+	 * Every read checks the bounds, a truncated image just makes the reads fail
+	 */
+	struct BytecodeReader
+	{
+		const std::uint8_t* Data;
+		std::size_t Size;
+		std::size_t Pos;
+		bool Swap;
+
+		template <class T>
+		bool read(T& value)
+		{
+			if (Size - Pos < sizeof(T))
+			{
+				return false;
+			}
+
+			value = read_from_buffer<T>(Data + Pos);
+			if (Swap)
+			{
+				value = swap_endian(value);
+			}
+
+			Pos += sizeof(T);
+			return true;
+		}
+
+		bool read_string(std::string& str)
+		{
+			std::uint32_t length;
+			if (!read(length) || Size - Pos < length)
+			{
+				return false;
+			}
+
+			str.assign(reinterpret_cast<const char*>(Data + Pos), length);
+			Pos += length;
+			return true;
+		}
+
+		bool read_type(SGLTypeId& type)
+		{
+			std::string name;
+			if (!read_string(name))
+			{
+				return false;
+			}
+
+			type = get_type(name).TypeId;
+			if (type == SGL_INVALID_TYPE_ID)
+			{
+				std::cerr << "Bytecode uses unregistered type " << name << std::endl;
+				return false;
+			}
+
+			return true;
+		}
+	};
+
+	/**
+	 * Rewrites a function's operands into this machine's byte order, remaps its constant pool
+	 * indices to where the constants landed in the pool they were loaded into, and remaps its
+	 * native indices to this process's registry
+	 * Also rejects unknown instructions, operands that run off the end of the code, jumps that don't land on an instruction,
+	 * lookup switches whose keys aren't in order, vector lanes past the 4 a vector has, and variables outside of the
+	 * frame's 'frameSize' slots or the script's 'globalsSize' bytes of globals
+	 * Sets 'writesGlobals' if the code stores to any global
+	 */
+	bool canonicalize_code(std::vector<std::uint8_t>& code, bool swap, const std::vector<std::uint32_t>& poolRemap,
+		const std::vector<std::uint32_t>& stringRemap, const std::vector<std::uint32_t>& nativeRemap, std::size_t frameSize,
+		std::size_t globalsSize, bool& writesGlobals)
+	{
+		writesGlobals = false;
+
+		// where each instruction starts, and everywhere a jump or switch can go
+		std::vector<bool> isInstruction(code.size());
+		std::vector<std::int64_t> targets;
+
+		std::size_t pos = 0;
+		while (pos < code.size())
+		{
+			isInstruction[pos] = true;
+
+			std::uint8_t instruction = code[pos++];
+			if (instruction >= INVALID_INSTRUCTION)
+			{
+				std::cerr << "Invalid instruction " << static_cast<int>(instruction) << " in bytecode" << std::endl;
+				return false;
+			}
+
+			SGLOperand layout = get_operand_layout(static_cast<SGLInstruction>(instruction));
+			std::size_t operandSize = get_operand_size(layout);
+			if (code.size() - pos < operandSize)
+			{
+				std::cerr << "Truncated operand in bytecode" << std::endl;
+				return false;
+			}
+
+			std::uint8_t* operand = &code[pos];
+
+			// only built-in types print, and their IDs are the same everywhere
+			if (instruction == PRINT && operand[0] >= SGL_TYPE_VOID)
+			{
+				std::cerr << "Bytecode prints a value of an unprintable type" << std::endl;
+				return false;
+			}
+
+			if (instruction == NUMBER_TO_STRING && operand[0] != SGL_TYPE_INT32 && operand[0] != SGL_TYPE_FLOAT
+				&& operand[0] != SGL_TYPE_INT64 && operand[0] != SGL_TYPE_DOUBLE)
+			{
+				std::cerr << "Bytecode turns a value that isn't a number into a string" << std::endl;
+				return false;
+			}
+
+			// the VM indexes lanes and lane masks with these, so they can't go past a vector's 4 lanes
+			if (((instruction == VEC_MAKE || instruction == VEC_SPLAT || instruction == VEC_DOT || instruction == VEC_LENGTH
+				|| instruction == VEC_NORMALIZE) && operand[0] > 4) || (instruction == VEC_EXTRACT && operand[0] >= 4))
+			{
+				std::cerr << "Bytecode uses a vector lane past the 4 a vector has" << std::endl;
+				return false;
+			}
+
+			switch (layout)
+			{
+				case SGLOperand::SHORT:
+				case SGLOperand::WORD:
+				case SGLOperand::LONG:
+				{
+					if (swap)
+					{
+						swap_endian_in_buffer(operand, operandSize);
+					}
+					break;
+				}
+				case SGLOperand::POOL_INDEX:
+				{
+					if (swap)
+					{
+						swap_endian_in_buffer(operand, operandSize);
+					}
+
+					std::uint16_t index = read_from_buffer<std::uint16_t>(operand);
+					if (index >= poolRemap.size())
+					{
+						std::cerr << "Constant index " << index << " out of range in bytecode" << std::endl;
+						return false;
+					}
+					store_to_buffer<std::uint16_t>(operand, operandSize, static_cast<std::uint16_t>(poolRemap[index]));
+					break;
+				}
+				case SGLOperand::STRING_INDEX:
+				{
+					if (swap)
+					{
+						swap_endian_in_buffer(operand, operandSize);
+					}
+
+					std::uint16_t index = read_from_buffer<std::uint16_t>(operand);
+					if (index >= stringRemap.size())
+					{
+						std::cerr << "String constant index " << index << " out of range in bytecode" << std::endl;
+						return false;
+					}
+					store_to_buffer<std::uint16_t>(operand, operandSize, static_cast<std::uint16_t>(stringRemap[index]));
+					break;
+				}
+				case SGLOperand::NATIVE_INDEX:
+				{
+					if (swap)
+					{
+						swap_endian_in_buffer(operand, operandSize);
+					}
+
+					std::uint16_t index = read_from_buffer<std::uint16_t>(operand);
+					if (index >= nativeRemap.size() || nativeRemap[index] == SGL_INVALID_NATIVE)
+					{
+						std::cerr << "Bytecode calls a native function that isn't registered" << std::endl;
+						return false;
+					}
+					store_to_buffer<std::uint16_t>(operand, operandSize, static_cast<std::uint16_t>(nativeRemap[index]));
+					break;
+				}
+				case SGLOperand::WIDE_SLOT:
+				{
+					// the widened instruction's byte stays put, only the slot after it is multi-byte
+					if (swap)
+					{
+						swap_endian_in_buffer(operand + 1, sizeof(std::uint16_t));
+					}
+					break;
+				}
+				case SGLOperand::SWITCH_TABLE:
+				case SGLOperand::SWITCH_LOOKUP:
+				{
+					if (swap)
+					{
+						swap_endian_in_buffer(operand, sizeof(std::uint16_t));
+					}
+
+					std::uint16_t count = read_from_buffer<std::uint16_t>(operand);
+					std::size_t tableSize = get_switch_table_size(layout, count);
+					if (code.size() - pos - operandSize < tableSize)
+					{
+						std::cerr << "Truncated switch table in bytecode" << std::endl;
+						return false;
+					}
+
+					// everything after the count is 4 bytes wide, the table included
+					operandSize += tableSize;
+					for (std::size_t field = sizeof(std::uint16_t); swap && field < operandSize; field += sizeof(std::int32_t))
+					{
+						swap_endian_in_buffer(operand + field, sizeof(std::int32_t));
+					}
+
+					auto end = static_cast<std::int64_t>(pos + operandSize);
+					targets.push_back(end + read_from_buffer<std::int32_t>(operand + sizeof(std::uint16_t)));
+
+					const std::uint8_t* table = operand + get_operand_size(layout);
+					for (std::size_t i = 0; i < count; ++i)
+					{
+						if (layout == SGLOperand::SWITCH_TABLE)
+						{
+							targets.push_back(end + read_from_buffer<std::int32_t>(table + i * sizeof(std::int32_t)));
+							continue;
+						}
+
+						// the VM binary searches the keys
+						const std::uint8_t* entry = table + i * 2 * sizeof(std::int32_t);
+						if (i > 0 && read_from_buffer<std::int32_t>(entry - 2 * sizeof(std::int32_t)) >= read_from_buffer<std::int32_t>(entry))
+						{
+							std::cerr << "Lookup switch keys out of order in bytecode" << std::endl;
+							return false;
+						}
+						targets.push_back(end + read_from_buffer<std::int32_t>(entry + sizeof(std::int32_t)));
+					}
+					break;
+				}
+				default:
+				{
+					break;
+				}
+			}
+
+			// a WIDE prefix only makes sense in front of a slot load or store
+			if (instruction == WIDE && get_slot_count(static_cast<SGLInstruction>(operand[0])) == 0)
+			{
+				std::cerr << "Bytecode widens an instruction without a variable slot" << std::endl;
+				return false;
+			}
+
+			std::size_t slotCount = get_slot_count(static_cast<SGLInstruction>(instruction == WIDE ? operand[0] : instruction));
+			if (slotCount != 0)
+			{
+				std::size_t slot = instruction == WIDE ? read_from_buffer<std::uint16_t>(operand + 1) : operand[0];
+				if (slot + slotCount > frameSize)
+				{
+					std::cerr << "Bytecode uses variable slot " << slot << " outside of its " << frameSize << " slot frame" << std::endl;
+					return false;
+				}
+			}
+
+			std::size_t globalSize = get_global_access_size(static_cast<SGLInstruction>(instruction));
+			if (globalSize != 0 && read_from_buffer<std::uint16_t>(operand) + globalSize > globalsSize)
+			{
+				std::cerr << "Bytecode uses a global outside of the script's " << globalsSize << " bytes of globals" << std::endl;
+				return false;
+			}
+
+			if (instruction == GLOBAL_STORE || instruction == GLOBAL_STORE_64 || instruction == GLOBAL_STORE_VEC
+				|| instruction == GLOBAL_STORE_STRING)
+			{
+				writesGlobals = true;
+			}
+
+			if (is_jump_instruction(static_cast<SGLInstruction>(instruction)))
+			{
+				std::int64_t displacement = layout == SGLOperand::BYTE
+					? read_from_buffer<std::int8_t>(operand) : read_from_buffer<std::int32_t>(operand);
+				targets.push_back(static_cast<std::int64_t>(pos + operandSize) + displacement);
+			}
+
+			pos += operandSize;
+		}
+
+		// every jump has to land on an instruction, or on the end of the code which finishes the call
+		auto size = static_cast<std::int64_t>(code.size());
+		for (std::int64_t target : targets)
+		{
+			if (target < 0 || target > size || (target < size && !isInstruction[target]))
+			{
+				std::cerr << "Jump to the middle of an instruction in bytecode" << std::endl;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * Follows every path through a function's canonicalized code, working out how many bytes are on the
+	 * stack above its frame before each instruction
+	 * Rejects code that pops more than is on the stack, that reaches an instruction with a different depth
+	 * along different paths, that returns a value which isn't 'returnSize' bytes, or that runs off the end
+	 * with anything left on the stack
+	 * Sets 'maxStackSize' to the deepest the stack gets along any path
+	 */
+	bool verify_stack_depth(const std::vector<std::uint8_t>& code, std::size_t returnSize, std::size_t& maxStackSize)
+	{
+		constexpr std::size_t unvisited = std::numeric_limits<std::size_t>::max();
+
+		// the depth before each instruction, plus one for the end of the code, which finishes the call
+		std::vector<std::size_t> depths(code.size() + 1, unvisited);
+		std::vector<std::size_t> pending;
+
+		auto reach = [&](std::size_t target, std::size_t depth)
+		{
+			if (depths[target] == unvisited)
+			{
+				depths[target] = depth;
+				pending.push_back(target);
+				return true;
+			}
+
+			if (depths[target] != depth)
+			{
+				std::cerr << "Bytecode reaches an instruction with " << depths[target] << " and " << depth
+					<< " bytes on the stack" << std::endl;
+				return false;
+			}
+			return true;
+		};
+
+		maxStackSize = 0;
+		reach(0, 0);
+		while (!pending.empty())
+		{
+			std::size_t pos = pending.back();
+			pending.pop_back();
+
+			std::size_t depth = depths[pos];
+			if (pos == code.size())
+			{
+				if (depth != 0)
+				{
+					std::cerr << "Bytecode runs off its end with " << depth << " bytes left on the stack" << std::endl;
+					return false;
+				}
+				continue;
+			}
+
+			auto instruction = static_cast<SGLInstruction>(code[pos]);
+			SGLOperand layout = get_operand_layout(instruction);
+			const std::uint8_t* operand = &code[pos + 1];
+
+			std::size_t pops;
+			std::ptrdiff_t effect;
+			if (instruction == CALL_NATIVE)
+			{
+				// a native pops its arguments and pushes what it returns
+				const SGLNativeFunction& native = get_native_registry().get_function(read_from_buffer<std::uint16_t>(operand));
+				pops = 0;
+				for (SGLTypeId param : native.get_param_types())
+				{
+					pops += get_type(param).get_value_size();
+				}
+				effect = static_cast<std::ptrdiff_t>(get_type(native.get_return_type()).get_value_size()) - static_cast<std::ptrdiff_t>(pops);
+			}
+			else if (instruction == WIDE)
+			{
+				pops = get_stack_pops(static_cast<SGLInstruction>(operand[0]));
+				effect = get_stack_effect(static_cast<SGLInstruction>(operand[0]));
+			}
+			else
+			{
+				std::uint8_t byteOperand = layout == SGLOperand::BYTE ? operand[0] : 0;
+				pops = get_stack_pops(instruction, byteOperand);
+				effect = get_stack_effect(instruction, byteOperand);
+			}
+
+			if (depth < pops)
+			{
+				std::cerr << "Bytecode pops " << pops << " bytes with only " << depth << " on the stack" << std::endl;
+				return false;
+			}
+
+			if (instruction == RETURN)
+			{
+				if (depth != returnSize)
+				{
+					std::cerr << "Bytecode returns " << depth << " bytes from a function that returns " << returnSize << std::endl;
+					return false;
+				}
+				continue;
+			}
+
+			std::size_t next = depth + effect;
+			maxStackSize = std::max(maxStackSize, next);
+
+			std::size_t end = pos + 1 + get_operand_size(layout);
+			if (layout == SGLOperand::SWITCH_TABLE || layout == SGLOperand::SWITCH_LOOKUP)
+			{
+				// a switch always jumps, to a case or to its default
+				std::uint16_t count = read_from_buffer<std::uint16_t>(operand);
+				end += get_switch_table_size(layout, count);
+				if (!reach(end + read_from_buffer<std::int32_t>(operand + sizeof(std::uint16_t)), next))
+				{
+					return false;
+				}
+
+				const std::uint8_t* table = operand + get_operand_size(layout);
+				std::size_t entrySize = layout == SGLOperand::SWITCH_LOOKUP ? 2 * sizeof(std::int32_t) : sizeof(std::int32_t);
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					if (!reach(end + read_from_buffer<std::int32_t>(table + i * entrySize + entrySize - sizeof(std::int32_t)), next))
+					{
+						return false;
+					}
+				}
+				continue;
+			}
+
+			if (is_jump_instruction(instruction))
+			{
+				std::ptrdiff_t displacement = layout == SGLOperand::BYTE
+					? read_from_buffer<std::int8_t>(operand) : read_from_buffer<std::int32_t>(operand);
+				if (!reach(end + displacement, next))
+				{
+					return false;
+				}
+
+				if (instruction == JMP_8 || instruction == JMP)
+				{
+					continue;
+				}
+			}
+
+			if (!reach(end, next))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+bool Script::save_to_bytecode(std::vector<std::uint8_t>& out) const
+{
+	BytecodeWriter writer{ out };
+
+	out.insert(out.end(), BYTECODE_MAGIC, BYTECODE_MAGIC + sizeof(BYTECODE_MAGIC));
+	writer.write<std::uint32_t>(BYTE_ORDER_MARK);
+	writer.write<std::uint32_t>(BYTECODE_VERSION);
+
+	// make sure deferred bodies are compiled before the pool is written, since they add constants
+	for (auto& entry : _functions)
+	{
+		if (!get_function(entry->Function.FunctionName))
+		{
+			return false;
+		}
+	}
+
+	// a shared pool is written whole, so images of bundled scripts stay self-contained
+	std::size_t wordCount = _constants->get_word_count();
+	writer.write<std::uint32_t>(static_cast<std::uint32_t>(wordCount));
+	for (std::size_t i = 0; i < wordCount; ++i)
+	{
+		writer.write<std::uint32_t>(_constants->get_word(static_cast<std::uint32_t>(i)));
+	}
+
+	std::size_t stringCount = _constants->get_string_count();
+	writer.write<std::uint32_t>(static_cast<std::uint32_t>(stringCount));
+	for (std::size_t i = 0; i < stringCount; ++i)
+	{
+		writer.write_string(_constants->get_string(static_cast<std::uint32_t>(i)));
+	}
+
+	const SGLNativeRegistry& natives = get_native_registry();
+	writer.write<std::uint32_t>(static_cast<std::uint32_t>(natives.get_function_count()));
+	for (std::size_t i = 0; i < natives.get_function_count(); ++i)
+	{
+		writer.write_string(natives.get_function(static_cast<std::uint32_t>(i)).Name);
+	}
+
+	writer.write<std::uint32_t>(static_cast<std::uint32_t>(_globals.size()));
+	for (const auto& global : _globals)
+	{
+		writer.write_string(global.GlobalName);
+		writer.write_string(get_type(global.GlobalType).TypeName);
+		writer.write<std::uint32_t>(static_cast<std::uint32_t>(global.Offset));
+	}
+
+	writer.write<std::uint32_t>(static_cast<std::uint32_t>(_globalsImage.size()));
+	out.insert(out.end(), _globalsImage.begin(), _globalsImage.end());
+
+	writer.write<std::uint32_t>(static_cast<std::uint32_t>(_functions.size()));
+	for (const auto& entry : _functions)
+	{
+		const SGL::FunctionData& fn = entry->Function;
+		writer.write_string(fn.FunctionName);
+		writer.write_string(get_type(fn.ReturnType).TypeName);
+		writer.write<std::uint32_t>(static_cast<std::uint32_t>(fn.FunctionParams.size()));
+		for (const auto& param : fn.FunctionParams)
+		{
+			writer.write_string(get_type(param.ParamType).TypeName);
+			writer.write_string(param.ParamName);
+		}
+		writer.write<std::uint32_t>(static_cast<std::uint32_t>(fn.FrameSize));
+		writer.write<std::uint32_t>(static_cast<std::uint32_t>(fn.Bytecode.size()));
+		out.insert(out.end(), fn.Bytecode.begin(), fn.Bytecode.end());
+	}
+
+	return true;
+}
+
+bool Script::load_from_bytecode(const std::uint8_t* data, std::size_t size)
+{
+	std::size_t functionCount = _functions.size();
+	bool hadGlobals = !_globals.empty();
+
+	if (read_bytecode(data, size))
+	{
+		return true;
+	}
+
+	// nothing from a rejected image stays callable
+	for (std::size_t i = functionCount; i < _functions.size(); ++i)
+	{
+		_functionIndices.erase(_functions[i]->Function.FunctionName);
+	}
+	_functions.erase(_functions.begin() + functionCount, _functions.end());
+
+	if (!hadGlobals)
+	{
+		_globals.clear();
+		_globalsImage.clear();
+	}
+
+	return false;
+}
+
+bool Script::read_bytecode(const std::uint8_t* data, std::size_t size)
+{
+	if (!data || size < sizeof(BYTECODE_MAGIC) || std::memcmp(data, BYTECODE_MAGIC, sizeof(BYTECODE_MAGIC)) != 0)
+	{
+		std::cerr << "Not an SGL bytecode image" << std::endl;
+		return false;
+	}
+
+	BytecodeReader reader{ data, size, sizeof(BYTECODE_MAGIC), false };
+
+	// the byte order mark tells us whether everything after it needs swapping
+	std::uint32_t mark;
+	if (!reader.read(mark))
+	{
+		return false;
+	}
+
+	if (mark == swap_endian(BYTE_ORDER_MARK))
+	{
+		reader.Swap = true;
+	}
+	else if (mark != BYTE_ORDER_MARK)
+	{
+		std::cerr << "Unrecognized byte order mark in bytecode image" << std::endl;
+		return false;
+	}
+
+	std::uint32_t version;
+	if (!reader.read(version) || version != BYTECODE_VERSION)
+	{
+		std::cerr << "Unsupported bytecode version" << std::endl;
+		return false;
+	}
+
+	// constants are merged into our pool, which may already hold some, so indices get remapped
+	std::uint32_t wordCount;
+	if (!reader.read(wordCount))
+	{
+		return false;
+	}
+
+	std::vector<std::uint32_t> poolRemap(wordCount);
+	for (auto& index : poolRemap)
+	{
+		std::uint32_t word;
+		if (!reader.read(word))
+		{
+			return false;
+		}
+
+		index = _constants->add_word(word);
+		if (index == SGL_INVALID_CONSTANT)
+		{
+			std::cerr << "Constant pool is full, unable to load bytecode" << std::endl;
+			return false;
+		}
+	}
+
+	std::uint32_t stringCount;
+	if (!reader.read(stringCount))
+	{
+		return false;
+	}
+
+	std::vector<std::uint32_t> stringRemap(stringCount);
+	for (auto& index : stringRemap)
+	{
+		std::string str;
+		if (!reader.read_string(str))
+		{
+			return false;
+		}
+
+		index = _constants->add_string(str);
+		if (index == SGL_INVALID_CONSTANT)
+		{
+			std::cerr << "Constant pool is full, unable to load bytecode" << std::endl;
+			return false;
+		}
+	}
+
+	// natives are matched up by name, ones that aren't registered here only fail if something calls them
+	std::uint32_t nativeCount;
+	if (!reader.read(nativeCount))
+	{
+		return false;
+	}
+
+	std::vector<std::uint32_t> nativeRemap(nativeCount);
+	for (auto& index : nativeRemap)
+	{
+		std::string name;
+		if (!reader.read_string(name))
+		{
+			return false;
+		}
+
+		index = get_native_registry().find_function_index(name);
+	}
+
+	std::uint32_t globalCount;
+	if (!reader.read(globalCount))
+	{
+		return false;
+	}
+
+	std::vector<SGL::GlobalData> globals(globalCount);
+	for (auto& global : globals)
+	{
+		std::uint32_t offset;
+		if (!reader.read_string(global.GlobalName) || !reader.read_type(global.GlobalType) || !reader.read(offset))
+		{
+			return false;
+		}
+		global.Offset = offset;
+	}
+
+	std::uint32_t imageSize;
+	if (!reader.read(imageSize) || size - reader.Pos < imageSize)
+	{
+		return false;
+	}
+
+	std::vector<std::uint8_t> image(data + reader.Pos, data + reader.Pos + imageSize);
+	reader.Pos += imageSize;
+
+	for (const auto& global : globals)
+	{
+		std::size_t valueSize = get_type(global.GlobalType).get_value_size();
+		if (global.Offset + valueSize > image.size())
+		{
+			std::cerr << "Global " << global.GlobalName << " lies outside of the globals image" << std::endl;
+			return false;
+		}
+
+		// initial values are swapped like operands, vectors one lane at a time
+		// strings are always inline in the image (see compile_globals), and their characters are bytes
+		if (reader.Swap && global.GlobalType != SGL_TYPE_STRING)
+		{
+			std::size_t laneSize = get_vector_lanes(global.GlobalType) != 0 ? sizeof(float) : valueSize;
+			for (std::size_t lane = 0; lane < valueSize; lane += laneSize)
+			{
+				swap_endian_in_buffer(&image[global.Offset + lane], laneSize);
+			}
+		}
+	}
+
+	// code can only reach globals this image lays out
+	std::size_t globalsSize = 0;
+	if (!globals.empty())
+	{
+		if (!set_globals(std::move(globals), std::move(image)))
+		{
+			return false;
+		}
+
+		globalsSize = _globalsImage.size();
+	}
+
+	std::uint32_t functionCount;
+	if (!reader.read(functionCount))
+	{
+		return false;
+	}
+
+	for (std::uint32_t i = 0; i < functionCount; ++i)
+	{
+		SGL::FunctionData fn;
+		std::uint32_t paramCount;
+		if (!reader.read_string(fn.FunctionName) || !reader.read_type(fn.ReturnType) || !reader.read(paramCount))
+		{
+			return false;
+		}
+
+		for (std::uint32_t p = 0; p < paramCount; ++p)
+		{
+			SGL::FunctionData::FunctionParam param;
+			if (!reader.read_type(param.ParamType) || !reader.read_string(param.ParamName))
+			{
+				return false;
+			}
+			fn.FunctionParams.push_back(param);
+		}
+
+		std::uint32_t frameSize;
+		std::uint32_t codeSize;
+		if (!reader.read(frameSize) || !reader.read(codeSize) || size - reader.Pos < codeSize)
+		{
+			return false;
+		}
+
+		if (frameSize > SGL_MAX_FRAME_SLOTS)
+		{
+			std::cerr << "Function " << fn.FunctionName << " has more frame slots than a frame can hold" << std::endl;
+			return false;
+		}
+
+		fn.FrameSize = frameSize;
+		fn.Bytecode.assign(data + reader.Pos, data + reader.Pos + codeSize);
+		reader.Pos += codeSize;
+
+		if (!canonicalize_code(fn.Bytecode, reader.Swap, poolRemap, stringRemap, nativeRemap, fn.FrameSize, globalsSize,
+			fn.WritesGlobals))
+		{
+			return false;
+		}
+
+		// worked out along every path through the checked code, natives included now that they're bound to our registry
+		if (!verify_stack_depth(fn.Bytecode, get_type(fn.ReturnType).get_value_size(), fn.MaxStackSize))
+		{
+			std::cerr << "In function " << fn.FunctionName << std::endl;
+			return false;
+		}
+
+		if (!add_function(std::move(fn), true))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
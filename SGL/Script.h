@@ -1,11 +1,178 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "Compiler.h"
+#include "ConstantPool.h"
+
+// Index returned when a script has no function with the name asked for
+constexpr std::size_t SGL_INVALID_FUNCTION = std::numeric_limits<std::size_t>::max();
+
 /**
  * The class that holds all relevant information for a Script
+ *
+ * A script is a compiled module: its functions, its constants and the layout of its globals.
+ * Once it's built it's meant to be shared as a std::shared_ptr<const Script> by every VM, thread
+ * and ScriptInstance that runs it. Everything reachable through a const Script is safe to call
+ * from any thread, deferred bodies are compiled at most once no matter who asks first.
  */
 class Script
 {
+public:
+
+	/**
+	 * Creates a script with its own constant pool
+	 */
+	Script();
+
+	/**
+	 * Creates a script that shares a constant pool with other scripts, so that a bundle of
+	 * scripts stores each distinct constant once
+	 */
+	explicit Script(std::shared_ptr<ConstantPool> constants);
+
+	/**
+	 * Returns the pool holding the constants used by the script's code
+	 */
+	ConstantPool& get_constants()
+	{
+		return *_constants;
+	}
+
+	const ConstantPool& get_constants() const
+	{
+		return *_constants;
+	}
+
+	/**
+	 * Adds a function whose signature has been parsed
+	 * If isCompiled is false, the body is compiled the first time get_function is called for it
+	 * Returns false if a function with the same name already exists
+	 */
+	bool add_function(SGL::FunctionData function, bool isCompiled);
+
+	/**
+	 * Returns the index of the function with the given name, or SGL_INVALID_FUNCTION if there is none
+	 * Indices never change once a function is added, so hosts look a name up once and call by index
+	 */
+	std::size_t find_function(const std::string& name) const;
+
+	/**
+	 * Returns the function at an index from find_function, compiling its body first if it was deferred
+	 * Safe to call from multiple threads, the body is only ever compiled once
+	 * Compiling a deferred body doesn't change what the module does, so this counts as const
+	 * Returns nullptr if the index is out of range or the body failed to compile
+	 */
+	const SGL::FunctionData* get_function(std::size_t index) const;
+
+	/**
+	 * Returns the function with the given name, see find_function and the overload above
+	 */
+	const SGL::FunctionData* get_function(const std::string& name) const
+	{
+		return get_function(find_function(name));
+	}
+
+	/**
+	 * Sets the layout of the script's globals and the image every instance starts from
+	 * The compiler works out both, initial values included, so creating an instance is one copy
+	 * Returns false if the script already has globals
+	 */
+	bool set_globals(std::vector<SGL::GlobalData> globals, std::vector<std::uint8_t> image);
+
+	/**
+	 * Returns the script's globals, in the order they were declared
+	 */
+	const std::vector<SGL::GlobalData>& get_globals() const
+	{
+		return _globals;
+	}
+
+	/**
+	 * Returns the initial contents of an instance's globals block, get_globals_size bytes long
+	 */
+	const std::uint8_t* get_globals_image() const
+	{
+		return _globalsImage.data();
+	}
+
+	/**
+	 * Returns the number of bytes of globals each instance of the script gets
+	 * Padded to the stack alignment so the block can be copied whole
+	 */
+	std::size_t get_globals_size() const
+	{
+		return _globalsImage.size();
+	}
+
+	/**
+	 * Appends a bytecode image of the script's functions and constants to 'out'
+	 * Deferred functions are compiled first, returns false if any of them fail
+	 */
+	bool save_to_bytecode(std::vector<std::uint8_t>& out) const;
+
+	/**
+	 * Loads the functions and constants from a bytecode image made by save_to_bytecode
+	 * The image records the byte order it was written in, and if that isn't this machine's
+	 * order every operand is swapped here, once, so the VM never has to swap anything
+	 * If the image is rejected, the functions and globals it got as far as adding are taken back out
+	 */
+	bool load_from_bytecode(const std::uint8_t* data, std::size_t size);
+
+	/**
+	 * Returns the number of functions whose bodies have been compiled
+	 */
+	std::size_t get_compiled_function_count() const;
+
+	/**
+	 * Returns the number of functions whose bodies are still waiting on their first call
+	 */
+	std::size_t get_deferred_function_count() const;
+
 private:
+
+	/**
+	 * Compilation state of a function's body
+	 */
+	enum class BodyState
+	{
+		Deferred,
+		Compiled,
+		Failed
+	};
+
+	/**
+	 * A function plus the bookkeeping needed to compile it on demand
+	 * Held by pointer since once_flag and atomics can't be moved around by the vector
+	 */
+	struct ScriptFunction
+	{
+		SGL::FunctionData Function;
+		std::once_flag CompileFlag;
+		std::atomic<BodyState> State;
+	};
+
+	/**
+	 * Does the work of load_from_bytecode, leaving whatever it added in place if it fails
+	 */
+	bool read_bytecode(const std::uint8_t* data, std::size_t size);
+
+	// Functions declared by the script, in the order they were added
+	std::vector<std::unique_ptr<ScriptFunction>> _functions;
+	// Index into _functions of each function, by name
+	std::unordered_map<std::string, std::size_t> _functionIndices;
+	// Constants used by the script's code, possibly shared with other scripts
+	std::shared_ptr<ConstantPool> _constants;
+	// Globals declared by the script, each at its offset into an instance's globals block
+	std::vector<SGL::GlobalData> _globals;
+	// Initial contents of an instance's globals block
+	std::vector<std::uint8_t> _globalsImage;
+
 };
\ No newline at end of file
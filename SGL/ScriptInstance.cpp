@@ -0,0 +1,47 @@
+#include "ScriptInstance.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "Script.h"
+#include "Stack.h"
+
+ScriptInstance::ScriptInstance(std::shared_ptr<const Script> script, SGLAllocator& allocator)
+	: _script(std::move(script))
+	, _globals(nullptr, GlobalsDeleter{ &allocator, 0 })
+	, _strings(allocator)
+{
+	std::size_t size = _script->get_globals_size();
+	if (size == 0)
+	{
+		return;
+	}
+
+	// globals hold the same types frames do, so they get the same alignment
+	// the compiler already worked out every initial value, so setting them up is a single copy
+	_globals.reset(static_cast<std::uint8_t*>(allocator.allocate(size, SGL_STACK_ALIGNMENT)));
+	if (!_globals)
+	{
+		std::cerr << "Unable to allocate " << size << " bytes of script globals" << std::endl;
+		return;
+	}
+
+	_globals.get_deleter().Size = size;
+	std::memcpy(_globals.get(), _script->get_globals_image(), size);
+
+	// the copy is a write like any other, so a delta taken after this includes the initial values
+	mark_globals_written();
+}
+
+void ScriptInstance::mark_globals_written()
+{
+	if (_globals)
+	{
+		_globals.get_deleter().Allocator->mark_written(_globals.get(), _globals.get_deleter().Size);
+	}
+}
+
+void ScriptInstance::GlobalsDeleter::operator()(std::uint8_t* globals) const
+{
+	Allocator->deallocate(globals, Size);
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "Allocator.h"
+#include "SGLString.h"
+
+class Script;
+
+/**
+ * The state one entity keeps for a script: a reference to the shared module and its own globals
+ *
+ * Code, constants and function tables all live in the Script, which every instance shares, and
+ * the stack belongs to whichever VM runs the instance. That leaves an instance with a reference,
+ * a pointer and the allocator its globals came from, plus its globals block if the script has any
+ * and the long strings stored into them.
+ */
+class ScriptInstance
+{
+public:
+
+	/**
+	 * Creates an instance of the script with its globals set to their initial values
+	 * The globals block is taken from 'allocator', which has to outlive the instance
+	 */
+	explicit ScriptInstance(std::shared_ptr<const Script> script, SGLAllocator& allocator = get_default_allocator());
+
+	ScriptInstance(ScriptInstance&& other) = default;
+	ScriptInstance& operator=(ScriptInstance&& other) = default;
+
+	ScriptInstance(const ScriptInstance&) = delete;
+	ScriptInstance& operator=(const ScriptInstance&) = delete;
+
+	/**
+	 * Returns the module this is an instance of
+	 */
+	const Script& get_script() const
+	{
+		return *_script;
+	}
+
+	/**
+	 * Returns the instance's globals, nullptr if the script has none
+	 */
+	std::uint8_t* get_globals()
+	{
+		return _globals.get();
+	}
+
+	const std::uint8_t* get_globals() const
+	{
+		return _globals.get();
+	}
+
+	/**
+	 * Returns where the long strings stored into the instance's globals are kept
+	 */
+	SGLStringStore& get_strings()
+	{
+		return _strings;
+	}
+
+	/**
+	 * Tells the allocator the globals came from that they've changed, for allocators that track
+	 * changes such as SGLStateRegion
+	 * The VM calls this after running a function that stores to globals, hosts that write to
+	 * get_globals() themselves should call it too
+	 */
+	void mark_globals_written();
+
+private:
+
+	/**
+	 * Hands a globals block back to the allocator it came from
+	 */
+	struct GlobalsDeleter
+	{
+		SGLAllocator* Allocator = nullptr;
+		std::size_t Size = 0;
+
+		void operator()(std::uint8_t* globals) const;
+	};
+
+	// The shared module
+	std::shared_ptr<const Script> _script;
+	// This instance's globals
+	std::unique_ptr<std::uint8_t, GlobalsDeleter> _globals;
+	// Long strings held by string globals, from the same allocator as the globals
+	SGLStringStore _strings;
+
+};
\ No newline at end of file
@@ -1,19 +1,39 @@
 #include "Stack.h"
 
+#include "PrintSink.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Size of a new stack's first segment, deeper calls grow it
 #ifndef SGL_STACK_DEFAULT_SIZE
-#define SGL_STACK_DEFAULT_SIZE 1024
+#define SGL_STACK_DEFAULT_SIZE 256
 #endif
 
-VMStack::VMStack(size_t size)
+namespace
+{
+	/**
+	 * Rounds a size up to the stack alignment, aligned allocators want a multiple of it
+	 */
+	size_t align_stack_size(size_t size)
+	{
+		return (size + SGL_STACK_ALIGNMENT - 1) & ~(SGL_STACK_ALIGNMENT - 1);
+	}
+}
+
+VMStack::VMStack(size_t size, SGLAllocator& allocator)
+	: _allocator(&allocator)
 {
 	if (size == 0)
 	{
-		std::cerr << "Size 0 is invalid size for stack. Using default size: " << SGL_STACK_DEFAULT_SIZE << std::endl
-			<< "Note: you can change the default stack size by defining SGL_STACK_DEFAULT_SIZE to a non-zero value." << std::endl;
+		get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Size 0 is invalid size for stack. Using default size: ", SGL_STACK_DEFAULT_SIZE);
+		get_print_sink().write_line(SGLPrintChannel::Diagnostic,
+			"Note: you can change the default stack size by defining SGL_STACK_DEFAULT_SIZE to a non-zero value.");
 		size = SGL_STACK_DEFAULT_SIZE;
 	}
 
-	_stacksize = size;
+	_stacksize = align_stack_size(size);
+	_segment = 0;
 	_stackmem = 0;
 	_stackpos = 0;
 }
@@ -26,20 +46,160 @@ bool VMStack::initialize_stack()
 		return true;
 	}
 
-	// allocate a buffer for the stack, aligned to int boundary
-	_stackmem = static_cast<char*>(_aligned_malloc(_stacksize, 4));
+	// allocate the first segment, aligned for the widest value the VM handles
+	_stackmem = static_cast<char*>(_allocator->allocate(_stacksize, SGL_STACK_ALIGNMENT));
+	if (!_stackmem)
+	{
+		return false;
+	}
+
+	_segments.push_back({ _stackmem, _stacksize, 0 });
+	return true;
+}
+
+VMFrame VMStack::push_frame(size_t size, size_t reserve)
+{
+	size = align_stack_size(size);
+
+	// the one check for room, everything the function pushes fits in what's reserved here
+	VMFrame frame;
+	if (_stacksize - _stackpos < size + reserve)
+	{
+		if (!enter_next_segment(size + reserve))
+		{
+			return frame;
+		}
+
+		frame.EnteredSegment = true;
+	}
+
+	size_t framePos = _stackpos;
+#ifdef _DEBUG
+	// frames only begin where the last frame's values have all been popped, which is always aligned
+	if (framePos % SGL_STACK_ALIGNMENT != 0)
+	{
+		get_print_sink().write_line(SGLPrintChannel::Diagnostic, "MISALIGNED STACK FRAME AT ", framePos);
+		// die();
+	}
+#endif
+
+	std::memset(_stackmem + framePos, 0, size);
+	_stackpos += size;
+
+	frame.Pos = framePos;
+	return frame;
+}
+
+void VMStack::pop_frame(const VMFrame& frame)
+{
+	if (frame.EnteredSegment)
+	{
+		size_t returnPos = _segments[_segment].ReturnPos;
+		use_segment(_segment - 1);
+		_stackpos = returnPos;
+		return;
+	}
+
+	_stackpos = frame.Pos;
+}
+
+bool VMStack::enter_next_segment(size_t size)
+{
+	if (!_stackmem)
+	{
+		return false;
+	}
+
+	size_t next = _segment + 1;
+	if (next < _segments.size() && _segments[next].Size < size)
+	{
+		// too small for this frame, it and everything after it get replaced by one big enough
+		for (size_t i = next; i < _segments.size(); ++i)
+		{
+			_allocator->deallocate(_segments[i].Memory, _segments[i].Size);
+		}
+		_segments.resize(next);
+	}
+
+	if (next == _segments.size())
+	{
+		// each segment is at least double the last, so a deep recursion links on few of them
+		size_t segmentSize = std::max(_segments.back().Size * 2, align_stack_size(size));
+		char* memory = static_cast<char*>(_allocator->allocate(segmentSize, SGL_STACK_ALIGNMENT));
+		if (!memory)
+		{
+			get_print_sink().write_line(SGLPrintChannel::Diagnostic, "STACK OVERFLOW, UNABLE TO GROW THE STACK BY ", segmentSize, " BYTES");
+			return false;
+		}
+
+		_segments.push_back({ memory, segmentSize, 0 });
+	}
+
+	_segments[next].ReturnPos = _stackpos;
+	use_segment(next);
+	_stackpos = 0;
+	return true;
+}
+
+void VMStack::use_segment(size_t index)
+{
+	_segment = index;
+	_stackmem = _segments[index].Memory;
+	_stacksize = _segments[index].Size;
+}
+
+void VMStack::reset()
+{
+	if (_segment != 0)
+	{
+		use_segment(0);
+	}
+
+	_stackpos = 0;
+}
+
+void VMStack::shrink()
+{
+	reset();
+
+	for (size_t i = 1; i < _segments.size(); ++i)
+	{
+		_allocator->deallocate(_segments[i].Memory, _segments[i].Size);
+	}
+
+	if (!_segments.empty())
+	{
+		_segments.resize(1);
+	}
+}
+
+size_t VMStack::get_reserved_size() const
+{
+	size_t size = 0;
+	for (const auto& segment : _segments)
+	{
+		size += segment.Size;
+	}
 
-	return (_stackmem != nullptr);
+	return size;
 }
 
 void VMStack::shutdown_stack()
 {
-	if (_stackmem)
+	for (const auto& segment : _segments)
 	{
-		_aligned_free(_stackmem);
-		_stackmem = 0;
+		_allocator->deallocate(segment.Memory, segment.Size);
 	}
 
+	if (!_segments.empty())
+	{
+		// the first segment's size is kept so the stack can be initialized again
+		_stacksize = _segments.front().Size;
+	}
+
+	_segments.clear();
+	_segment = 0;
+	_stackmem = 0;
 	_stackpos = 0;
 }
 
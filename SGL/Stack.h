@@ -1,13 +1,49 @@
 #pragma once
 
 #include <cstdint>
-#include <iostream>
+#include <cstring>
+#include <vector>
 
+#include "Allocator.h"
+#include "PrintSink.h"
+
+// Alignment of the stack memory and of every frame on it, enough for the 16-byte vector types
+constexpr std::size_t SGL_STACK_ALIGNMENT = 16;
+
+// Frame position returned when the stack can't grow to fit a frame
+constexpr std::size_t SGL_INVALID_FRAME = SIZE_MAX;
+
+/**
+ * Where push_frame put a frame, handed back to pop_frame
+ */
+struct VMFrame
+{
+	// Stack position the frame begins at, SGL_INVALID_FRAME if the stack couldn't grow to fit it
+	std::size_t Pos = SGL_INVALID_FRAME;
+	// True if the frame moved the stack onto the next segment, so popping it moves back
+	// A frame at position 0 isn't necessarily that one, an empty frame leaves the next frame at 0 too
+	bool EnteredSegment = false;
+};
+
+/**
+ * The VM's working stack
+ *
+ * The stack starts as one small segment and grows by linking on bigger ones. Each function says
+ * how much it needs when it's entered, its frame plus the most it ever pushes, and if that doesn't
+ * fit in what's left of the current segment the frame starts at the bottom of the next one. So
+ * that one check at function entry is the only one, pushes and pops never check for room (outside
+ * of debug builds) and a frame never straddles two segments. Segments stay linked on once they're
+ * allocated, so going in and out of a deep call doesn't allocate each time.
+ */
 class VMStack
 {
 public:
 
-	VMStack(size_t size);
+	/**
+	 * Creates a stack whose first segment is 'size' bytes, its memory comes from 'allocator' once
+	 * it's initialized
+	 */
+	VMStack(size_t size, SGLAllocator& allocator = get_default_allocator());
 
 	/**
 	 * Initializes the stack
@@ -30,19 +66,17 @@ public:
 		// in debug builds, verify that this is a valid pop
 		if (_stackpos < Tsize)
 		{
-			std::cerr << "INVALID STACK POP, REQUESTED SIZE " << Tsize << " BYTES EXCEEDS STORED STACK VALUES" << std::endl;
+			get_print_sink().write_line(SGLPrintChannel::Diagnostic, "INVALID STACK POP, REQUESTED SIZE ", Tsize, " BYTES EXCEEDS STORED STACK VALUES");
 			// die();
 		}
 #endif
 		size_t pos = (_stackpos -= Tsize);
-		union
-		{
-			char* as_char;
-			T* as_T;
-		};
-		as_char = (_stackmem + pos);
 
-		return *as_T;
+		// values are packed on top of the frame, so a vector pushed over a scalar isn't 16-byte aligned
+		// memcpy compiles down to a single unaligned move
+		T value;
+		std::memcpy(&value, _stackmem + pos, Tsize);
+		return value;
 	}
 
 	/**
@@ -56,21 +90,80 @@ public:
 		// make sure we're not exceeding the stack size
 		if (_stackpos + Tsize > _stacksize)
 		{
-			std::cerr << "STACK OVERFLOW DETECTED" << std::endl;
+			get_print_sink().write_line(SGLPrintChannel::Diagnostic, "STACK OVERFLOW DETECTED");
 			// die();
 		}
 #endif
 
+		// see pop() for why this doesn't assume alignment
+		std::memcpy(_stackmem + _stackpos, &value, Tsize);
+
+		_stackpos += Tsize;
+	}
+
+	/**
+	 * Reserves a zeroed block on top of the stack to hold a function's variables, with at least
+	 * 'reserve' bytes free above it for the values the function pushes
+	 * The size is rounded up to SGL_STACK_ALIGNMENT so the values pushed above the frame start aligned
+	 * Moves on to the next segment if the current one doesn't have room, allocating it if need be
+	 * Returns where the frame begins, its position is SGL_INVALID_FRAME if the stack can't grow
+	 */
+	VMFrame push_frame(size_t size, size_t reserve);
+
+	/**
+	 * Pops everything above and including the frame
+	 * Moves back to the previous segment if pushing the frame moved onto its segment
+	 */
+	void pop_frame(const VMFrame& frame);
+
+	/**
+	 * Empties the stack without touching its memory, whatever a call left on it
+	 * Segments the stack grew stay allocated for the next deep call
+	 */
+	void reset();
+
+	/**
+	 * Frees every segment but the first, to give back what a deep call grew the stack to
+	 * Only call this while the stack is empty
+	 */
+	void shrink();
+
+	/**
+	 * Returns the number of bytes allocated for the stack, every segment included
+	 */
+	size_t get_reserved_size() const;
+
+	/**
+	 * Reads a value at the given stack position without popping anything
+	 * Frame slots are aligned for their type, so this is a plain aligned load
+	 */
+	template <class T>
+	T load(size_t pos) const
+	{
 		union
 		{
 			char* as_char;
 			T* as_T;
 		};
+		as_char = (_stackmem + pos);
 
-		as_char = (_stackmem + _stackpos);
-		*as_T = value;
+		return *as_T;
+	}
 
-		_stackpos += Tsize;
+	/**
+	 * Writes a value at the given stack position without pushing anything
+	 */
+	template <class T>
+	void store(size_t pos, const T& value)
+	{
+		union
+		{
+			char* as_char;
+			T* as_T;
+		};
+		as_char = (_stackmem + pos);
+
+		*as_T = value;
 	}
 
 	/**
@@ -80,11 +173,39 @@ public:
 
 private:
 
-	// Pointer to memory allocated for the stack
+	/**
+	 * One block of stack memory
+	 */
+	struct Segment
+	{
+		char* Memory = nullptr;
+		size_t Size = 0;
+		// Position in the previous segment to go back to once the frame that entered this segment is popped
+		size_t ReturnPos = 0;
+	};
+
+	/**
+	 * Moves on to the next segment, allocating it first if it doesn't exist or is too small to hold 'size' bytes
+	 * Returns false if the memory can't be allocated
+	 */
+	bool enter_next_segment(size_t size);
+
+	/**
+	 * Makes the segment at the given index the current one
+	 */
+	void use_segment(size_t index);
+
+	// Where the stack's memory comes from
+	SGLAllocator* _allocator;
+	// Every segment allocated so far, in the order they're used
+	std::vector<Segment> _segments;
+	// Index of the segment in use
+	size_t _segment;
+	// Pointer to the memory of the segment in use
 	char* _stackmem;
-	// Size of the memory allocated for the stack
+	// Size of the segment in use
 	size_t _stacksize;
-	// Read/write position in the stack
+	// Read/write position in the segment in use
 	size_t _stackpos;
 
 };
\ No newline at end of file
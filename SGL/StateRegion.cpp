@@ -0,0 +1,105 @@
+#include "StateRegion.h"
+
+#include <algorithm>
+#include <cstring>
+
+SGLStateRegion::SGLStateRegion(std::size_t size, SGLAllocator& upstream)
+	: SGLArenaAllocator(size, upstream)
+	// the region isn't padded to a whole page, so the last page may be partial
+	, _dirty((get_bytes_left() + SGL_STATE_PAGE_SIZE - 1) / SGL_STATE_PAGE_SIZE, 0)
+{}
+
+void SGLStateRegion::save_snapshot(std::vector<std::uint8_t>& snapshot)
+{
+	snapshot.resize(get_used_size());
+	std::memcpy(snapshot.data(), get_memory(), snapshot.size());
+
+	std::fill(_dirty.begin(), _dirty.end(), 0);
+}
+
+bool SGLStateRegion::restore_snapshot(const std::vector<std::uint8_t>& snapshot)
+{
+	if (snapshot.size() > get_used_size())
+	{
+		return false;
+	}
+
+	std::memcpy(get_memory(), snapshot.data(), snapshot.size());
+
+	// the next delta is taken against whatever snapshot came before, which may not be this one
+	mark_all_written();
+	return true;
+}
+
+void SGLStateRegion::save_delta(SGLStateDelta& delta)
+{
+	delta.Pages.clear();
+	delta.Data.clear();
+
+	std::size_t usedSize = get_used_size();
+	std::size_t pageCount = get_used_page_count();
+	for (std::size_t page = 0; page < pageCount; ++page)
+	{
+		if (!_dirty[page])
+		{
+			continue;
+		}
+
+		// the last page is only copied as far as the allocated memory goes, the rest stays zeroed
+		std::size_t start = page * SGL_STATE_PAGE_SIZE;
+		std::size_t length = std::min(SGL_STATE_PAGE_SIZE, usedSize - start);
+
+		delta.Pages.push_back(static_cast<std::uint32_t>(page));
+		delta.Data.resize(delta.Data.size() + SGL_STATE_PAGE_SIZE, 0);
+		std::memcpy(&delta.Data[delta.Data.size() - SGL_STATE_PAGE_SIZE], get_memory() + start, length);
+
+		_dirty[page] = 0;
+	}
+}
+
+bool SGLStateRegion::apply_delta(const SGLStateDelta& delta)
+{
+	std::size_t usedSize = get_used_size();
+	if (delta.Data.size() != delta.Pages.size() * SGL_STATE_PAGE_SIZE)
+	{
+		return false;
+	}
+
+	for (std::size_t i = 0; i < delta.Pages.size(); ++i)
+	{
+		std::size_t start = delta.Pages[i] * SGL_STATE_PAGE_SIZE;
+		if (start >= usedSize)
+		{
+			return false;
+		}
+
+		std::size_t length = std::min(SGL_STATE_PAGE_SIZE, usedSize - start);
+		std::memcpy(get_memory() + start, &delta.Data[i * SGL_STATE_PAGE_SIZE], length);
+		_dirty[delta.Pages[i]] = 1;
+	}
+
+	return true;
+}
+
+std::size_t SGLStateRegion::get_dirty_page_count() const
+{
+	return static_cast<std::size_t>(std::count(_dirty.begin(), _dirty.begin() + get_used_page_count(), 1));
+}
+
+void SGLStateRegion::mark_written(void* memory, std::size_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	std::size_t start = static_cast<std::uint8_t*>(memory) - get_memory();
+	std::size_t first = start / SGL_STATE_PAGE_SIZE;
+	std::size_t last = (start + size - 1) / SGL_STATE_PAGE_SIZE;
+	std::fill(_dirty.begin() + first, _dirty.begin() + last + 1, 1);
+}
+
+void SGLStateRegion::mark_all_written()
+{
+	std::fill(_dirty.begin(), _dirty.begin() + get_used_page_count(), 1);
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Allocator.h"
+
+// Granularity of change tracking in a SGLStateRegion, small so one entity's writes don't drag its neighbours into a delta
+constexpr std::size_t SGL_STATE_PAGE_SIZE = 256;
+
+/**
+ * The pages of a state region that changed between two snapshots, with what they held at the second
+ */
+struct SGLStateDelta
+{
+	// Index of each page in the delta, in ascending order
+	std::vector<std::uint32_t> Pages;
+	// Contents of the pages, SGL_STATE_PAGE_SIZE bytes each in the same order
+	std::vector<std::uint8_t> Data;
+};
+
+/**
+ * An arena that keeps the globals of many script instances back to back, so that all of their
+ * state can be saved and restored at once, for things like rollback networking
+ *
+ * Give it to every ScriptInstance that should be part of the snapshot. Globals hold plain values
+ * and code reaches them by offset, so nothing in the region points into the region and it never
+ * needs rebasing: a snapshot is one copy out and a restore is one copy back in. The VM's stack is
+ * empty between calls, so snapshots taken between calls hold everything scripts remember. Long
+ * strings in globals point into their instance's string store, whose buffers come from the same
+ * region, so a snapshot has their characters too and they survive a restore. Native object references kept in globals are
+ * restored as they were, it's up to the host that the objects still exist.
+ *
+ * The region also remembers which pages have been written since the last snapshot, so a delta
+ * snapshot only copies those. The VM marks an instance's globals after running a function that
+ * stores to them. Rolling back to a delta means restoring the full snapshot it's based on, then
+ * applying every delta after it in order.
+ */
+class SGLStateRegion : public SGLArenaAllocator
+{
+public:
+
+	/**
+	 * Creates a region of 'size' bytes taken from 'upstream'
+	 */
+	explicit SGLStateRegion(std::size_t size, SGLAllocator& upstream = get_default_allocator());
+
+	/**
+	 * Returns the number of bytes a full snapshot takes, everything allocated from the region so far
+	 */
+	std::size_t get_snapshot_size() const
+	{
+		return get_used_size();
+	}
+
+	/**
+	 * Copies the whole region into 'snapshot' and starts tracking changes from here
+	 * Reusing the same vector keeps this to the copy alone
+	 */
+	void save_snapshot(std::vector<std::uint8_t>& snapshot);
+
+	/**
+	 * Copies a snapshot back into the region
+	 * The snapshot may be smaller than the region if more was allocated after it was taken, that
+	 * memory is left as it is
+	 * Returns false if the snapshot is bigger than what's been allocated
+	 */
+	bool restore_snapshot(const std::vector<std::uint8_t>& snapshot);
+
+	/**
+	 * Copies the pages written since the last snapshot into 'delta' and starts tracking changes from here
+	 */
+	void save_delta(SGLStateDelta& delta);
+
+	/**
+	 * Copies the pages of a delta back into the region
+	 * Returns false if the delta has pages past what's been allocated
+	 */
+	bool apply_delta(const SGLStateDelta& delta);
+
+	/**
+	 * Returns the number of pages written since the last snapshot
+	 */
+	std::size_t get_dirty_page_count() const;
+
+	void mark_written(void* memory, std::size_t size) override;
+
+private:
+
+	/**
+	 * Returns the number of pages that have memory allocated in them
+	 */
+	std::size_t get_used_page_count() const
+	{
+		return (get_used_size() + SGL_STATE_PAGE_SIZE - 1) / SGL_STATE_PAGE_SIZE;
+	}
+
+	/**
+	 * Marks every page dirty, after the whole region has been overwritten
+	 */
+	void mark_all_written();
+
+	// One flag per page of the region, set when the page is written
+	std::vector<std::uint8_t> _dirty;
+
+};
\ No newline at end of file
@@ -8,10 +8,19 @@ namespace SGL
 	{
 		std::size_t closePos = std::string::npos;
 		auto counter = 0;
+		bool inQuotes = false;
 
 		for (std::size_t i = first; i < str.length(); ++i)
 		{
-			if (str[i] == open)
+			if (open != '"' && is_quote_at(str, i))
+			{
+				inQuotes = !inQuotes;
+			}
+			else if (inQuotes)
+			{
+				continue;
+			}
+			else if (str[i] == open)
 			{
 				++counter;
 			}
@@ -34,10 +43,19 @@ namespace SGL
 	{
 		std::size_t openPos = std::string::npos;
 		auto counter = 0;
+		bool inQuotes = false;
 
-		for (std::size_t i = last; i > 0; --i)
+		for (std::size_t i = last + 1; i-- > 0;)
 		{
-			if (str[i] == open)
+			if (open != '"' && is_quote_at(str, i))
+			{
+				inQuotes = !inQuotes;
+			}
+			else if (inQuotes)
+			{
+				continue;
+			}
+			else if (str[i] == open)
 			{
 				++counter;
 			}
@@ -49,6 +67,7 @@ namespace SGL
 			if (counter == 0)
 			{
 				openPos = i;
+				break;
 			}
 		}
 
@@ -75,6 +94,41 @@ namespace SGL
 		return find_reverse_pair(str, '{', '}', lastBracket);
 	}
 
+	bool is_quote_at(const std::string& str, std::size_t i)
+	{
+		if (str[i] != '"')
+		{
+			return false;
+		}
+
+		// an even number of backslashes in front escape each other, not the quote
+		std::size_t backslashes = 0;
+		while (backslashes < i && str[i - backslashes - 1] == '\\')
+		{
+			++backslashes;
+		}
+
+		return backslashes % 2 == 0;
+	}
+
+	std::size_t find_unquoted(const std::string& str, const std::string& query, std::size_t first)
+	{
+		bool inQuotes = false;
+		for (std::size_t i = first; i < str.length(); ++i)
+		{
+			if (is_quote_at(str, i))
+			{
+				inQuotes = !inQuotes;
+			}
+			else if (!inQuotes && str.compare(i, query.length(), query) == 0)
+			{
+				return i;
+			}
+		}
+
+		return std::string::npos;
+	}
+
 	std::string get_full_line(const std::string& src, std::size_t pos)
 	{
 		if (pos >= src.length())
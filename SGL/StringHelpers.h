@@ -19,6 +19,7 @@ namespace SGL
      * For each instance of 'close' found, the counter is decreased
      * When the counter reaches 0, the character at the current position is the matching closer
      * If the end of the string is found and counter > 0, the function returns std::string::npos
+     * Symbols inside string literals are skipped, unless the symbols are quotes themselves
      */
     std::size_t find_pair(const std::string& str, char open, char close, std::size_t first);
 
@@ -33,6 +34,7 @@ namespace SGL
      * For each instance of 'close' found, the counter is increased
      * When the counter reaches 0, the character at the current position is the matching opener
      * If the start of the string is found and counter > 0, the function returns std::string::npos
+     * Symbols inside string literals are skipped, unless the symbols are quotes themselves
      */
     std::size_t find_reverse_pair(const std::string& str, char open, char close, std::size_t last);
 
@@ -64,6 +66,19 @@ namespace SGL
      */
     std::size_t find_reverse_matching_bracket(const std::string& str, std::size_t lastBracket);
 
+    /**
+     * Returns true if the character at the given index is a quote that opens or closes a string literal
+     * A quote escaped with a backslash is part of the literal
+     */
+    bool is_quote_at(const std::string& str, std::size_t i);
+
+    /**
+     * Finds the first occurrence of 'query' at or after 'first' that isn't inside a string literal
+     * 'first' must not be inside a string literal
+     * Returns std::string::npos if there is none
+     */
+    std::size_t find_unquoted(const std::string& str, const std::string& query, std::size_t first = 0);
+
     /**
      * Returns a substring of the given source that encapsulates the full line of a character
      */
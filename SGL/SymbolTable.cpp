@@ -0,0 +1,175 @@
+#include "SymbolTable.h"
+
+namespace SGL
+{
+	namespace
+	{
+		// Starting bucket count, must be a power of two
+		constexpr std::size_t INITIAL_BUCKETS = 64;
+
+		/**
+		 * FNV-1a, identifiers are short so anything fancier isn't worth it
+		 */
+		std::size_t hash_identifier(const std::string& name)
+		{
+			std::uint64_t hash = 14695981039346656037ULL;
+			for (unsigned char c : name)
+			{
+				hash ^= c;
+				hash *= 1099511628211ULL;
+			}
+
+			return static_cast<std::size_t>(hash);
+		}
+	}
+
+	IdentifierTable::IdentifierTable()
+		: _buckets(INITIAL_BUCKETS, INVALID_IDENTIFIER)
+	{}
+
+	std::size_t IdentifierTable::find_bucket(const std::string& name, std::size_t hash) const
+	{
+		// linear probing, the table is kept under 3/4 full so this always finds an empty bucket
+		std::size_t mask = _buckets.size() - 1;
+		std::size_t bucket = hash & mask;
+		while (_buckets[bucket] != INVALID_IDENTIFIER)
+		{
+			IdentifierId id = _buckets[bucket];
+			if (_hashes[id] == hash && _names[id] == name)
+			{
+				break;
+			}
+
+			bucket = (bucket + 1) & mask;
+		}
+
+		return bucket;
+	}
+
+	IdentifierId IdentifierTable::intern(const std::string& name)
+	{
+		std::size_t hash = hash_identifier(name);
+		std::size_t bucket = find_bucket(name, hash);
+		if (_buckets[bucket] != INVALID_IDENTIFIER)
+		{
+			// already interned
+			return _buckets[bucket];
+		}
+
+		IdentifierId id = static_cast<IdentifierId>(_names.size());
+		_names.push_back(name);
+		_hashes.push_back(hash);
+		_buckets[bucket] = id;
+
+		if (_names.size() * 4 >= _buckets.size() * 3)
+		{
+			grow();
+		}
+
+		return id;
+	}
+
+	IdentifierId IdentifierTable::find(const std::string& name) const
+	{
+		return _buckets[find_bucket(name, hash_identifier(name))];
+	}
+
+	void IdentifierTable::grow()
+	{
+		std::vector<IdentifierId> buckets(_buckets.size() * 2, INVALID_IDENTIFIER);
+		std::size_t mask = buckets.size() - 1;
+
+		for (IdentifierId id = 0; id < _names.size(); ++id)
+		{
+			// names are unique, so there's no need to compare strings while reinserting
+			std::size_t bucket = _hashes[id] & mask;
+			while (buckets[bucket] != INVALID_IDENTIFIER)
+			{
+				bucket = (bucket + 1) & mask;
+			}
+			buckets[bucket] = id;
+		}
+
+		_buckets.swap(buckets);
+	}
+
+	void IdentifierTable::clear()
+	{
+		_buckets.assign(INITIAL_BUCKETS, INVALID_IDENTIFIER);
+		_names.clear();
+		_hashes.clear();
+	}
+
+	SymbolTable::SymbolTable()
+	{
+		clear();
+	}
+
+	void SymbolTable::push_scope()
+	{
+		_scopeStarts.push_back(_symbols.size());
+	}
+
+	void SymbolTable::pop_scope()
+	{
+		if (_scopeStarts.size() <= 1)
+		{
+			// never pop the outermost scope
+			return;
+		}
+
+		std::size_t start = _scopeStarts.back();
+		_scopeStarts.pop_back();
+
+		// undo this scope's declarations newest first, restoring anything they shadowed
+		while (_symbols.size() > start)
+		{
+			const Symbol& sym = _symbols.back();
+			_bindings[sym.Identifier] = sym.Shadowed;
+			_symbols.pop_back();
+		}
+	}
+
+	bool SymbolTable::declare(IdentifierId id, SGLTypeId type, std::size_t slot)
+	{
+		if (id >= _bindings.size())
+		{
+			_bindings.resize(id + 1, NO_SYMBOL);
+		}
+
+		std::size_t existing = _bindings[id];
+		if (existing != NO_SYMBOL && existing >= _scopeStarts.back())
+		{
+			// already declared in this scope
+			return false;
+		}
+
+		Symbol sym;
+		sym.Identifier = id;
+		sym.Type = type;
+		sym.Slot = slot;
+		sym.Shadowed = existing;
+
+		_bindings[id] = _symbols.size();
+		_symbols.push_back(sym);
+
+		return true;
+	}
+
+	const Symbol* SymbolTable::resolve(IdentifierId id) const
+	{
+		if (id >= _bindings.size() || _bindings[id] == NO_SYMBOL)
+		{
+			return nullptr;
+		}
+
+		return &_symbols[_bindings[id]];
+	}
+
+	void SymbolTable::clear()
+	{
+		_bindings.clear();
+		_symbols.clear();
+		_scopeStarts.assign(1, 0);
+	}
+}
\ No newline at end of file
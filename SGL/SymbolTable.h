@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "SGLTypes.h"
+
+/**
+ * Identifier interning and scoped symbol lookup for the compilers
+ *
+ * Every identifier string is hashed exactly once, when it is interned, and from then
+ * on it is just a dense integer. Resolving a symbol is an array index by that integer,
+ * so the cost of a lookup doesn't depend on how many variables are in scope.
+ */
+
+namespace SGL
+{
+	// Dense ID handed out for each unique identifier string
+	using IdentifierId = std::uint32_t;
+
+	// ID returned when an identifier hasn't been interned
+	constexpr IdentifierId INVALID_IDENTIFIER = std::numeric_limits<IdentifierId>::max();
+
+	/**
+	 * Interns identifier strings into dense IDs using an open-addressing hash map
+	 */
+	class IdentifierTable
+	{
+	public:
+
+		IdentifierTable();
+
+		/**
+		 * Returns the ID for the identifier, interning it if this is the first time it's been seen
+		 */
+		IdentifierId intern(const std::string& name);
+
+		/**
+		 * Returns the ID for the identifier, or INVALID_IDENTIFIER if it was never interned
+		 */
+		IdentifierId find(const std::string& name) const;
+
+		/**
+		 * Returns the string for an interned identifier
+		 */
+		const std::string& get_name(IdentifierId id) const
+		{
+			return _names[id];
+		}
+
+		/**
+		 * Returns the number of unique identifiers interned so far
+		 */
+		std::size_t size() const
+		{
+			return _names.size();
+		}
+
+		/**
+		 * Forgets every interned identifier
+		 */
+		void clear();
+
+	private:
+
+		/**
+		 * Returns the bucket that holds the name, or the empty bucket it would go in
+		 */
+		std::size_t find_bucket(const std::string& name, std::size_t hash) const;
+
+		/**
+		 * Doubles the bucket count and reinserts every identifier
+		 */
+		void grow();
+
+		// Hash table buckets, each holds an ID or INVALID_IDENTIFIER when empty
+		// Size is always a power of two so the probe can mask instead of mod
+		std::vector<IdentifierId> _buckets;
+		// Interned strings indexed by ID
+		std::vector<std::string> _names;
+		// Cached hash of each interned string, so growing never rehashes strings
+		std::vector<std::size_t> _hashes;
+	};
+
+	/**
+	 * A declared variable
+	 */
+	struct Symbol
+	{
+		// Interned identifier of the variable
+		IdentifierId Identifier = INVALID_IDENTIFIER;
+		// Type of the variable
+		SGLTypeId Type = SGL_INVALID_TYPE_ID;
+		// Variable slot the compiler assigned to it
+		std::size_t Slot = 0;
+		// Index of the declaration this one shadows, if any
+		std::size_t Shadowed = 0;
+	};
+
+	/**
+	 * Stack of scopes mapping identifiers to the innermost visible declaration
+	 *
+	 * Declarations are kept in one array in the order they were made. A scope is just the
+	 * array length when it was pushed, so popping it walks back only the declarations that
+	 * scope made and restores whatever each one shadowed.
+	 */
+	class SymbolTable
+	{
+	public:
+
+		SymbolTable();
+
+		/**
+		 * Opens a new scope, like entering a { } block
+		 */
+		void push_scope();
+
+		/**
+		 * Closes the innermost scope, all declarations made in it stop resolving
+		 * The outermost scope can't be popped
+		 */
+		void pop_scope();
+
+		/**
+		 * Declares a variable in the innermost scope
+		 * Returns false if the identifier is already declared in that same scope
+		 * Shadowing a declaration from an outer scope is allowed
+		 */
+		bool declare(IdentifierId id, SGLTypeId type, std::size_t slot);
+
+		/**
+		 * Returns the innermost visible declaration for the identifier, or nullptr if there is none
+		 */
+		const Symbol* resolve(IdentifierId id) const;
+
+		/**
+		 * Returns the number of open scopes, including the outermost one
+		 */
+		std::size_t get_scope_depth() const
+		{
+			return _scopeStarts.size();
+		}
+
+		/**
+		 * Drops every declaration and scope
+		 */
+		void clear();
+
+	private:
+
+		// Marks an identifier with no visible declaration
+		static constexpr std::size_t NO_SYMBOL = std::numeric_limits<std::size_t>::max();
+
+		// Index into _symbols of the visible declaration for each identifier, indexed by IdentifierId
+		std::vector<std::size_t> _bindings;
+		// Every live declaration, innermost scope last
+		std::vector<Symbol> _symbols;
+		// Length of _symbols when each scope was opened
+		std::vector<std::size_t> _scopeStarts;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "VMPool.h"
+
+VMPool::Lease::Lease(Lease&& other) noexcept
+	: _pool(other._pool), _vm(other._vm)
+{
+	other._vm = nullptr;
+}
+
+VMPool::Lease& VMPool::Lease::operator=(Lease&& other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		_pool = other._pool;
+		_vm = other._vm;
+		other._vm = nullptr;
+	}
+
+	return *this;
+}
+
+VMPool::Lease::~Lease()
+{
+	release();
+}
+
+void VMPool::Lease::release()
+{
+	if (_vm)
+	{
+		_pool->release(_vm);
+		_vm = nullptr;
+	}
+}
+
+VMPool::VMPool(std::size_t count, std::size_t stackSize, SGLAllocator& allocator)
+	: _stackSize(stackSize)
+	, _allocator(allocator)
+{
+	// the free list never holds more than every VM, so it never has to grow while handing VMs back
+	_free.reserve(count);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		_vms.emplace_back(_stackSize, _allocator);
+		_free.push_back(&_vms.back());
+	}
+}
+
+VMPool::Lease VMPool::acquire()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	if (_free.empty())
+	{
+		// every VM is out, add one that stays in the pool from now on
+		_vms.emplace_back(_stackSize, _allocator);
+		_free.reserve(_vms.size());
+		return Lease(this, &_vms.back());
+	}
+
+	VirtualMachine* vm = _free.back();
+	_free.pop_back();
+	return Lease(this, vm);
+}
+
+void VMPool::release(VirtualMachine* vm)
+{
+	// rewinding is constant time, the stack's memory is never touched
+	vm->reset();
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_free.push_back(vm);
+}
+
+std::size_t VMPool::get_vm_count() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _vms.size();
+}
+
+std::size_t VMPool::get_free_count() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _free.size();
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "VirtualMachine.h"
+
+/**
+ * A pool of ready to run VMs, for hosts that make lots of short calls
+ *
+ * Every VM's stack is allocated once, when the VM joins the pool, and kept until the pool is
+ * destroyed. Handing a VM back only rewinds its stack, so acquiring and releasing never
+ * allocates or frees anything. If every VM is out, acquiring adds one more, which then stays
+ * in the pool for good.
+ */
+class VMPool
+{
+public:
+
+	/**
+	 * A VM on loan from the pool, handed back when the lease is destroyed
+	 */
+	class Lease
+	{
+	public:
+
+		Lease(Lease&& other) noexcept;
+		Lease& operator=(Lease&& other) noexcept;
+
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+
+		~Lease();
+
+		VirtualMachine& operator*() const
+		{
+			return *_vm;
+		}
+
+		VirtualMachine* operator->() const
+		{
+			return _vm;
+		}
+
+		/**
+		 * Hands the VM back to the pool early, the lease is empty afterwards
+		 */
+		void release();
+
+	private:
+
+		friend class VMPool;
+
+		Lease(VMPool* pool, VirtualMachine* vm)
+			: _pool(pool), _vm(vm)
+		{}
+
+		// Pool the VM goes back to
+		VMPool* _pool = nullptr;
+		// VM on loan, nullptr once it's been handed back
+		VirtualMachine* _vm = nullptr;
+	};
+
+	/**
+	 * Creates a pool with 'count' VMs, each with a stack of 'stackSize' bytes taken from 'allocator'
+	 * A stack size of 0 uses the default size, like VirtualMachine does
+	 */
+	VMPool(std::size_t count, std::size_t stackSize = 0, SGLAllocator& allocator = get_default_allocator());
+
+	VMPool(const VMPool&) = delete;
+	VMPool& operator=(const VMPool&) = delete;
+
+	/**
+	 * Lends out a VM with an empty stack
+	 * Safe to call from multiple threads, every lease has to be released before the pool is destroyed
+	 */
+	Lease acquire();
+
+	/**
+	 * Returns the number of VMs the pool has created
+	 */
+	std::size_t get_vm_count() const;
+
+	/**
+	 * Returns the number of VMs waiting to be acquired
+	 */
+	std::size_t get_free_count() const;
+
+private:
+
+	/**
+	 * Rewinds a VM and puts it back on the free list
+	 */
+	void release(VirtualMachine* vm);
+
+	// Stack size of every VM in the pool
+	std::size_t _stackSize;
+	// Where the VMs' stacks come from
+	SGLAllocator& _allocator;
+
+	// Every VM the pool has created, deque so VMs never move as more are added
+	std::deque<VirtualMachine> _vms;
+	// VMs waiting to be acquired, most recently released last so the next caller gets a warm stack
+	std::vector<VirtualMachine*> _free;
+	// Guards the VM list and the free list
+	mutable std::mutex _mutex;
+
+};
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <xmmintrin.h>
+
+// SSE helpers behind the vec2/vec3/vec4 opcodes
+
+/**
+ * In-memory form of every SGL vector type
+ * vec2 and vec3 use the first 2 or 3 lanes, the rest are ignored by anything that depends on the lane count
+ */
+struct alignas(16) SGLVector
+{
+	float Lanes[4];
+};
+
+/**
+ * Loads a vector into an SSE register
+ */
+inline __m128 load_vector(const SGLVector& vec)
+{
+	return _mm_load_ps(vec.Lanes);
+}
+
+/**
+ * Stores an SSE register into a vector
+ */
+inline SGLVector store_vector(__m128 value)
+{
+	SGLVector vec;
+	_mm_store_ps(vec.Lanes, value);
+	return vec;
+}
+
+/**
+ * Returns a mask that keeps the first 'lanes' lanes of a vector and clears the rest
+ */
+inline __m128 get_lane_mask(std::uint8_t lanes)
+{
+	alignas(16) static const std::uint32_t masks[5][4] =
+	{
+		{ 0, 0, 0, 0 },
+		{ 0xFFFFFFFF, 0, 0, 0 },
+		{ 0xFFFFFFFF, 0xFFFFFFFF, 0, 0 },
+		{ 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0 },
+		{ 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF },
+	};
+
+	return _mm_load_ps(reinterpret_cast<const float*>(masks[lanes]));
+}
+
+/**
+ * Returns the dot product of the first 'lanes' lanes of two vectors
+ */
+inline float vector_dot(__m128 lh, __m128 rh, std::uint8_t lanes)
+{
+	__m128 products = _mm_and_ps(_mm_mul_ps(lh, rh), get_lane_mask(lanes));
+
+	// horizontal add: fold the high half onto the low half, then lane 1 onto lane 0
+	__m128 sums = _mm_add_ps(products, _mm_movehl_ps(products, products));
+	sums = _mm_add_ss(sums, _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(1, 1, 1, 1)));
+
+	return _mm_cvtss_f32(sums);
+}
+
+/**
+ * Returns the length of the first 'lanes' lanes of a vector
+ */
+inline float vector_length(__m128 vec, std::uint8_t lanes)
+{
+	return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(vector_dot(vec, vec, lanes))));
+}
+
+/**
+ * Returns the vector scaled to a length of 1, or a zero vector if its length is 0
+ */
+inline __m128 vector_normalize(__m128 vec, std::uint8_t lanes)
+{
+	float length = vector_length(vec, lanes);
+	if (length == 0.0f)
+	{
+		return _mm_setzero_ps();
+	}
+
+	return _mm_and_ps(_mm_div_ps(vec, _mm_set1_ps(length)), get_lane_mask(lanes));
+}
+
+/**
+ * Returns the cross product of two vec3s, with the unused lane cleared
+ */
+inline __m128 vector_cross(__m128 lh, __m128 rh)
+{
+	// lh.yzx * rh.zxy - lh.zxy * rh.yzx
+	__m128 lhYZX = _mm_shuffle_ps(lh, lh, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 rhZXY = _mm_shuffle_ps(rh, rh, _MM_SHUFFLE(3, 1, 0, 2));
+	__m128 lhZXY = _mm_shuffle_ps(lh, lh, _MM_SHUFFLE(3, 1, 0, 2));
+	__m128 rhYZX = _mm_shuffle_ps(rh, rh, _MM_SHUFFLE(3, 0, 2, 1));
+
+	__m128 cross = _mm_sub_ps(_mm_mul_ps(lhYZX, rhZXY), _mm_mul_ps(lhZXY, rhYZX));
+	return _mm_and_ps(cross, get_lane_mask(3));
+}
\ No newline at end of file
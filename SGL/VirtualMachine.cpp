@@ -1,12 +1,127 @@
 #include "VirtualMachine.h"
 
+#include "ConstantPool.h"
 #include "Helpers.h"
 #include "Instructions.h"
+#include "NativeFunctions.h"
+#include "PrintSink.h"
+#include "Script.h"
+#include "ScriptInstance.h"
+#include "SGLString.h"
+#include "VectorMath.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 
-VirtualMachine::VirtualMachine(size_t stacksize)
-	: _stack(stacksize)
+namespace
+{
+	// Temporaries of the VM running a call on this thread
+	thread_local SGLScratchAllocator* currentTemporaries = nullptr;
+
+	/**
+	 * Runs a fused compare-and-branch, the displacement after the instruction is a 'Displacement'
+	 * Pops two ints and jumps if 'compare' is true for them, left to right
+	 */
+	template <class Displacement, class Compare>
+	void int_compare_jump(VMStack& stack, const std::uint8_t* code, size_t& execPos, Compare compare)
+	{
+		Displacement displacement = read_from_buffer<Displacement>(code + execPos);
+		execPos += sizeof(Displacement);
+
+		int right = stack.pop<int>();
+		int left = stack.pop<int>();
+		if (compare(left, right))
+		{
+			execPos += displacement;
+		}
+	}
+
+	/**
+	 * Runs a TABLE_SWITCH, popping the int it switches on
+	 */
+	void table_switch(VMStack& stack, const std::uint8_t* code, size_t& execPos)
+	{
+		std::uint16_t count = read_from_buffer<std::uint16_t>(code + execPos);
+		std::int32_t displacement = read_from_buffer<std::int32_t>(code + execPos + 2);
+		std::int32_t low = read_from_buffer<std::int32_t>(code + execPos + 6);
+		const std::uint8_t* table = code + execPos + get_operand_size(SGLOperand::SWITCH_TABLE);
+		execPos += get_operand_size(SGLOperand::SWITCH_TABLE) + get_switch_table_size(SGLOperand::SWITCH_TABLE, count);
+
+		// values below the low one wrap around to huge indices, so one compare bounds both ends
+		std::uint32_t index = static_cast<std::uint32_t>(stack.pop<int>()) - static_cast<std::uint32_t>(low);
+		if (index < count)
+		{
+			displacement = read_from_buffer<std::int32_t>(table + index * sizeof(std::int32_t));
+		}
+
+		execPos += displacement;
+	}
+
+	/**
+	 * Runs a LOOKUP_SWITCH, popping the int it switches on
+	 */
+	void lookup_switch(VMStack& stack, const std::uint8_t* code, size_t& execPos)
+	{
+		std::uint16_t count = read_from_buffer<std::uint16_t>(code + execPos);
+		std::int32_t displacement = read_from_buffer<std::int32_t>(code + execPos + 2);
+		const std::uint8_t* keys = code + execPos + get_operand_size(SGLOperand::SWITCH_LOOKUP);
+		execPos += get_operand_size(SGLOperand::SWITCH_LOOKUP) + get_switch_table_size(SGLOperand::SWITCH_LOOKUP, count);
+
+		// binary search for the first key that isn't less than the value
+		int value = stack.pop<int>();
+		std::size_t first = 0;
+		std::size_t last = count;
+		while (first < last)
+		{
+			std::size_t middle = first + (last - first) / 2;
+			if (read_from_buffer<std::int32_t>(keys + middle * 2 * sizeof(std::int32_t)) < value)
+			{
+				first = middle + 1;
+			}
+			else
+			{
+				last = middle;
+			}
+		}
+
+		const std::uint8_t* entry = keys + first * 2 * sizeof(std::int32_t);
+		if (first < count && read_from_buffer<std::int32_t>(entry) == value)
+		{
+			displacement = read_from_buffer<std::int32_t>(entry + sizeof(std::int32_t));
+		}
+
+		execPos += displacement;
+	}
+
+	/**
+	 * Returns -1, 0 or 1 as 'left' is less, equal or greater, and 'unordered' if either is NaN
+	 */
+	template <class T>
+	int compare_values(T left, T right, int unordered)
+	{
+		if (left < right)
+		{
+			return -1;
+		}
+		if (left > right)
+		{
+			return 1;
+		}
+		return left == right ? 0 : unordered;
+	}
+}
+
+SGLScratchAllocator* get_call_temporaries()
+{
+	return currentTemporaries;
+}
+
+VirtualMachine::VirtualMachine(size_t stacksize, SGLAllocator& allocator)
+	: _stack(stacksize, allocator)
+	, _temporaries(SGL_TEMPORARIES_DEFAULT_SIZE, allocator)
 {
 	_stack.initialize_stack();
 }
@@ -15,10 +130,29 @@ VirtualMachine::VirtualMachine()
 	: VirtualMachine(0)
 {}
 
-void VirtualMachine::execute_bytecode(std::uint8_t* code, size_t bufferSize)
+bool VirtualMachine::execute_bytecode(const std::uint8_t* code, size_t bufferSize, size_t frameSize, size_t stackSize,
+	const ConstantPool* constants, std::uint8_t* globals, SGLStringStore* strings)
 {
 	if (code)
 	{
+		// variables live in a frame at the bottom of this call's part of the stack
+		// this is the only place the stack checks for room, so it's sized for everything the code pushes
+		VMFrame stackFrame = _stack.push_frame(frameSize * SGL_SLOT_SIZE, stackSize);
+		if (stackFrame.Pos == SGL_INVALID_FRAME)
+		{
+			return false;
+		}
+
+		size_t frame = stackFrame.Pos;
+
+		// natives allocate the call's temporaries through this, a native calling back in gets the same ones
+		SGLScratchAllocator* previousTemporaries = currentTemporaries;
+		currentTemporaries = &_temporaries;
+		++_callDepth;
+
+		// where this call's print line starts, a native calling back in may be in the middle of one
+		size_t printStart = _printLine.size();
+
 		bool isDone = false;
 		size_t execPos = 0;
 		while (!isDone && execPos < bufferSize)
@@ -34,30 +168,47 @@ void VirtualMachine::execute_bytecode(std::uint8_t* code, size_t bufferSize)
 					execPos += sizeof(int);
 					break;
 				}
+				case INT_CONST_0:
+				{
+					_stack.push<int>(0);
+					break;
+				}
+				case INT_CONST_1:
+				{
+					_stack.push<int>(1);
+					break;
+				}
+				case INT_CONST_8:
+				{
+					// next byte is the constant, sign extended
+					int constant = static_cast<std::int8_t>(code[execPos++]);
+					_stack.push<int>(constant);
+					break;
+				}
+				case INT_CONST_16:
+				{
+					// next 2 bytes are the constant, sign extended
+					int constant = read_from_buffer<std::int16_t>(code + execPos);
+					_stack.push<int>(constant);
+					execPos += sizeof(std::int16_t);
+					break;
+				}
+				case INT_CONST_POOL:
+				case FLOAT_CONST_POOL:
+				{
+					// next 2 bytes are the pool index, the constant is pushed as its raw 32 bits
+					std::uint16_t index = read_from_buffer<std::uint16_t>(code + execPos);
+					_stack.push<std::uint32_t>(constants->get_word(index));
+					execPos += sizeof(std::uint16_t);
+					break;
+				}
 				case INT_STORE:
 				{
 					// grab the byte that corresponds to the slot to store
 					std::uint8_t byte = code[execPos++];
 
-					// grow as necessary
-					while (byte >= _variables.size())
-					{
-						_variables.push_back(nullptr);
-					}
-
-					if (_variables[byte] != nullptr)
-					{
-						// see if int is already stored (updating the value)
-						int* var = static_cast<int*>(_variables[byte]);
-						*var = _stack.pop<int>();
-					}
-					else
-					{
-						// allocate new int and store it
-						int* var = new int(_stack.pop<int>());
-						_variables[byte] = var;
-					}
-					
+					// pop the int into its slot
+					_stack.store<int>(frame + byte * SGL_SLOT_SIZE, _stack.pop<int>());
 					break;
 				}
 				case INT_LOAD:
@@ -65,14 +216,8 @@ void VirtualMachine::execute_bytecode(std::uint8_t* code, size_t bufferSize)
 					// grab slot to load from
 					std::uint8_t byte = code[execPos++];
 
-					// grab pointer to int
-					int* ptr = static_cast<int*>(_variables[byte]);
-					if (ptr)
-					{
-						// load int
-						_stack.push<int>(*ptr);
-					}
-
+					// load int
+					_stack.push<int>(_stack.load<int>(frame + byte * SGL_SLOT_SIZE));
 					break;
 				}
 				case INT_ADD:
@@ -150,25 +295,893 @@ void VirtualMachine::execute_bytecode(std::uint8_t* code, size_t bufferSize)
 					_stack.push<int>(to);
 					break;
 				}
+				case WIDE:
+				{
+					// the instruction being widened, then its 2 byte slot
+					std::uint8_t wideInstruction = code[execPos++];
+					size_t slotPos = frame + read_from_buffer<std::uint16_t>(code + execPos) * SGL_SLOT_SIZE;
+					execPos += sizeof(std::uint16_t);
+
+					switch (wideInstruction)
+					{
+						case INT_STORE:
+							_stack.store<int>(slotPos, _stack.pop<int>());
+							break;
+						case INT_LOAD:
+							_stack.push<int>(_stack.load<int>(slotPos));
+							break;
+						case FLOAT_STORE:
+							_stack.store<float>(slotPos, _stack.pop<float>());
+							break;
+						case FLOAT_LOAD:
+							_stack.push<float>(_stack.load<float>(slotPos));
+							break;
+						case INT64_STORE:
+							_stack.store<std::int64_t>(slotPos, _stack.pop<std::int64_t>());
+							break;
+						case INT64_LOAD:
+							_stack.push<std::int64_t>(_stack.load<std::int64_t>(slotPos));
+							break;
+						case DOUBLE_STORE:
+							_stack.store<double>(slotPos, _stack.pop<double>());
+							break;
+						case DOUBLE_LOAD:
+							_stack.push<double>(_stack.load<double>(slotPos));
+							break;
+						case VEC_STORE:
+							_stack.store<SGLVector>(slotPos, _stack.pop<SGLVector>());
+							break;
+						case VEC_LOAD:
+							_stack.push<SGLVector>(_stack.load<SGLVector>(slotPos));
+							break;
+						default:
+							get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Invalid instruction ", static_cast<int>(wideInstruction), " after WIDE. Terminating.");
+							isDone = true;
+							break;
+					}
+					break;
+				}
+				case FLOAT_CONST:
+				{
+					// next 4 bytes are the constant to push
+					float constant = read_from_buffer<float>(code + execPos);
+					_stack.push<float>(constant);
+					execPos += sizeof(float);
+					break;
+				}
+				case FLOAT_STORE:
+				{
+					// grab the byte that corresponds to the slot to store
+					std::uint8_t byte = code[execPos++];
+
+					// pop the float into its slot
+					_stack.store<float>(frame + byte * SGL_SLOT_SIZE, _stack.pop<float>());
+					break;
+				}
+				case FLOAT_LOAD:
+				{
+					// grab slot to load from
+					std::uint8_t byte = code[execPos++];
+
+					// load float
+					_stack.push<float>(_stack.load<float>(frame + byte * SGL_SLOT_SIZE));
+					break;
+				}
+				case FLOAT_ADD:
+				{
+					float top = _stack.pop<float>();
+					float bottom = _stack.pop<float>();
+					_stack.push<float>(bottom + top);
+					break;
+				}
+				case FLOAT_SUB:
+				{
+					float top = _stack.pop<float>();
+					float bottom = _stack.pop<float>();
+					_stack.push<float>(bottom - top);
+					break;
+				}
+				case FLOAT_MUL:
+				{
+					float top = _stack.pop<float>();
+					float bottom = _stack.pop<float>();
+					_stack.push<float>(bottom * top);
+					break;
+				}
+				case FLOAT_DIV:
+				{
+					float top = _stack.pop<float>();
+					float bottom = _stack.pop<float>();
+					_stack.push<float>(bottom / top);
+					break;
+				}
+				case INT64_CONST:
+				{
+					// next 8 bytes are the constant to push
+					std::int64_t constant = read_from_buffer<std::int64_t>(code + execPos);
+					_stack.push<std::int64_t>(constant);
+					execPos += sizeof(std::int64_t);
+					break;
+				}
+				case INT64_CONST_0:
+				{
+					_stack.push<std::int64_t>(0);
+					break;
+				}
+				case DOUBLE_CONST:
+				{
+					// next 8 bytes are the constant to push
+					double constant = read_from_buffer<double>(code + execPos);
+					_stack.push<double>(constant);
+					execPos += sizeof(double);
+					break;
+				}
+				case INT64_STORE:
+				{
+					// grab the byte that corresponds to the first slot to store
+					std::uint8_t byte = code[execPos++];
+					
+					_stack.store<std::int64_t>(frame + byte * SGL_SLOT_SIZE, _stack.pop<std::int64_t>());
+					break;
+				}
+				case INT64_LOAD:
+				{
+					// grab first slot to load from
+					std::uint8_t byte = code[execPos++];
+					
+					_stack.push<std::int64_t>(_stack.load<std::int64_t>(frame + byte * SGL_SLOT_SIZE));
+					break;
+				}
+				case DOUBLE_STORE:
+				{
+					// grab the byte that corresponds to the first slot to store
+					std::uint8_t byte = code[execPos++];
+					
+					_stack.store<double>(frame + byte * SGL_SLOT_SIZE, _stack.pop<double>());
+					break;
+				}
+				case DOUBLE_LOAD:
+				{
+					// grab first slot to load from
+					std::uint8_t byte = code[execPos++];
+					
+					_stack.push<double>(_stack.load<double>(frame + byte * SGL_SLOT_SIZE));
+					break;
+				}
+				case INT64_ADD:
+				{
+					std::int64_t top = _stack.pop<std::int64_t>();
+					std::int64_t bottom = _stack.pop<std::int64_t>();
+					_stack.push<std::int64_t>(bottom + top);
+					break;
+				}
+				case INT64_SUB:
+				{
+					std::int64_t top = _stack.pop<std::int64_t>();
+					std::int64_t bottom = _stack.pop<std::int64_t>();
+					_stack.push<std::int64_t>(bottom - top);
+					break;
+				}
+				case INT64_MUL:
+				{
+					std::int64_t top = _stack.pop<std::int64_t>();
+					std::int64_t bottom = _stack.pop<std::int64_t>();
+					_stack.push<std::int64_t>(bottom * top);
+					break;
+				}
+				case INT64_DIV:
+				{
+					std::int64_t top = _stack.pop<std::int64_t>();
+					std::int64_t bottom = _stack.pop<std::int64_t>();
+					_stack.push<std::int64_t>(bottom / top);
+					break;
+				}
+				case INT64_MOD:
+				{
+					std::int64_t top = _stack.pop<std::int64_t>();
+					std::int64_t bottom = _stack.pop<std::int64_t>();
+					_stack.push<std::int64_t>(bottom % top);
+					break;
+				}
+				case DOUBLE_ADD:
+				{
+					double top = _stack.pop<double>();
+					double bottom = _stack.pop<double>();
+					_stack.push<double>(bottom + top);
+					break;
+				}
+				case DOUBLE_SUB:
+				{
+					double top = _stack.pop<double>();
+					double bottom = _stack.pop<double>();
+					_stack.push<double>(bottom - top);
+					break;
+				}
+				case DOUBLE_MUL:
+				{
+					double top = _stack.pop<double>();
+					double bottom = _stack.pop<double>();
+					_stack.push<double>(bottom * top);
+					break;
+				}
+				case DOUBLE_DIV:
+				{
+					double top = _stack.pop<double>();
+					double bottom = _stack.pop<double>();
+					_stack.push<double>(bottom / top);
+					break;
+				}
+				case INT_TO_INT64:
+				{
+					int from = _stack.pop<int>();
+					std::int64_t to = static_cast<std::int64_t>(from);
+					_stack.push<std::int64_t>(to);
+					break;
+				}
+				case INT_TO_DOUBLE:
+				{
+					int from = _stack.pop<int>();
+					double to = static_cast<double>(from);
+					_stack.push<double>(to);
+					break;
+				}
+				case FLOAT_TO_INT64:
+				{
+					float from = _stack.pop<float>();
+					std::int64_t to = static_cast<std::int64_t>(from);
+					_stack.push<std::int64_t>(to);
+					break;
+				}
+				case FLOAT_TO_DOUBLE:
+				{
+					float from = _stack.pop<float>();
+					double to = static_cast<double>(from);
+					_stack.push<double>(to);
+					break;
+				}
+				case INT64_TO_INT:
+				{
+					std::int64_t from = _stack.pop<std::int64_t>();
+					int to = static_cast<int>(from);
+					_stack.push<int>(to);
+					break;
+				}
+				case INT64_TO_FLOAT:
+				{
+					std::int64_t from = _stack.pop<std::int64_t>();
+					float to = static_cast<float>(from);
+					_stack.push<float>(to);
+					break;
+				}
+				case INT64_TO_DOUBLE:
+				{
+					std::int64_t from = _stack.pop<std::int64_t>();
+					double to = static_cast<double>(from);
+					_stack.push<double>(to);
+					break;
+				}
+				case DOUBLE_TO_INT:
+				{
+					double from = _stack.pop<double>();
+					int to = static_cast<int>(from);
+					_stack.push<int>(to);
+					break;
+				}
+				case DOUBLE_TO_FLOAT:
+				{
+					double from = _stack.pop<double>();
+					float to = static_cast<float>(from);
+					_stack.push<float>(to);
+					break;
+				}
+				case DOUBLE_TO_INT64:
+				{
+					double from = _stack.pop<double>();
+					std::int64_t to = static_cast<std::int64_t>(from);
+					_stack.push<std::int64_t>(to);
+					break;
+				}
+				case VEC_MAKE:
+				{
+					// next byte is the lane count, the last lane is on top
+					std::uint8_t lanes = code[execPos++];
+					SGLVector vec = {};
+					for (int lane = lanes - 1; lane >= 0; --lane)
+					{
+						vec.Lanes[lane] = _stack.pop<float>();
+					}
+					_stack.push<SGLVector>(vec);
+					break;
+				}
+				case VEC_SPLAT:
+				{
+					std::uint8_t lanes = code[execPos++];
+					float value = _stack.pop<float>();
+					_stack.push<SGLVector>(store_vector(_mm_and_ps(_mm_set1_ps(value), get_lane_mask(lanes))));
+					break;
+				}
+				case VEC_STORE:
+				{
+					// grab the byte that corresponds to the first slot to store
+					std::uint8_t byte = code[execPos++];
+
+					_stack.store<SGLVector>(frame + byte * SGL_SLOT_SIZE, _stack.pop<SGLVector>());
+					break;
+				}
+				case VEC_LOAD:
+				{
+					// grab first slot to load from
+					std::uint8_t byte = code[execPos++];
+
+					_stack.push<SGLVector>(_stack.load<SGLVector>(frame + byte * SGL_SLOT_SIZE));
+					break;
+				}
+				case VEC_ADD:
+				{
+					__m128 top = load_vector(_stack.pop<SGLVector>());
+					__m128 bottom = load_vector(_stack.pop<SGLVector>());
+					_stack.push<SGLVector>(store_vector(_mm_add_ps(bottom, top)));
+					break;
+				}
+				case VEC_SUB:
+				{
+					__m128 top = load_vector(_stack.pop<SGLVector>());
+					__m128 bottom = load_vector(_stack.pop<SGLVector>());
+					_stack.push<SGLVector>(store_vector(_mm_sub_ps(bottom, top)));
+					break;
+				}
+				case VEC_MUL:
+				{
+					__m128 top = load_vector(_stack.pop<SGLVector>());
+					__m128 bottom = load_vector(_stack.pop<SGLVector>());
+					_stack.push<SGLVector>(store_vector(_mm_mul_ps(bottom, top)));
+					break;
+				}
+				case VEC_DIV:
+				{
+					__m128 top = load_vector(_stack.pop<SGLVector>());
+					__m128 bottom = load_vector(_stack.pop<SGLVector>());
+					_stack.push<SGLVector>(store_vector(_mm_div_ps(bottom, top)));
+					break;
+				}
+				case VEC_DOT:
+				{
+					std::uint8_t lanes = code[execPos++];
+					__m128 top = load_vector(_stack.pop<SGLVector>());
+					__m128 bottom = load_vector(_stack.pop<SGLVector>());
+					_stack.push<float>(vector_dot(bottom, top, lanes));
+					break;
+				}
+				case VEC_CROSS:
+				{
+					__m128 top = load_vector(_stack.pop<SGLVector>());
+					__m128 bottom = load_vector(_stack.pop<SGLVector>());
+					_stack.push<SGLVector>(store_vector(vector_cross(bottom, top)));
+					break;
+				}
+				case VEC_LENGTH:
+				{
+					std::uint8_t lanes = code[execPos++];
+					_stack.push<float>(vector_length(load_vector(_stack.pop<SGLVector>()), lanes));
+					break;
+				}
+				case VEC_NORMALIZE:
+				{
+					std::uint8_t lanes = code[execPos++];
+					_stack.push<SGLVector>(store_vector(vector_normalize(load_vector(_stack.pop<SGLVector>()), lanes)));
+					break;
+				}
+				case VEC_EXTRACT:
+				{
+					std::uint8_t lane = code[execPos++];
+					_stack.push<float>(_stack.pop<SGLVector>().Lanes[lane]);
+					break;
+				}
+				case FLOAT_SQRT:
+				{
+					float value = _stack.pop<float>();
+					_stack.push<float>(std::sqrt(value));
+					break;
+				}
+				case FLOAT_ABS:
+				{
+					float value = _stack.pop<float>();
+					_stack.push<float>(std::fabs(value));
+					break;
+				}
+				case FLOAT_FLOOR:
+				{
+					float value = _stack.pop<float>();
+					_stack.push<float>(std::floor(value));
+					break;
+				}
+				case FLOAT_SIN:
+				{
+					float value = _stack.pop<float>();
+					_stack.push<float>(std::sin(value));
+					break;
+				}
+				case FLOAT_COS:
+				{
+					float value = _stack.pop<float>();
+					_stack.push<float>(std::cos(value));
+					break;
+				}
+				case FLOAT_MINIMUM:
+				{
+					float top = _stack.pop<float>();
+					float bottom = _stack.pop<float>();
+					_stack.push<float>(std::min(bottom, top));
+					break;
+				}
+				case FLOAT_MAXIMUM:
+				{
+					float top = _stack.pop<float>();
+					float bottom = _stack.pop<float>();
+					_stack.push<float>(std::max(bottom, top));
+					break;
+				}
+				case FLOAT_CLAMP:
+				{
+					float upper = _stack.pop<float>();
+					float lower = _stack.pop<float>();
+					float value = _stack.pop<float>();
+					_stack.push<float>(std::min(std::max(value, lower), upper));
+					break;
+				}
+				case INT_ABS:
+				{
+					int value = _stack.pop<int>();
+					_stack.push<int>(std::abs(value));
+					break;
+				}
+				case INT_MINIMUM:
+				{
+					int top = _stack.pop<int>();
+					int bottom = _stack.pop<int>();
+					_stack.push<int>(std::min(bottom, top));
+					break;
+				}
+				case INT_MAXIMUM:
+				{
+					int top = _stack.pop<int>();
+					int bottom = _stack.pop<int>();
+					_stack.push<int>(std::max(bottom, top));
+					break;
+				}
+				case INT_CLAMP:
+				{
+					int upper = _stack.pop<int>();
+					int lower = _stack.pop<int>();
+					int value = _stack.pop<int>();
+					_stack.push<int>(std::min(std::max(value, lower), upper));
+					break;
+				}
+				case CALL_NATIVE:
+				{
+					// next 2 bytes are the native's index, its thunk does all the stack work
+					const SGLNativeFunction& native = get_native_registry().get_function(read_from_buffer<std::uint16_t>(code + execPos));
+					execPos += sizeof(std::uint16_t);
+
+					native.Thunk(_stack, native.Function);
+					break;
+				}
+				case FIELD_LOAD:
+				{
+					// next 2 bytes are the field's offset, the object is read in place
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					auto* object = pop_native_value<std::uint8_t*>(_stack);
+					std::uint32_t value;
+					std::memcpy(&value, object + offset, sizeof(value));
+					_stack.push<std::uint32_t>(value);
+					break;
+				}
+				case FIELD_STORE:
+				{
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					auto* object = pop_native_value<std::uint8_t*>(_stack);
+					std::uint32_t value = _stack.pop<std::uint32_t>();
+					std::memcpy(object + offset, &value, sizeof(value));
+					break;
+				}
+				case FIELD_LOAD_64:
+				{
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					auto* object = pop_native_value<std::uint8_t*>(_stack);
+					std::uint64_t value;
+					std::memcpy(&value, object + offset, sizeof(value));
+					_stack.push<std::uint64_t>(value);
+					break;
+				}
+				case FIELD_STORE_64:
+				{
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					auto* object = pop_native_value<std::uint8_t*>(_stack);
+					std::uint64_t value = _stack.pop<std::uint64_t>();
+					std::memcpy(object + offset, &value, sizeof(value));
+					break;
+				}
+				case GLOBAL_LOAD:
+				{
+					// next 2 bytes are the global's offset, globals are aligned for their type
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					std::uint32_t value;
+					std::memcpy(&value, globals + offset, sizeof(value));
+					_stack.push<std::uint32_t>(value);
+					break;
+				}
+				case GLOBAL_STORE:
+				{
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					std::uint32_t value = _stack.pop<std::uint32_t>();
+					std::memcpy(globals + offset, &value, sizeof(value));
+					break;
+				}
+				case GLOBAL_LOAD_64:
+				{
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					std::uint64_t value;
+					std::memcpy(&value, globals + offset, sizeof(value));
+					_stack.push<std::uint64_t>(value);
+					break;
+				}
+				case GLOBAL_STORE_64:
+				{
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					std::uint64_t value = _stack.pop<std::uint64_t>();
+					std::memcpy(globals + offset, &value, sizeof(value));
+					break;
+				}
+				case GLOBAL_LOAD_VEC:
+				{
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					SGLVector value;
+					std::memcpy(&value, globals + offset, sizeof(value));
+					_stack.push<SGLVector>(value);
+					break;
+				}
+				case GLOBAL_STORE_VEC:
+				{
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					SGLVector value = _stack.pop<SGLVector>();
+					std::memcpy(globals + offset, &value, sizeof(value));
+					break;
+				}
+				case STRING_CONST_POOL:
+				{
+					// next 2 bytes are the index of the string, which was interned when it was added to the pool
+					std::uint16_t index = read_from_buffer<std::uint16_t>(code + execPos);
+					_stack.push<SGLString>(constants->get_string_value(index));
+					execPos += sizeof(std::uint16_t);
+					break;
+				}
+				case STRING_CONCAT:
+				{
+					SGLString top = _stack.pop<SGLString>();
+					SGLString bottom = _stack.pop<SGLString>();
+					_stack.push<SGLString>(concat_strings(bottom, top, _temporaries));
+					break;
+				}
+				case GLOBAL_STORE_STRING:
+				{
+					std::uint16_t offset = read_from_buffer<std::uint16_t>(code + execPos);
+					execPos += sizeof(std::uint16_t);
+
+					// the global outlives the call, so a long string is copied into the global's buffer in the instance's store
+					// without a store there's nowhere for it to live, and it's left empty rather than dangling
+					SGLString value = _stack.pop<SGLString>();
+					if (strings)
+					{
+						SGLString previous;
+						std::memcpy(&previous, globals + offset, sizeof(previous));
+						value = strings->replace(offset, previous, value);
+					}
+					else if (value.is_temporary())
+					{
+						get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Unable to store a string to a global without the instance's string store");
+						value = {};
+					}
+					std::memcpy(globals + offset, &value, sizeof(value));
+					break;
+				}
+				case PRINT:
+				{
+					// next byte is the type of the value on top of the stack
+					SGLTypeId type = code[execPos++];
+					switch (type)
+					{
+						case SGL_TYPE_INT32:
+							append_text(_printLine, _stack.pop<std::int32_t>());
+							break;
+						case SGL_TYPE_FLOAT:
+							append_text(_printLine, _stack.pop<float>());
+							break;
+						case SGL_TYPE_INT64:
+							append_text(_printLine, _stack.pop<std::int64_t>());
+							break;
+						case SGL_TYPE_DOUBLE:
+							append_text(_printLine, _stack.pop<double>());
+							break;
+						case SGL_TYPE_STRING:
+							append_text(_printLine, _stack.pop<SGLString>().view());
+							break;
+						default:
+						{
+							// vectors print their lanes in brackets
+							SGLVector vec = _stack.pop<SGLVector>();
+							_printLine.push_back('(');
+							for (std::uint8_t lane = 0; lane < get_vector_lanes(type); ++lane)
+							{
+								if (lane != 0)
+								{
+									_printLine.append(", ");
+								}
+								append_text(_printLine, vec.Lanes[lane]);
+							}
+							_printLine.push_back(')');
+							break;
+						}
+					}
+					break;
+				}
+				case NUMBER_TO_STRING:
+				{
+					// next byte is the type of the number, its text is formatted at the end of the print line then taken off
+					SGLTypeId type = code[execPos++];
+					std::size_t textStart = _printLine.size();
+					switch (type)
+					{
+						case SGL_TYPE_INT32:
+							append_text(_printLine, _stack.pop<std::int32_t>());
+							break;
+						case SGL_TYPE_FLOAT:
+							append_text(_printLine, _stack.pop<float>());
+							break;
+						case SGL_TYPE_INT64:
+							append_text(_printLine, _stack.pop<std::int64_t>());
+							break;
+						default:
+							append_text(_printLine, _stack.pop<double>());
+							break;
+					}
+					_stack.push<SGLString>(make_temporary_string(std::string_view(_printLine).substr(textStart), _temporaries));
+					_printLine.resize(textStart);
+					break;
+				}
+				case PRINT_END:
+				{
+					// a call made while the arguments were evaluated may have printed, its lines end before ours started
+					get_print_sink().write(SGLPrintChannel::Output, std::string_view(_printLine).substr(printStart));
+					_printLine.resize(printStart);
+					break;
+				}
+				case JMP_8:
+				{
+					// next byte is the displacement, counted from the end of the instruction
+					std::int8_t displacement = read_from_buffer<std::int8_t>(code + execPos);
+					execPos += sizeof(std::int8_t) + displacement;
+					break;
+				}
+				case JMP:
+				{
+					std::int32_t displacement = read_from_buffer<std::int32_t>(code + execPos);
+					execPos += sizeof(std::int32_t) + displacement;
+					break;
+				}
+				case INT_EQ_JMP_8:
+					int_compare_jump<std::int8_t>(_stack, code, execPos, std::equal_to<int>());
+					break;
+				case INT_EQ_JMP:
+					int_compare_jump<std::int32_t>(_stack, code, execPos, std::equal_to<int>());
+					break;
+				case INT_NE_JMP_8:
+					int_compare_jump<std::int8_t>(_stack, code, execPos, std::not_equal_to<int>());
+					break;
+				case INT_NE_JMP:
+					int_compare_jump<std::int32_t>(_stack, code, execPos, std::not_equal_to<int>());
+					break;
+				case INT_LT_JMP_8:
+					int_compare_jump<std::int8_t>(_stack, code, execPos, std::less<int>());
+					break;
+				case INT_LT_JMP:
+					int_compare_jump<std::int32_t>(_stack, code, execPos, std::less<int>());
+					break;
+				case INT_LE_JMP_8:
+					int_compare_jump<std::int8_t>(_stack, code, execPos, std::less_equal<int>());
+					break;
+				case INT_LE_JMP:
+					int_compare_jump<std::int32_t>(_stack, code, execPos, std::less_equal<int>());
+					break;
+				case INT_GT_JMP_8:
+					int_compare_jump<std::int8_t>(_stack, code, execPos, std::greater<int>());
+					break;
+				case INT_GT_JMP:
+					int_compare_jump<std::int32_t>(_stack, code, execPos, std::greater<int>());
+					break;
+				case INT_GE_JMP_8:
+					int_compare_jump<std::int8_t>(_stack, code, execPos, std::greater_equal<int>());
+					break;
+				case INT_GE_JMP:
+					int_compare_jump<std::int32_t>(_stack, code, execPos, std::greater_equal<int>());
+					break;
+				case FLOAT_CMPL:
+				case FLOAT_CMPG:
+				{
+					float right = _stack.pop<float>();
+					float left = _stack.pop<float>();
+					_stack.push<int>(compare_values(left, right, instruction == FLOAT_CMPL ? -1 : 1));
+					break;
+				}
+				case INT64_CMP:
+				{
+					std::int64_t right = _stack.pop<std::int64_t>();
+					std::int64_t left = _stack.pop<std::int64_t>();
+					_stack.push<int>(compare_values(left, right, 0));
+					break;
+				}
+				case DOUBLE_CMPL:
+				case DOUBLE_CMPG:
+				{
+					double right = _stack.pop<double>();
+					double left = _stack.pop<double>();
+					_stack.push<int>(compare_values(left, right, instruction == DOUBLE_CMPL ? -1 : 1));
+					break;
+				}
+				case STRING_CMP:
+				{
+					SGLString right = _stack.pop<SGLString>();
+					SGLString left = _stack.pop<SGLString>();
+					_stack.push<int>(left == right ? 0 : 1);
+					break;
+				}
+				case RETURN:
+				{
+					isDone = true;
+					break;
+				}
+				case TABLE_SWITCH:
+					table_switch(_stack, code, execPos);
+					break;
+				case LOOKUP_SWITCH:
+					lookup_switch(_stack, code, execPos);
+					break;
 				default:
 				{
-					std::cerr << "Unknown instruction detected, byte code " << instruction << ". Terminating." << std::endl;
+					get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Unknown instruction detected, byte code ", static_cast<int>(instruction), ". Terminating.");
 					isDone = true;
 					break;
 				}
 			}
 		}
+
+		_stack.pop_frame(stackFrame);
+
+		// a line cut short by an error in its arguments isn't printed
+		_printLine.resize(printStart);
+
+		// everything the call allocated goes at once, nested calls leave it to the outermost one
+		if (--_callDepth == 0)
+		{
+			_temporaries.reset();
+		}
+		currentTemporaries = previousTemporaries;
 	}
+
+	return true;
 }
 
-VirtualMachine::~VirtualMachine()
+bool VirtualMachine::execute_function(const Script& script, std::size_t index)
 {
-	// free any allocated variables that didn't get freed
-	for (auto ptr : _variables)
+	const SGL::FunctionData* fn = script.get_function(index);
+	if (!fn)
 	{
-		if (ptr)
-		{
-			delete ptr;
-		}
+		get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Unable to call function ", index, ", it is either undeclared or failed to compile");
+		return false;
+	}
+
+	if (script.get_globals_size() != 0)
+	{
+		get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Unable to call function ", fn->FunctionName, ", its script has globals so it must run through a ScriptInstance");
+		return false;
+	}
+
+	return execute_bytecode(fn->Bytecode.data(), fn->Bytecode.size(), fn->FrameSize, fn->MaxStackSize, &script.get_constants());
+}
+
+bool VirtualMachine::execute_function(const Script& script, const std::string& name)
+{
+	std::size_t index = script.find_function(name);
+	if (index == SGL_INVALID_FUNCTION)
+	{
+		get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Unable to call function ", name, ", it is undeclared");
+		return false;
+	}
+
+	return execute_function(script, index);
+}
+
+bool VirtualMachine::execute_function(ScriptInstance& instance, std::size_t index)
+{
+	const Script& script = instance.get_script();
+	const SGL::FunctionData* fn = script.get_function(index);
+	if (!fn)
+	{
+		get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Unable to call function ", index, ", it is either undeclared or failed to compile");
+		return false;
 	}
+
+	if (script.get_globals_size() != 0 && !instance.get_globals())
+	{
+		get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Unable to call function ", fn->FunctionName, ", the instance's globals failed to allocate");
+		return false;
+	}
+
+	instance.get_strings().begin_call();
+	bool result = execute_bytecode(fn->Bytecode.data(), fn->Bytecode.size(), fn->FrameSize, fn->MaxStackSize, &script.get_constants(),
+		instance.get_globals(), &instance.get_strings());
+	instance.get_strings().end_call();
+
+	// one mark per call instead of one per store keeps GLOBAL_STORE as cheap as it was
+	if (fn->WritesGlobals)
+	{
+		instance.mark_globals_written();
+	}
+
+	return result;
+}
+
+bool VirtualMachine::execute_function(ScriptInstance& instance, const std::string& name)
+{
+	std::size_t index = instance.get_script().find_function(name);
+	if (index == SGL_INVALID_FUNCTION)
+	{
+		get_print_sink().write_line(SGLPrintChannel::Diagnostic, "Unable to call function ", name, ", it is undeclared");
+		return false;
+	}
+
+	return execute_function(instance, index);
+}
+
+void VirtualMachine::reset()
+{
+	_stack.reset();
+	_temporaries.reset();
+	_callDepth = 0;
+	_printLine.clear();
+}
+
+void VirtualMachine::shrink_stack()
+{
+	_stack.shrink();
+	_temporaries.shrink();
+}
+
+size_t VirtualMachine::get_stack_reserved_size() const
+{
+	return _stack.get_reserved_size();
+}
+
+VirtualMachine::~VirtualMachine()
+{
+	_stack.shutdown_stack();
 }
\ No newline at end of file
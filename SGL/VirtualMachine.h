@@ -1,26 +1,112 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "Stack.h"
 
+// Size of the first chunk of a VM's temporaries, more are linked on as a call needs them
+#ifndef SGL_TEMPORARIES_DEFAULT_SIZE
+#define SGL_TEMPORARIES_DEFAULT_SIZE 4096
+#endif
+
+class ConstantPool;
+class Script;
+class ScriptInstance;
+class SGLStringStore;
+
 class VirtualMachine
 {
 public:
 
-	VirtualMachine(size_t stacksize);
+	/**
+	 * Creates a VM whose stack holds 'stacksize' bytes taken from 'allocator'
+	 */
+	VirtualMachine(size_t stacksize, SGLAllocator& allocator = get_default_allocator());
 
 	VirtualMachine();
 
-	void execute_bytecode(std::uint8_t* code, size_t bufferSize);
+	/**
+	 * Runs raw bytecode in a fresh frame with the given number of variable slots
+	 * 'stackSize' is the most bytes the code pushes above its frame, the stack grows to fit it up front
+	 * Code that loads pooled constants needs the pool it was compiled against, and code that
+	 * touches globals needs the globals block of the instance it runs for, plus its string store
+	 * if the code stores strings to them
+	 * Returns false if the stack can't grow enough to run the code
+	 */
+	bool execute_bytecode(const std::uint8_t* code, size_t bufferSize, size_t frameSize, size_t stackSize,
+		const ConstantPool* constants = nullptr, std::uint8_t* globals = nullptr, SGLStringStore* strings = nullptr);
+
+	/**
+	 * Runs the function at an index from Script::find_function
+	 * If the function's body was deferred, this is the call that compiles it
+	 * Scripts with globals need an instance to keep them in, see the overloads below
+	 * Returns false if the function doesn't exist, fails to compile or doesn't fit on the stack
+	 */
+	bool execute_function(const Script& script, std::size_t index);
+
+	/**
+	 * Runs the named function from the script, looking its index up on every call
+	 */
+	bool execute_function(const Script& script, const std::string& name);
+
+	/**
+	 * Runs the function at an index from Script::find_function against the instance's state
+	 * Any VM can run any instance, the VM only lends its stack for the duration of the call
+	 * Returns false if the function doesn't exist, fails to compile or doesn't fit on the stack
+	 */
+	bool execute_function(ScriptInstance& instance, std::size_t index);
+
+	/**
+	 * Runs the named function of the instance's script, looking its index up on every call
+	 */
+	bool execute_function(ScriptInstance& instance, const std::string& name);
+
+	/**
+	 * Puts the VM back in the state it was created in, in constant time
+	 * The stack and the temporaries keep their memory, only their positions are rewound
+	 */
+	void reset();
+
+	/**
+	 * Frees whatever the stack and the temporaries grew past their first block, for VMs that are going to sit idle
+	 * Only call this between calls
+	 */
+	void shrink_stack();
+
+	/**
+	 * Returns the number of bytes the VM's stack holds on to
+	 */
+	size_t get_stack_reserved_size() const;
+
+	/**
+	 * Returns the VM's temporaries, the memory values that only live for one call are allocated from
+	 * Everything in it is freed at once when the outermost call returns, so anything that has to
+	 * outlive the call is promoted to longer lived memory first
+	 */
+	SGLScratchAllocator& get_temporaries()
+	{
+		return _temporaries;
+	}
 
 	~VirtualMachine();
 
 private:
 
-	// working stack
+	// working stack, also holds each call's frame of variables
 	VMStack _stack;
-	// variable map
-	std::vector<void*> _variables;
+	// memory for values that die with the call, freed in one go when the outermost call returns
+	SGLScratchAllocator _temporaries;
+	// number of calls in progress, more than one when a native calls back into the VM
+	size_t _callDepth = 0;
+	// line print is building, kept between lines so its memory is reused
+	std::string _printLine;
+
+};
 
-};
\ No newline at end of file
+/**
+ * Returns the temporaries of the VM running a call on this thread, for natives that return
+ * values which only need to live until the call returns
+ * Returns nullptr outside of a call
+ */
+SGLScratchAllocator* get_call_temporaries();
\ No newline at end of file